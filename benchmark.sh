@@ -0,0 +1,20 @@
+#!/bin/sh
+
+cd `dirname $0`
+
+export BASENAME=${PWD##*/}
+export SCRIPTDIR=$PWD
+export BUILDDIR=$PWD/build
+
+/bin/sh $SCRIPTDIR/build.sh
+
+# Compares the native examples against running them with the interpreter
+# including the time it takes to compile them
+for EXAMPLE in $SCRIPTDIR/examples/*.unv
+do
+  NAME=`basename $EXAMPLE .unv`
+  echo "\n$NAME native"
+  time $BUILDDIR/bin/examples/$NAME
+  echo "\n$NAME interpreted"
+  time $BUILDDIR/bin/$BASENAME --include $SCRIPTDIR/core --interpret $EXAMPLE
+done
@@ -0,0 +1,9 @@
+UNV_INCLUDE = --include ../../core
+UNV_FLAGS = -O2
+UNV_SOURCES += $$PWD/dispatch.unv
+
+include($$PWD/../unv.pri)
+
+TEMPLATE = app
+TARGET = dispatch
+DESTDIR = $$OUTPUT_DIR/bin/examples
@@ -1,3 +1,3 @@
 TEMPLATE = subdirs
 CONFIG += ordered
-SUBDIRS = fibonacci.pro numericliterals.pro helloworld.pro
+SUBDIRS = fibonacci.pro numericliterals.pro helloworld.pro dispatch.pro
@@ -1,4 +1,5 @@
 UNV_INCLUDE = --include ../../core
+UNV_FLAGS = -O2 -j 2
 UNV_SOURCES += $$PWD/fibonacci.unv
 
 include($$PWD/../unv.pri)
@@ -1,6 +1,14 @@
 #include "ast.h"
 #include "visitor.h"
 
+void AssignStmt::walk(Visitor& visitor)
+{
+    visitor.begin(*this);
+    visitor.visit(*this);
+    expr->walk(visitor);
+    visitor.end(*this);
+}
+
 void BinaryExpr::walk(Visitor& visitor)
 {
     visitor.begin(*this);
@@ -10,12 +18,37 @@ void BinaryExpr::walk(Visitor& visitor)
     visitor.end(*this);
 }
 
+void ConditionalExpr::walk(Visitor& visitor)
+{
+    visitor.begin(*this);
+    visitor.visit(*this);
+    condition->walk(visitor);
+    lhs->walk(visitor);
+    rhs->walk(visitor);
+    visitor.end(*this);
+}
+
+void ForStmt::walk(Visitor& visitor)
+{
+    visitor.begin(*this);
+    visitor.visit(*this);
+    start->walk(visitor);
+    end->walk(visitor);
+    if (step)
+        step->walk(visitor);
+    foreach (QSharedPointer<Stmt> stmt, stmts)
+        stmt->walk(visitor);
+    visitor.end(*this);
+}
+
 void IfStmt::walk(Visitor& visitor)
 {
     visitor.begin(*this);
     visitor.visit(*this);
     expr->walk(visitor);
     stmt->walk(visitor);
+    if (elseStmt)
+        elseStmt->walk(visitor);
     visitor.end(*this);
 }
 
@@ -58,6 +91,27 @@ void FuncDecl::walk(Visitor& visitor)
     visitor.end(*this);
 }
 
+void MatchCase::walk(Visitor& visitor)
+{
+    visitor.begin(*this);
+    visitor.visit(*this);
+    foreach (QSharedPointer<LiteralExpr> value, values)
+        value->walk(visitor);
+    foreach (QSharedPointer<Stmt> stmt, stmts)
+        stmt->walk(visitor);
+    visitor.end(*this);
+}
+
+void MatchStmt::walk(Visitor& visitor)
+{
+    visitor.begin(*this);
+    visitor.visit(*this);
+    expr->walk(visitor);
+    foreach (QSharedPointer<MatchCase> matchCase, cases)
+        matchCase->walk(visitor);
+    visitor.end(*this);
+}
+
 void ReturnStmt::walk(Visitor& visitor)
 {
     visitor.begin(*this);
@@ -120,6 +174,14 @@ void TypeParam::walk(Visitor& visitor)
     visitor.end(*this);
 }
 
+void UnaryExpr::walk(Visitor& visitor)
+{
+    visitor.begin(*this);
+    visitor.visit(*this);
+    expr->walk(visitor);
+    visitor.end(*this);
+}
+
 void VarExpr::walk(Visitor& visitor)
 {
     visitor.begin(*this);
@@ -133,4 +195,14 @@ void VarDeclStmt::walk(Visitor& visitor)
     visitor.visit(*this);
     expr->walk(visitor);
     visitor.end(*this);
+}
+
+void WhileStmt::walk(Visitor& visitor)
+{
+    visitor.begin(*this);
+    visitor.visit(*this);
+    expr->walk(visitor);
+    foreach (QSharedPointer<Stmt> stmt, stmts)
+        stmt->walk(visitor);
+    visitor.end(*this);
 }
\ No newline at end of file
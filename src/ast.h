@@ -7,14 +7,19 @@
 #include "typesystem.h"
 
 // forward declarations
+struct AssignStmt;
 struct BinaryExpr;
+struct ConditionalExpr;
 struct Expr;
+struct ForStmt;
 struct IfStmt;
 struct IncludeDecl;
 struct FuncCallExpr;
 struct FuncDef;
 struct FuncDecl;
 struct LiteralExpr;
+struct MatchCase;
+struct MatchStmt;
 struct ReturnStmt;
 struct Stmt;
 struct TranslationUnit;
@@ -22,51 +27,67 @@ struct TypeCtorExpr;
 struct TypeDecl;
 struct TypeObject;
 struct TypeParam;
+struct UnaryExpr;
 struct VarExpr;
 struct VarDeclStmt;
 struct Visitor;
+struct WhileStmt;
 
 struct Node {
     enum Kind {
         _AliasDecl,
+        _AssignStmt,
         _BinaryExpr,
         _BuiltinDecl,
+        _ConditionalExpr,
+        _ForStmt,
         _IfStmt,
         _IncludeDecl,
         _FuncCallExpr,
         _FuncDef,
         _FuncDecl,
         _LiteralExpr,
+        _MatchCase,
+        _MatchStmt,
         _ReturnStmt,
         _StructDecl,
         _TranslationUnit,
         _TypeCtorExpr,
         _TypeObject,
         _TypeParam,
+        _UnaryExpr,
         _VarDeclStmt,
-        _VarExpr
+        _VarExpr,
+        _WhileStmt
     };
 
     QString kindToString() const
     {
         switch (kind) {
         case _AliasDecl:        return "AliasDecl";
+        case _AssignStmt:       return "AssignStmt";
         case _BinaryExpr:       return "BinaryExpr";
         case _BuiltinDecl:      return "BuiltinDecl";
+        case _ConditionalExpr:  return "ConditionalExpr";
+        case _ForStmt:          return "ForStmt";
         case _IfStmt:           return "IfStmt";
         case _IncludeDecl:      return "IncludeDecl";
         case _FuncCallExpr:     return "FuncCallExpr";
         case _FuncDef:          return "FuncDef";
         case _FuncDecl:         return "FuncDecl";
         case _LiteralExpr:      return "LiteralExpr";
+        case _MatchCase:        return "MatchCase";
+        case _MatchStmt:        return "MatchStmt";
         case _StructDecl:       return "StructDecl";
         case _ReturnStmt:       return "ReturnStmt";
         case _TranslationUnit:  return "TranslationUnit";
         case _TypeCtorExpr:     return "TypeCtorExpr";
         case _TypeObject:       return "TypeObject";
         case _TypeParam:        return "TypeParam";
+        case _UnaryExpr:        return "UnaryExpr";
         case _VarDeclStmt:      return "VarDeclStmt";
         case _VarExpr:          return "VarExpr";
+        case _WhileStmt:        return "WhileStmt";
         }
     }
 
@@ -151,7 +172,15 @@ struct BinaryExpr : public Expr {
         OpAddition,
         OpSubtraction,
         OpMultiplication,
-        OpDivision
+        OpDivision,
+        OpRemainder,
+        OpLogicalAnd,
+        OpLogicalOr,
+        OpBitwiseAnd,
+        OpBitwiseOr,
+        OpBitwiseXor,
+        OpShiftLeft,
+        OpShiftRight
     };
 
     QString opToString() const
@@ -167,9 +196,21 @@ struct BinaryExpr : public Expr {
         case OpSubtraction:           return "-";
         case OpMultiplication:        return "*";
         case OpDivision:              return "/";
+        case OpRemainder:             return "%";
+        case OpLogicalAnd:            return "&&";
+        case OpLogicalOr:             return "||";
+        case OpBitwiseAnd:            return "&";
+        case OpBitwiseOr:             return "|";
+        case OpBitwiseXor:            return "^";
+        case OpShiftLeft:             return "<<";
+        case OpShiftRight:            return ">>";
         }
     }
 
+    bool isComparison() const { return op <= OpGreaterThan; }
+    bool isLogical() const { return op == OpLogicalAnd || op == OpLogicalOr; }
+    bool isBitwise() const { return op >= OpBitwiseAnd; }
+
     BinaryExpr() : Expr(_BinaryExpr) {}
     BinaryOp op;
     QSharedPointer<Expr> lhs;
@@ -177,6 +218,15 @@ struct BinaryExpr : public Expr {
     virtual void walk(Visitor&);
 };
 
+// condition ? lhs : rhs is lhs if the condition is true and rhs otherwise
+struct ConditionalExpr : public Expr {
+    ConditionalExpr() : Expr(_ConditionalExpr) {}
+    QSharedPointer<Expr> condition;
+    QSharedPointer<Expr> lhs;
+    QSharedPointer<Expr> rhs;
+    virtual void walk(Visitor&);
+};
+
 struct FuncCallExpr : public Expr {
     FuncCallExpr() : Expr(_FuncCallExpr) {}
     Token callee;
@@ -191,14 +241,35 @@ struct TypeCtorExpr : public Expr {
     virtual void walk(Visitor&);
 };
 
+// !expr is true if the condition is false and false otherwise
+struct UnaryExpr : public Expr {
+    enum UnaryOp {
+        OpLogicalNot
+    };
+
+    QString opToString() const
+    {
+        switch (op) {
+        case OpLogicalNot:            return "!";
+        }
+    }
+
+    UnaryExpr() : Expr(_UnaryExpr) {}
+    UnaryOp op;
+    QSharedPointer<Expr> expr;
+    virtual void walk(Visitor&);
+};
+
 struct Stmt : public Node {
     Stmt(Kind kind) : Node(kind) {}
 };
 
 struct IfStmt : public Stmt {
     IfStmt() : Stmt(_IfStmt) {}
+    Token hint; // likely or unlikely if given
     QSharedPointer<Expr> expr;
     QSharedPointer<Stmt> stmt;
+    QSharedPointer<Stmt> elseStmt; // null without an else
     virtual void walk(Visitor&);
 };
 
@@ -209,6 +280,70 @@ struct ReturnStmt : public Stmt {
     virtual void walk(Visitor&);
 };
 
+struct LoopStmt : public Stmt {
+    LoopStmt(Kind kind) : Stmt(kind) {}
+    Token keyword;
+    QList<Token> attributes; // each identifier followed by its count if it takes one
+    QList<QSharedPointer<Stmt> > stmts;
+
+    bool hasAttribute(const QString& name) const
+    {
+        foreach (Token attribute, attributes)
+            if (attribute.type == Identifier && attribute.toString() == name)
+                return true;
+        return false;
+    }
+
+    /*!
+     * \brief the count given to an attribute
+     * @return the count or 0 if the attribute is not given
+     */
+    int attributeCount(const QString& name) const
+    {
+        for (int i = 0; i + 1 < attributes.count(); ++i)
+            if (attributes.at(i).type == Identifier && attributes.at(i).toString() == name)
+                return attributes.at(i + 1).type == DecLiteral ? attributes.at(i + 1).toString().toInt() : 0;
+        return 0;
+    }
+};
+
+struct WhileStmt : public LoopStmt {
+    WhileStmt() : LoopStmt(_WhileStmt) {}
+    QSharedPointer<Expr> expr;
+    virtual void walk(Visitor&);
+};
+
+// for (Type name = start, end[, step]) counts name up from start while it is
+// less than end, where end and step are evaluated once before the loop
+struct ForStmt : public LoopStmt {
+    ForStmt() : LoopStmt(_ForStmt) {}
+    Token type;
+    Token name;
+    QSharedPointer<Expr> start;
+    QSharedPointer<Expr> end;
+    QSharedPointer<Expr> step; // null for a step of one
+    virtual void walk(Visitor&);
+};
+
+// case literal[, literal]*: or else: for the statements run when no other case matches
+struct MatchCase : public Node {
+    MatchCase() : Node(_MatchCase) {}
+    Token keyword;
+    QList<QSharedPointer<LiteralExpr> > values;
+    QList<QSharedPointer<Stmt> > stmts;
+    bool isDefault() const { return keyword.type == Else; }
+    virtual void walk(Visitor&);
+};
+
+// match (expr) runs the statements of the one case matching expr, if any
+struct MatchStmt : public Stmt {
+    MatchStmt() : Stmt(_MatchStmt) {}
+    Token keyword;
+    QSharedPointer<Expr> expr;
+    QList<QSharedPointer<MatchCase> > cases;
+    virtual void walk(Visitor&);
+};
+
 struct FuncDef : public Node {
     FuncDef() : Node(_FuncDef) {}
     QList<QSharedPointer<Stmt> > stmts;
@@ -217,11 +352,53 @@ struct FuncDef : public Node {
 
 struct FuncDecl : public TypeDecl {
     FuncDecl() : TypeDecl(_FuncDecl) {}
+    Token keyword;
+    Token end;
     QSharedPointer<TypeObject> returnType;
     QSharedPointer<FuncDef> funcDef;
     QList<Token> attributes;
     virtual void walk(Visitor&);
 
+    bool hasAttribute(const QString& name) const
+    {
+        foreach (Token attribute, attributes)
+            if (attribute.type == Identifier && attribute.toString() == name)
+                return true;
+        return false;
+    }
+
+    /*!
+     * \brief the string arguments of an attribute, without their quotes
+     * @return the arguments in source order or an empty list if there are none
+     */
+    QStringList attributeArgs(const QString& name) const
+    {
+        QStringList args;
+        int i = 0;
+        while (i < attributes.count() && !(attributes.at(i).type == Identifier && attributes.at(i).toString() == name))
+            ++i;
+        for (++i; i < attributes.count() && attributes.at(i).type == StringLiteral; ++i) {
+            QString arg = attributes.at(i).toString();
+            args.append(arg.mid(1, arg.length() - 2));
+        }
+        return args;
+    }
+
+    /*!
+     * \brief whether a call of callee keeps the const or pure claim of this function,
+     * which only holds when callee makes the same or a stronger claim
+     */
+    bool mayCall(FuncDecl* callee) const
+    {
+        if (callee == this)
+            return true;
+        if (hasAttribute("const"))
+            return callee->hasAttribute("const");
+        if (hasAttribute("pure"))
+            return callee->hasAttribute("const") || callee->hasAttribute("pure");
+        return true;
+    }
+
     // inherited from TypeInfo
     virtual TypeRef* returnTypeRef() const { return returnType.data(); }
 };
@@ -246,4 +423,11 @@ struct VarDeclStmt: public Stmt {
     virtual void walk(Visitor&);
 };
 
+struct AssignStmt: public Stmt {
+    AssignStmt() : Stmt(_AssignStmt) {}
+    Token name;
+    QSharedPointer<TypeCtorExpr> expr;
+    virtual void walk(Visitor&);
+};
+
 #endif // ast_h
@@ -34,12 +34,24 @@ void ASTPrinter::end(Node&)
     m_scope--;
 }
 
+void ASTPrinter::visit(AssignStmt& node)
+{
+    *m_stream << indent() << node.name.toString() << "\n";
+    m_stream->flush();
+}
+
 void ASTPrinter::visit(BinaryExpr& node)
 {
     *m_stream << indent() << node.opToString() << "\n";
     m_stream->flush();
 }
 
+void ASTPrinter::visit(ForStmt& node)
+{
+    *m_stream << indent() << node.type.toString() << " " << node.name.toString() << "\n";
+    m_stream->flush();
+}
+
 void ASTPrinter::visit(IncludeDecl& node)
 {
     *m_stream << indent() << "include " << node.include.toString() << "\n";
@@ -86,6 +98,12 @@ void ASTPrinter::visit(TypeObject& node)
     m_stream->flush();
 }
 
+void ASTPrinter::visit(UnaryExpr& node)
+{
+    *m_stream << indent() << node.opToString() << "\n";
+    m_stream->flush();
+}
+
 void ASTPrinter::visit(TypeParam& node)
 {
     *m_stream << indent() << node.name.toString() << "\n";
@@ -15,7 +15,9 @@ public:
     virtual void begin(Node&);
     virtual void end(Node&);
 
+    virtual void visit(AssignStmt&);
     virtual void visit(BinaryExpr&);
+    virtual void visit(ForStmt&);
     virtual void visit(IncludeDecl&);
     virtual void visit(FuncCallExpr&);
     virtual void visit(FuncDecl&);
@@ -24,6 +26,7 @@ public:
     virtual void visit(TypeDecl&);
     virtual void visit(TypeParam&);
     virtual void visit(TypeObject&);
+    virtual void visit(UnaryExpr&);
     virtual void visit(VarExpr&);
     virtual void visit(VarDeclStmt&);
 
@@ -0,0 +1,694 @@
+#include "bytecode.h"
+#include "ast.h"
+#include "constantevaluator.h"
+#include "filesources.h"
+#include "sourcebuffer.h"
+
+#ifdef Q_OS_UNIX
+#include <dlfcn.h>
+#endif
+
+// Extern functions are called through a function pointer taking this many
+// integer or pointer arguments, all of which the calling convention passes in
+// registers on the supported targets
+static const int s_maxExternParameters = 6;
+
+static int shiftForType(TypeInfo* info)
+{
+    int bits = info && info->bitWidth() ? info->bitWidth() : 64;
+    return 64 - bits;
+}
+
+static bool isFloatingPoint(TypeInfo* info)
+{
+    return info && info->isFloatingPoint();
+}
+
+Bytecode::Bytecode(SourceBuffer* source)
+    : m_source(source)
+    , m_program(new Program)
+    , m_declPass(true)
+    , m_function(0)
+    , m_returnInfo(0)
+    , m_nextRegister(0)
+{
+}
+
+Bytecode::Bytecode(SourceBuffer* source, QSharedPointer<Program> program)
+    : m_source(source)
+    , m_program(program)
+    , m_declPass(true)
+    , m_function(0)
+    , m_returnInfo(0)
+    , m_nextRegister(0)
+{
+}
+
+Bytecode::~Bytecode()
+{
+}
+
+void Bytecode::compile()
+{
+    m_program->buffers.insert(m_source);
+    walk();
+}
+
+void Bytecode::walk()
+{
+    // The first pass registers every function so calls can refer to functions
+    // declared after them
+    Visitor::walk(m_source->translationUnit());
+    m_declPass = false;
+    Visitor::walk(m_source->translationUnit());
+}
+
+void Bytecode::visit(IncludeDecl& node)
+{
+    if (!m_declPass)
+        return;
+
+    QString include = node.include.toString();
+    include.remove(0, 1); // remove leading quote
+    include.chop(1); // remove trailing quote
+
+    SourceBuffer* buffer = FileSources::instance()->sourceBuffer(include);
+    if (!buffer) {
+        m_source->error(node.include, "Could not find or open include file", SourceBuffer::Fatal);
+        return;
+    }
+
+    if (!m_program->buffers.contains(buffer)) {
+        m_program->buffers.insert(buffer);
+
+        Bytecode bytecode(buffer, m_program);
+        bytecode.walk();
+        m_source->addErrors(buffer->numberOfErrors());
+    }
+
+    m_source->typeSystem().importTypes(buffer->typeSystem());
+}
+
+void Bytecode::visit(FuncDecl& node)
+{
+    if (m_declPass) {
+        registerFuncDecl(&node);
+        return;
+    }
+
+    FuncDef* funcDef = node.funcDef.data();
+    if (!funcDef)
+        return;
+
+    m_function = &m_program->functions[m_program->functionIndex.value(node.name.toString())];
+    m_namedRegisters.clear();
+    m_source->typeSystem().clearNamedTypes();
+    m_nextRegister = 0;
+    m_returnInfo = m_source->typeSystem().toTypeAndCheck(node.returnType->type);
+
+    // The arguments of a call arrive in the first registers of the frame
+    foreach (QSharedPointer<TypeObject> object, node.objects) {
+        TypeInfo* type = m_source->typeSystem().toTypeAndCheck(object->type);
+        m_source->typeSystem().insertNamedType(object->name.toString(), type);
+        m_namedRegisters.insert(object->name.toString(), allocateRegister());
+    }
+
+    foreach (QSharedPointer<Stmt> stmt, funcDef->stmts)
+        compile(stmt.data());
+
+    m_function = 0;
+}
+
+void Bytecode::checkScalar(const Token& tok, TypeInfo* info)
+{
+    // Registers hold one scalar each
+    if (info && info->lanes())
+        m_source->error(tok, "vector types are not supported by the interpreter", SourceBuffer::Fatal);
+}
+
+void Bytecode::registerFuncDecl(FuncDecl* node)
+{
+    QString name = node->name.toString();
+    TypeInfo* returnInfo = m_source->typeSystem().toTypeAndCheck(node->returnType->type);
+
+    checkScalar(node->returnType->type, returnInfo);
+    foreach (QSharedPointer<TypeObject> object, node->objects)
+        checkScalar(object->type, m_source->typeSystem().toTypeAndCheck(object->type));
+
+    if (!node->funcDef) {
+        if (node->objects.count() > s_maxExternParameters) {
+            m_source->error(node->name, "extern function has too many parameters to be interpreted", SourceBuffer::Fatal);
+            return;
+        }
+
+        foreach (QSharedPointer<TypeObject> object, node->objects) {
+            if (isFloatingPoint(m_source->typeSystem().toTypeAndCheck(object->type))) {
+                m_source->error(object->type, "extern function with floating point parameters can not be interpreted",
+                                SourceBuffer::Fatal);
+                return;
+            }
+        }
+
+        if (isFloatingPoint(returnInfo)) {
+            m_source->error(node->returnType->type,
+                            "extern function with floating point result can not be interpreted", SourceBuffer::Fatal);
+            return;
+        }
+
+        Extern function;
+        function.name = name;
+        function.parameterCount = node->objects.count();
+#ifdef Q_OS_UNIX
+        function.address = dlsym(RTLD_DEFAULT, name.toLatin1().constData());
+#else
+        function.address = 0;
+#endif
+        if (!function.address) {
+            m_source->error(node->name, "extern function could not be found for the interpreter", SourceBuffer::Fatal);
+            return;
+        }
+
+        m_program->externIndex.insert(name, m_program->externs.count());
+        m_program->externs.append(function);
+        return;
+    }
+
+    Function function;
+    function.name = name;
+    function.parameterCount = node->objects.count();
+    function.registerCount = 0;
+    function.resultShift = shiftForType(returnInfo);
+    function.isSignedResult = returnInfo->isSignedInt();
+    m_program->functionIndex.insert(name, m_program->functions.count());
+    m_program->functions.append(function);
+}
+
+void Bytecode::compile(Stmt* node)
+{
+    // Temporaries only live until the end of their statement
+    m_nextRegister = m_namedRegisters.count();
+
+    switch (node->kind) {
+    case Node::_IfStmt:
+        compile(static_cast<IfStmt*>(node));
+        break;
+    case Node::_ReturnStmt:
+        compile(static_cast<ReturnStmt*>(node));
+        break;
+    case Node::_VarDeclStmt:
+        compile(static_cast<VarDeclStmt*>(node));
+        break;
+    case Node::_AssignStmt:
+        compile(static_cast<AssignStmt*>(node));
+        break;
+    case Node::_WhileStmt:
+        compile(static_cast<WhileStmt*>(node));
+        break;
+    case Node::_ForStmt:
+        compile(static_cast<ForStmt*>(node));
+        break;
+    case Node::_MatchStmt:
+        compile(static_cast<MatchStmt*>(node));
+        break;
+    default:
+        assert(false); // should not be reached
+        return;
+    }
+}
+
+void Bytecode::compile(IfStmt* node)
+{
+    int condition = compile(node->expr.data(), typeInfoForExpr(node->expr.data()));
+    int branch = emit(JumpIfFalse, 0, condition);
+
+    compile(node->stmt.data());
+
+    if (node->elseStmt) {
+        int skip = emit(Jump, 0);
+        m_function->code[branch].imm.i = m_function->code.count();
+        compile(node->elseStmt.data());
+        branch = skip;
+    }
+
+    m_function->code[branch].imm.i = m_function->code.count();
+}
+
+void Bytecode::compile(ReturnStmt* node)
+{
+    emit(Return, 0, compile(node->expr.data(), m_returnInfo));
+}
+
+void Bytecode::compile(VarDeclStmt* node)
+{
+    TypeInfo* info = m_source->typeSystem().toTypeAndCheck(node->type);
+    checkScalar(node->type, info);
+    int value = compile(node->expr.data(), info);
+
+    // The variable takes the next register after the named ones so the
+    // temporaries of later statements never overwrite it
+    QString name = node->name.toString();
+    int reg = m_namedRegisters.value(name, m_namedRegisters.count());
+    if (value != reg)
+        emit(Move, reg, value);
+    m_function->registerCount = qMax(m_function->registerCount, reg + 1);
+    m_namedRegisters.insert(name, reg);
+    m_source->typeSystem().insertNamedType(name, info);
+    m_nextRegister = m_namedRegisters.count();
+}
+
+void Bytecode::compile(AssignStmt* node)
+{
+    QString name = node->name.toString();
+    if (!m_namedRegisters.contains(name)) {
+        m_source->error(node->name, "unknown variable name", SourceBuffer::Fatal);
+        return;
+    }
+
+    int reg = m_namedRegisters.value(name);
+    int value = compile(node->expr.data(), m_source->typeSystem().namedTypes().value(name));
+    if (value != reg)
+        emit(Move, reg, value);
+}
+
+void Bytecode::compile(WhileStmt* node)
+{
+    int header = m_function->code.count();
+    int condition = compile(node->expr.data(), typeInfoForExpr(node->expr.data()));
+    int branch = emit(JumpIfFalse, 0, condition);
+
+    compileBlock(node->stmts);
+    emit(Jump, 0, 0, 0, header);
+
+    m_function->code[branch].imm.i = m_function->code.count();
+}
+
+void Bytecode::compile(ForStmt* node)
+{
+    TypeInfo* info = m_source->typeSystem().resolveAlias(m_source->typeSystem().toTypeAndCheck(node->type));
+    checkScalar(node->type, info);
+
+    // The counter, the end and the step, which are evaluated once, take named
+    // registers under names no variable can have
+    QHash<QString, int> namedRegisters = m_namedRegisters;
+    int counter = m_namedRegisters.count();
+    for (int reg = counter; reg < counter + 3; ++reg)
+        m_namedRegisters.insert(' ' + QString::number(reg), reg);
+    m_function->registerCount = qMax(m_function->registerCount, counter + 3);
+
+    m_nextRegister = m_namedRegisters.count();
+    int value = compile(node->start.data(), info);
+    emit(Move, counter, value);
+    value = compile(node->end.data(), info);
+    emit(Move, counter + 1, value);
+    if (node->step) {
+        value = compile(node->step.data(), info);
+        emit(Move, counter + 2, value);
+    } else {
+        emit(Constant, counter + 2, 0, 0, 1);
+    }
+
+    QHash<QString, TypeInfo*> namedTypes = m_source->typeSystem().namedTypes();
+    m_namedRegisters.insert(node->name.toString(), counter);
+    m_source->typeSystem().insertNamedType(node->name.toString(), info);
+    m_nextRegister = m_namedRegisters.count();
+
+    // A step that is not positive runs the body no times
+    int shift = shiftForType(info);
+    int zero = allocateRegister();
+    emit(Constant, zero, 0, 0, 0);
+    int positive = allocateRegister();
+    emit(info->isSignedInt() ? LessThanSigned : LessThanUnsigned, positive, zero, counter + 2, shift);
+    int skip = emit(JumpIfFalse, 0, positive);
+
+    int header = m_function->code.count();
+    int condition = allocateRegister();
+    emit(info->isSignedInt() ? LessThanSigned : LessThanUnsigned, condition, counter, counter + 1, shift);
+    int branch = emit(JumpIfFalse, 0, condition);
+
+    // The loop ends when the step would take the counter to or past the end, so
+    // the counter never wraps as it would in the generated code
+    compileBlock(node->stmts);
+    int remaining = allocateRegister();
+    emit(SubInt, remaining, counter + 1, counter);
+    int last = allocateRegister();
+    emit(LessThanOrEqualUnsigned, last, remaining, counter + 2, shift);
+    int done = emit(JumpIfTrue, 0, last);
+    emit(AddInt, counter, counter, counter + 2);
+    emit(Jump, 0, 0, 0, header);
+
+    m_function->code[skip].imm.i = m_function->code.count();
+    m_function->code[branch].imm.i = m_function->code.count();
+    m_function->code[done].imm.i = m_function->code.count();
+    m_namedRegisters = namedRegisters;
+    m_source->typeSystem().setNamedTypes(namedTypes);
+}
+
+void Bytecode::compile(MatchStmt* node)
+{
+    TypeInfo* info = typeInfoForExpr(node->expr.data());
+    int subject = compile(node->expr.data(), info);
+    int shift = shiftForType(info);
+
+    // Every value is compared before any case runs, since the statements of a
+    // case reuse the registers holding the subject and the temporaries
+    QList<QPair<int, int> > branches;
+    int otherwise = -1;
+    for (int i = 0; i < node->cases.count(); ++i) {
+        MatchCase* matchCase = node->cases.at(i).data();
+        if (matchCase->isDefault())
+            otherwise = i;
+
+        foreach (QSharedPointer<LiteralExpr> literal, matchCase->values) {
+            ConstantEvaluator evaluator(m_source, SourceBuffer::Fatal);
+            ConstantEvaluator::Value constant;
+            evaluator.evaluate(literal.data(), info, &constant);
+
+            int value = allocateRegister();
+            emit(Constant, value, 0, 0, quint64(constant.integer));
+            int equal = allocateRegister();
+            emit(EqualInt, equal, subject, value, shift);
+            branches.append(qMakePair(emit(JumpIfTrue, 0, equal), i));
+        }
+    }
+    int unmatched = emit(Jump, 0);
+
+    QList<int> starts;
+    QList<int> exits;
+    for (int i = 0; i < node->cases.count(); ++i) {
+        starts.append(m_function->code.count());
+        compileBlock(node->cases.at(i)->stmts);
+        exits.append(emit(Jump, 0));
+    }
+
+    typedef QPair<int, int> Branch;
+    foreach (Branch branch, branches)
+        m_function->code[branch.first].imm.i = starts.at(branch.second);
+    foreach (int end, exits)
+        m_function->code[end].imm.i = m_function->code.count();
+
+    // A subject matching no value runs the else case or none at all
+    m_function->code[unmatched].imm.i = otherwise == -1 ? m_function->code.count() : starts.at(otherwise);
+}
+
+void Bytecode::compileBlock(const QList<QSharedPointer<Stmt> >& stmts)
+{
+    // Variables declared in a block go out of scope with it
+    QHash<QString, int> namedRegisters = m_namedRegisters;
+    QHash<QString, TypeInfo*> namedTypes = m_source->typeSystem().namedTypes();
+    foreach (QSharedPointer<Stmt> stmt, stmts)
+        compile(stmt.data());
+    m_namedRegisters = namedRegisters;
+    m_source->typeSystem().setNamedTypes(namedTypes);
+    m_nextRegister = m_namedRegisters.count();
+}
+
+int Bytecode::compile(Expr* node, TypeInfo* info)
+{
+    switch (node->kind) {
+    case Node::_BinaryExpr:
+        return compile(static_cast<BinaryExpr*>(node), info);
+    case Node::_ConditionalExpr:
+        return compile(static_cast<ConditionalExpr*>(node), info);
+    case Node::_FuncCallExpr:
+        return compile(static_cast<FuncCallExpr*>(node));
+    case Node::_LiteralExpr:
+        return compile(static_cast<LiteralExpr*>(node), info);
+    case Node::_VarExpr:
+        return compile(static_cast<VarExpr*>(node));
+    case Node::_TypeCtorExpr:
+        return compile(static_cast<TypeCtorExpr*>(node), info);
+    case Node::_UnaryExpr:
+        return compile(static_cast<UnaryExpr*>(node));
+    default:
+        assert(false); // should not be reached
+        return 0;
+    }
+}
+
+int Bytecode::compile(BinaryExpr* node, TypeInfo* outerInfo)
+{
+    // Expressions of literals are folded in the type of their context
+    if (ConstantEvaluator::isLiteral(node)) {
+        ConstantEvaluator evaluator(m_source, SourceBuffer::Fatal);
+        ConstantEvaluator::Value constant;
+        if (!evaluator.evaluate(node, outerInfo, &constant))
+            return 0;
+
+        Value value;
+        value.i = quint64(constant.integer);
+        if (!node->isComparison() && isFloatingPoint(outerInfo))
+            value.d = constant.real;
+
+        int dst = allocateRegister();
+        emit(Constant, dst, 0, 0, value.i);
+        return dst;
+    }
+
+    // The right operand is skipped when the left one decides the result
+    if (node->isLogical()) {
+        TypeInfo* bit = m_source->typeSystem().bitType();
+        int dst = allocateRegister();
+        emit(Move, dst, compile(node->lhs.data(), bit));
+        int branch = emit(node->op == BinaryExpr::OpLogicalAnd ? JumpIfFalse : JumpIfTrue, 0, dst);
+        emit(Move, dst, compile(node->rhs.data(), bit));
+        m_function->code[branch].imm.i = m_function->code.count();
+        return dst;
+    }
+
+    TypeInfo* info = typeInfoForExpr(node->lhs.data());
+    if (!info)
+        info = typeInfoForExpr(node->rhs.data());
+    assert(info);
+
+    int l = compile(node->lhs.data(), info);
+    int r = compile(node->rhs.data(), info);
+    int dst = allocateRegister();
+    int shift = shiftForType(info);
+    bool isDouble = isFloatingPoint(info);
+    bool isFloat = isDouble && info->bitWidth() == 32;
+    bool isSigned = info->isSignedInt();
+
+    int op = 0;
+    switch (node->op) {
+    case BinaryExpr::OpEquality:
+        op = isDouble ? EqualDouble : EqualInt;
+        break;
+    case BinaryExpr::OpNotEquality:
+        op = isDouble ? NotEqualDouble : NotEqualInt;
+        break;
+    case BinaryExpr::OpGreaterThanOrEquality:
+        qSwap(l, r); // greater than is less than with the operands swapped
+    case BinaryExpr::OpLessThanOrEquality:
+        op = isDouble ? LessThanOrEqualDouble : isSigned ? LessThanOrEqualSigned : LessThanOrEqualUnsigned;
+        break;
+    case BinaryExpr::OpGreaterThan:
+        qSwap(l, r);
+    case BinaryExpr::OpLessThan:
+        op = isDouble ? LessThanDouble : isSigned ? LessThanSigned : LessThanUnsigned;
+        break;
+    case BinaryExpr::OpAddition:
+        op = isFloat ? AddFloat : isDouble ? AddDouble : AddInt;
+        break;
+    case BinaryExpr::OpSubtraction:
+        op = isFloat ? SubFloat : isDouble ? SubDouble : SubInt;
+        break;
+    case BinaryExpr::OpMultiplication:
+        op = isFloat ? MulFloat : isDouble ? MulDouble : MulInt;
+        break;
+    case BinaryExpr::OpDivision:
+        op = isFloat ? DivFloat : isDouble ? DivDouble : isSigned ? DivSigned : DivUnsigned;
+        break;
+    case BinaryExpr::OpRemainder:
+        op = isDouble ? RemDouble : isSigned ? RemSigned : RemUnsigned;
+        break;
+    case BinaryExpr::OpLogicalAnd:
+    case BinaryExpr::OpLogicalOr:
+        assert(false); // should not be reached
+        return 0;
+    case BinaryExpr::OpBitwiseAnd:
+        op = AndInt;
+        break;
+    case BinaryExpr::OpBitwiseOr:
+        op = OrInt;
+        break;
+    case BinaryExpr::OpBitwiseXor:
+        op = XorInt;
+        break;
+    case BinaryExpr::OpShiftLeft:
+        op = ShiftLeft;
+        break;
+    case BinaryExpr::OpShiftRight:
+        op = isSigned ? ShiftRightSigned : ShiftRightUnsigned;
+        break;
+    }
+
+    emit(op, dst, l, r, shift);
+    return dst;
+}
+
+int Bytecode::compile(ConditionalExpr* node, TypeInfo* info)
+{
+    if (!info)
+        info = typeInfoForExpr(node);
+
+    // Only the side the condition selects is evaluated, into a register of
+    // the expression
+    int condition = compile(node->condition.data(), typeInfoForExpr(node->condition.data()));
+    int dst = allocateRegister();
+    int branch = emit(JumpIfFalse, 0, condition);
+    emit(Move, dst, compile(node->lhs.data(), info));
+    int skip = emit(Jump, 0);
+    m_function->code[branch].imm.i = m_function->code.count();
+    emit(Move, dst, compile(node->rhs.data(), info));
+    m_function->code[skip].imm.i = m_function->code.count();
+    return dst;
+}
+
+int Bytecode::compile(FuncCallExpr* node)
+{
+    if (TypeSystem::isVectorFunction(node->callee)) {
+        m_source->error(node->callee, "builtin vector functions are not supported by the interpreter", SourceBuffer::Fatal);
+        return 0;
+    }
+
+    if (TypeSystem::isBuiltinFunction(node->callee))
+        return compileIntrinsic(node);
+
+    QString callee = node->callee.toString();
+    FuncDecl* function = static_cast<FuncDecl*>(m_source->typeSystem().toType(callee));
+    assert(function && function->isFunction());
+
+    QList<int> args;
+    for (int i = 0; i < node->args.count(); ++i) {
+        TypeInfo* info = m_source->typeSystem().toTypeAndCheck(function->objects.at(i)->type);
+        args.append(compile(node->args.at(i).data(), info));
+    }
+
+    int arguments = m_function->arguments.count();
+    foreach (int arg, args)
+        m_function->arguments.append(arg);
+
+    int dst = allocateRegister();
+    if (m_program->externIndex.contains(callee))
+        emit(CallExtern, dst, m_program->externIndex.value(callee), arguments);
+    else
+        emit(Call, dst, m_program->functionIndex.value(callee), arguments);
+    return dst;
+}
+
+int Bytecode::compileIntrinsic(FuncCallExpr* node)
+{
+    QString callee = node->callee.toString();
+    TypeInfo* info = m_source->typeSystem().resolveAlias(typeInfoForExpr(node->args.first().data()));
+    QList<int> args;
+    foreach (QSharedPointer<Expr> arg, node->args)
+        args.append(compile(arg.data(), info));
+
+    // Expecting a value and prefetching only guide the generated code
+    if (callee == "_builtin_expect_" || callee == "_builtin_prefetch_")
+        return args.first();
+
+    int dst = allocateRegister();
+    int shift = shiftForType(info);
+    bool isFloat = info->bitWidth() == 32;
+    if (callee == "_builtin_ctpop_")
+        emit(PopCount, dst, args.at(0), 0, shift);
+    else if (callee == "_builtin_ctlz_")
+        emit(CountLeadingZeros, dst, args.at(0), 0, shift);
+    else if (callee == "_builtin_cttz_")
+        emit(CountTrailingZeros, dst, args.at(0), 0, shift);
+    else if (callee == "_builtin_bswap_")
+        emit(ByteSwap, dst, args.at(0), 0, shift);
+    else if (callee == "_builtin_sqrt_")
+        emit(isFloat ? SqrtFloat : SqrtDouble, dst, args.at(0));
+    else if (callee == "_builtin_fma_")
+        emit(isFloat ? FmaFloat : FmaDouble, dst, args.at(0), args.at(1), args.at(2));
+    else
+        assert(false); // should not be reached
+    return dst;
+}
+
+int Bytecode::compile(LiteralExpr* node, TypeInfo* info)
+{
+    assert(info);
+
+    Value value;
+    value.i = 0;
+    TokenType type = node->literal.type;
+    if (type == True || type == False) {
+        value.i = type == True;
+    } else if (type == StringLiteral) {
+        QString literal = node->literal.toString();
+        literal.remove(0, 1); // remove leading quote
+        literal.chop(1); // remove trailing quote
+        m_program->strings.append(literal.toUtf8());
+        value.i = quintptr(m_program->strings.last().constData());
+    } else if (type == FloatLiteral) {
+        value.d = node->literal.toString().toDouble();
+        if (info->bitWidth() == 32)
+            value.d = float(value.d);
+    } else if (info->isSignedInt()) {
+        value.i = integerLiteralToString(node->literal).toLongLong(0, integerTypeToBase(type));
+    } else {
+        value.i = integerLiteralToString(node->literal).toULongLong(0, integerTypeToBase(type));
+    }
+
+    int dst = allocateRegister();
+    emit(Constant, dst, 0, 0, value.i);
+    return dst;
+}
+
+int Bytecode::compile(TypeCtorExpr* node, TypeInfo* info)
+{
+    if (node->type.type == Undefined)
+        return compile(node->args.first().data(), info);
+
+    m_source->error(node->type, "type constructors are not supported by the interpreter", SourceBuffer::Fatal);
+    return 0;
+}
+
+int Bytecode::compile(UnaryExpr* node)
+{
+    // Only the lowest bit of a bit is defined so flipping it negates the condition
+    int condition = compile(node->expr.data(), m_source->typeSystem().bitType());
+    int one = allocateRegister();
+    emit(Constant, one, 0, 0, 1);
+    int dst = allocateRegister();
+    emit(XorInt, dst, condition, one);
+    return dst;
+}
+
+int Bytecode::compile(VarExpr* node)
+{
+    QString name = node->var.toString();
+    if (!m_namedRegisters.contains(name)) {
+        m_source->error(node->var, "unknown variable name", SourceBuffer::Fatal);
+        return 0;
+    }
+    return m_namedRegisters.value(name);
+}
+
+int Bytecode::emit(int op, int dst, int a, int b, quint64 imm)
+{
+    Instruction instruction;
+    instruction.op = op;
+    instruction.dst = dst;
+    instruction.a = a;
+    instruction.b = b;
+    instruction.imm.i = imm;
+    m_function->code.append(instruction);
+    return m_function->code.count() - 1;
+}
+
+int Bytecode::allocateRegister()
+{
+    m_function->registerCount = qMax(m_function->registerCount, m_nextRegister + 1);
+    return m_nextRegister++;
+}
+
+TypeInfo* Bytecode::typeInfoForExpr(Expr* node) const
+{
+    if (node->kind == Node::_LiteralExpr)
+        return 0;
+    return m_source->typeSystem().resolveAlias(m_source->typeSystem().typeInfoForExpr(node));
+}
@@ -0,0 +1,167 @@
+#ifndef bytecode_h
+#define bytecode_h
+
+#include <QtCore>
+#include "visitor.h"
+
+class SourceBuffer;
+struct TypeInfo;
+
+class Bytecode : public Visitor {
+public:
+    enum Opcode {
+        Constant,           // dst = imm
+        Move,               // dst = a
+        AddInt,             // dst = a + b, wrapping in 64 bits
+        SubInt,
+        MulInt,
+        AddFloat,           // dst = a + b, rounded to float
+        SubFloat,
+        MulFloat,
+        AddDouble,          // dst = a + b
+        SubDouble,
+        MulDouble,
+        DivSigned,          // dst = (a << imm >> imm) / (b << imm >> imm) as signed
+        DivUnsigned,        // dst = (a << imm >> imm) / (b << imm >> imm) as unsigned
+        RemSigned,
+        RemUnsigned,
+        DivFloat,           // dst = a / b, rounded to float
+        DivDouble,          // dst = a / b
+        RemDouble,          // dst = fmod(a, b), which is exact and so also rounded for floats
+        AndInt,             // dst = a & b
+        OrInt,
+        XorInt,
+        ShiftLeft,          // dst = a << (b & (63 - imm))
+        ShiftRightSigned,   // dst = (a << imm >> imm) >> (b & (63 - imm)) as signed
+        ShiftRightUnsigned, // dst = (a << imm >> imm) >> (b & (63 - imm)) as unsigned
+        PopCount,           // dst = number of bits set in a << imm
+        CountLeadingZeros,  // dst = leading zeros of a << imm >> imm, less imm
+        CountTrailingZeros, // dst = trailing zeros of a << imm, less imm
+        ByteSwap,           // dst = bytes of a << imm in reverse order
+        SqrtFloat,          // dst = sqrt(a), rounded to float
+        SqrtDouble,
+        FmaFloat,           // dst = a * b + registers[imm], rounded once to float
+        FmaDouble,
+        EqualInt,           // dst = (a << imm) == (b << imm)
+        NotEqualInt,
+        LessThanSigned,     // dst = (a << imm) < (b << imm) as signed
+        LessThanOrEqualSigned,
+        LessThanUnsigned,   // dst = (a << imm) < (b << imm) as unsigned
+        LessThanOrEqualUnsigned,
+        EqualDouble,        // dst = a == b, ordered
+        NotEqualDouble,
+        LessThanDouble,
+        LessThanOrEqualDouble,
+        Jump,               // pc = imm
+        JumpIfFalse,        // if !a: pc = imm
+        JumpIfTrue,         // if a: pc = imm
+        Call,               // dst = functions[a](arguments[b]...)
+        CallExtern,         // dst = externs[a](arguments[b]...)
+        Return,             // return a
+        OpcodeCount
+    };
+
+    union Value {
+        quint64 i;
+        double d;
+    };
+
+    // Integers are kept in 64 bit registers with undefined bits above their width
+    // since the low bits of a sum or product only depend upon the low bits of its
+    // operands; comparisons shift the width into the high bits instead and
+    // quotients extend their operands from the width first
+    struct Instruction {
+        int op;
+        int dst;
+        int a;
+        int b;
+        Value imm;
+    };
+
+    struct Function {
+        QString name;
+        int parameterCount;
+        int registerCount;
+        int resultShift;
+        bool isSignedResult;
+        QVector<Instruction> code;
+        QVector<int> arguments;
+    };
+
+    struct Extern {
+        QString name;
+        void* address;
+        int parameterCount;
+    };
+
+    struct Program {
+        QVector<Function> functions;
+        QVector<Extern> externs;
+        QHash<QString, int> functionIndex;
+        QHash<QString, int> externIndex;
+        QList<QByteArray> strings;
+        QSet<SourceBuffer*> buffers;
+    };
+
+    Bytecode(SourceBuffer* source);
+    ~Bytecode();
+
+    /*!
+     * \brief walks the type checked AST and compiles every function it and its includes
+     * define into register based bytecode
+     */
+    void compile();
+
+    /*!
+     * \brief the compiled functions and the extern functions they call
+     */
+    const Program& program() const { return *m_program; }
+
+    /*!
+     * \brief the index of a compiled function in the program
+     * @return the index or -1 if the program does not define it
+     */
+    int functionIndex(const QString& name) const { return m_program->functionIndex.value(name, -1); }
+
+private:
+    Bytecode(SourceBuffer* source, QSharedPointer<Program> program);
+    void walk();
+    virtual void begin(Node&) {}
+    virtual void end(Node&) {}
+    virtual void visit(IncludeDecl&);
+    virtual void visit(FuncDecl&);
+    void registerFuncDecl(FuncDecl* node);
+    void checkScalar(const Token& tok, TypeInfo* info);
+    void compile(Stmt* node);
+    void compile(IfStmt* node);
+    void compile(ReturnStmt* node);
+    void compile(VarDeclStmt* node);
+    void compile(AssignStmt* node);
+    void compile(WhileStmt* node);
+    void compile(ForStmt* node);
+    void compile(MatchStmt* node);
+    void compileBlock(const QList<QSharedPointer<Stmt> >& stmts);
+    int compile(Expr* node, TypeInfo* info);
+    int compile(BinaryExpr* node, TypeInfo* info);
+    int compile(ConditionalExpr* node, TypeInfo* info);
+    int compile(FuncCallExpr* node);
+    int compileIntrinsic(FuncCallExpr* node);
+    int compile(LiteralExpr* node, TypeInfo* info);
+    int compile(TypeCtorExpr* node, TypeInfo* info);
+    int compile(UnaryExpr* node);
+    int compile(VarExpr* node);
+    int emit(int op, int dst, int a = 0, int b = 0, quint64 imm = 0);
+    int allocateRegister();
+    TypeInfo* typeInfoForExpr(Expr* node) const;
+
+private:
+    SourceBuffer* m_source;
+    QSharedPointer<Program> m_program;
+    bool m_declPass;
+    Function* m_function;
+    TypeInfo* m_returnInfo;
+    QHash<QString, int> m_namedRegisters;
+    int m_nextRegister;
+};
+
+#endif // bytecode_h
@@ -1,22 +1,32 @@
 #include "codegen.h"
 #include "filesources.h"
-#include "lexer.h"
-#include "parser.h"
+#include "objectcache.h"
 #include "options.h"
 #include "sourcebuffer.h"
+#include "target.h"
 
+#include <algorithm>
 #include <limits>
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-parameter"
 
+#include <llvm/ADT/Triple.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
+#include <llvm/PassManager.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/Utils/Cloning.h>
 
 #pragma clang diagnostic pop
 
@@ -55,7 +65,15 @@ CodeGen::CodeGen(SourceBuffer* buffer)
     , m_module(new llvm::Module(LLVMString(buffer->module()), (*m_context)))
     , m_builder(new llvm::Builder(*m_context))
     , m_declPass(true)
+    , m_function(0)
+    , m_tailCallHeader(0)
+    , m_evaluator(buffer, SourceBuffer::Fatal)
 {
+    // The object cache keys a function by the signatures of its callees only so
+    // the bodies of callees must not be folded into cached functions
+    m_evaluator.setEvaluateCalls(Options::instance()->optimizationLevel() > 0
+                                 && Options::instance()->cacheDir().isEmpty());
+    Target::instance()->configure(m_module.data());
     registerBuiltins();
 }
 
@@ -65,7 +83,13 @@ CodeGen::CodeGen(SourceBuffer* buffer, Context context, Module module)
     , m_module(module)
     , m_builder(new llvm::Builder(*m_context))
     , m_declPass(true)
+    , m_function(0)
+    , m_tailCallHeader(0)
+    , m_evaluator(buffer, SourceBuffer::Fatal)
 {
+    m_evaluator.setEvaluateCalls(Options::instance()->optimizationLevel() > 0
+                                 && Options::instance()->cacheDir().isEmpty());
+    Target::instance()->configure(m_module.data());
     registerBuiltins();
 }
 
@@ -73,19 +97,283 @@ CodeGen::~CodeGen()
 {
 }
 
-QString CodeGen::generateLLVMIR()
+static bool printModule(llvm::Module* module, const QString& file)
+{
+    if (file.isEmpty()) {
+        module->print(llvm::outs(), 0);
+        llvm::outs().flush();
+        return true;
+    }
+
+    std::error_code error;
+    llvm::raw_fd_ostream stream(LLVMString(file), error, llvm::sys::fs::F_Text);
+    if (error)
+        return false;
+
+    module->print(stream, 0);
+    stream.close();
+    return !stream.has_error();
+}
+
+static unsigned instructionCount(llvm::Function* f)
+{
+    unsigned count = 0;
+    for (llvm::Function::iterator it = f->begin(); it != f->end(); ++it)
+        count += it->size();
+    return count;
+}
+
+static llvm::Function* firstUserFunction(llvm::Value* value)
+{
+    for (llvm::Value::user_iterator it = value->user_begin(); it != value->user_end(); ++it) {
+        if (llvm::Instruction* instruction = llvm::dyn_cast<llvm::Instruction>(*it))
+            return instruction->getParent()->getParent();
+        if (llvm::isa<llvm::Constant>(*it)) {
+            if (llvm::Function* f = firstUserFunction(*it))
+                return f;
+        }
+    }
+    return 0;
+}
+
+static bool isUsedOutside(llvm::Value* value, llvm::Function* owner)
+{
+    for (llvm::Value::user_iterator it = value->user_begin(); it != value->user_end(); ++it) {
+        if (llvm::Instruction* instruction = llvm::dyn_cast<llvm::Instruction>(*it)) {
+            if (instruction->getParent()->getParent() != owner)
+                return true;
+        } else if (llvm::GlobalValue* global = llvm::dyn_cast<llvm::GlobalValue>(*it)) {
+            if (firstUserFunction(global) != owner)
+                return true;
+        } else if (isUsedOutside(*it, owner)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The claims are checked against the calls of the body as it is generated
+static void addMemoryAttributes(FuncDecl* node, llvm::Function* f)
+{
+    if (node->hasAttribute("const"))
+        f->addFnAttr(llvm::Attribute::ReadNone);
+    else if (node->hasAttribute("pure"))
+        f->addFnAttr(llvm::Attribute::ReadOnly);
+}
+
+// Sections the linker groups apart from the rest of the text, as with gcc, for
+// the function and every function generated from its body; llvm has no
+// attribute for hot functions
+static void setTextSection(FuncDecl* node, llvm::Function* f)
+{
+    if (!llvm::Triple(LLVMString(Target::instance()->triple())).isOSBinFormatELF())
+        return;
+
+    if (node->hasAttribute("hot"))
+        f->setSection(".text.hot." + f->getName().str());
+    else if (node->hasAttribute("cold"))
+        f->setSection(".text.unlikely." + f->getName().str());
+}
+
+typedef QHash<llvm::GlobalValue*, int> PartitionMap;
+
+static void promoteSharedLocals(llvm::Module* module)
+{
+    // Internal values used by more than one function are promoted so references
+    // across partitions still resolve. They are hidden and made local again once
+    // the partitions are linked into one object. Unnamed values are named after
+    // the function that owns them so the name does not depend upon the rest of
+    // the module.
+    QList<llvm::GlobalValue*> locals;
+    for (llvm::Module::iterator it = module->begin(); it != module->end(); ++it)
+        locals.append(it);
+    for (llvm::Module::global_iterator it = module->global_begin(); it != module->global_end(); ++it)
+        locals.append(it);
+    foreach (llvm::GlobalValue* value, locals) {
+        if (!value->hasLocalLinkage())
+            continue;
+
+        llvm::Function* owner = llvm::dyn_cast<llvm::Function>(value);
+        if (!owner)
+            owner = firstUserFunction(value);
+        if (!isUsedOutside(value, owner))
+            continue;
+
+        if (!value->hasName())
+            value->setName(owner ? owner->getName() + ".promoted" : "unv.promoted");
+        value->setLinkage(llvm::GlobalValue::ExternalLinkage);
+        value->setVisibility(llvm::GlobalValue::HiddenVisibility);
+    }
+}
+
+static void assignGlobals(llvm::Module* module, PartitionMap& partitionForValue, int unowned)
+{
+    // Global variables follow the first function that uses them
+    for (llvm::Module::global_iterator it = module->global_begin(); it != module->global_end(); ++it) {
+        llvm::Function* user = firstUserFunction(it);
+        partitionForValue.insert(it, user ? partitionForValue.value(user) : unowned);
+    }
+}
+
+static llvm::Module* clonePartition(llvm::Module* module, const PartitionMap& partitionForValue, int partition)
+{
+    llvm::ValueToValueMapTy map;
+    llvm::Module* clone = llvm::CloneModule(module, map);
+
+    for (llvm::Module::iterator it = module->begin(); it != module->end(); ++it) {
+        if (it->isDeclaration() || partitionForValue.value(it) == partition)
+            continue;
+
+        llvm::Value* f = map[it];
+        llvm::cast<llvm::Function>(f)->deleteBody();
+    }
+
+    // Global variables of other partitions are declared if used and dropped otherwise
+    for (llvm::Module::global_iterator it = module->global_begin(); it != module->global_end(); ++it) {
+        if (it->isDeclaration() || partitionForValue.value(it) == partition)
+            continue;
+
+        llvm::Value* clone = map[it];
+        llvm::GlobalVariable* global = llvm::cast<llvm::GlobalVariable>(clone);
+        global->removeDeadConstantUsers();
+        if (global->use_empty()) {
+            global->eraseFromParent();
+            continue;
+        }
+
+        global->setInitializer(0);
+        global->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    }
+
+    return clone;
+}
+
+void CodeGen::generate()
+{
+    walk();
+
+    for (llvm::Module::iterator it = m_module->begin(); it != m_module->end(); ++it) {
+        if (!it->isDeclaration())
+            Target::instance()->configure(it);
+    }
+
+    // Cached functions are optimized one fragment at a time so that their object
+    // code never depends upon the bodies of other functions
+    int level = Options::instance()->optimizationLevel();
+    if (level > 0 && Options::instance()->cacheDir().isEmpty())
+        optimize(m_module.data(), level);
+}
+
+bool CodeGen::writeLLVMIR(const QString& file) const
+{
+    return printModule(m_module.data(), file);
+}
+
+QStringList CodeGen::writePartitionedLLVMIR(int n, const QString& directory)
+{
+    QList<llvm::Function*> definitions;
+    for (llvm::Module::iterator it = m_module->begin(); it != m_module->end(); ++it) {
+        if (!it->isDeclaration())
+            definitions.append(it);
+    }
+
+    n = qMin(n, definitions.count());
+    if (n <= 1) {
+        QString file = directory + QDir::separator() + "partition0.ll";
+        return printModule(m_module.data(), file) ? QStringList() << file : QStringList();
+    }
+
+    // Assign each function to the least loaded partition in module order so the
+    // result only depends upon the module and never upon thread scheduling
+    PartitionMap partitionForValue;
+    QVector<unsigned> load(n, 0);
+    foreach (llvm::Function* f, definitions) {
+        int partition = std::min_element(load.begin(), load.end()) - load.begin();
+        partitionForValue.insert(f, partition);
+        load[partition] += instructionCount(f);
+    }
+
+    assignGlobals(m_module.data(), partitionForValue, 0);
+    promoteSharedLocals(m_module.data());
+
+    // Each partition is printed as soon as it is cloned so only one copy of
+    // the module is alive at a time
+    QStringList partitions;
+    for (int i = 0; i < n; ++i) {
+        QScopedPointer<llvm::Module> partition(clonePartition(m_module.data(), partitionForValue, i));
+        QString file = directory + QDir::separator() + QString("partition%1.ll").arg(i);
+        if (!printModule(partition.data(), file))
+            return QStringList();
+        partitions.append(file);
+    }
+    return partitions;
+}
+
+FunctionKeys CodeGen::functionKeys() const
+{
+    FunctionKeys keys;
+    for (llvm::Module::iterator it = m_module->begin(); it != m_module->end(); ++it) {
+        QString name = toQString(it->getName());
+        if (!it->isDeclaration() && m_functionKeys.contains(name))
+            keys.append(qMakePair(name, m_functionKeys.value(name)));
+    }
+    return keys;
+}
+
+bool CodeGen::hasUnownedGlobals() const
+{
+    for (llvm::Module::global_iterator it = m_module->global_begin(); it != m_module->global_end(); ++it) {
+        if (!it->isDeclaration() && !firstUserFunction(it))
+            return true;
+    }
+    return false;
+}
+
+bool CodeGen::writePartitionLLVMIR(const QStringList& functions, const QString& file)
+{
+    PartitionMap partitionForValue;
+    for (llvm::Module::iterator it = m_module->begin(); it != m_module->end(); ++it) {
+        if (!it->isDeclaration())
+            partitionForValue.insert(it, functions.contains(toQString(it->getName())) ? 1 : 0);
+    }
+
+    assignGlobals(m_module.data(), partitionForValue, functions.isEmpty() ? 1 : 0);
+    promoteSharedLocals(m_module.data());
+
+    QScopedPointer<llvm::Module> partition(clonePartition(m_module.data(), partitionForValue, 1));
+    int level = Options::instance()->optimizationLevel();
+    if (level > 0)
+        optimize(partition.data(), level);
+    return printModule(partition.data(), file);
+}
+
+void CodeGen::walk()
 {
     // Walk the tree for the first pass to register all declarations
     Visitor::walk(m_source->translationUnit());
     m_declPass = false;
     // Walk the tree for the second pass to generate the rest of the code
     Visitor::walk(m_source->translationUnit());
+}
 
-    std::string str;
-    llvm::raw_string_ostream stream(str);
-    m_module->print(stream, 0);
-    stream.flush();
-    return QString::fromStdString(str);
+void CodeGen::optimize(llvm::Module* module, int level)
+{
+    llvm::PassManagerBuilder builder;
+    builder.OptLevel = level;
+    builder.Inliner = level > 1 ? llvm::createFunctionInliningPass(level, 0) : llvm::createAlwaysInlinerPass();
+
+    llvm::FunctionPassManager functionPasses(module);
+    Target::instance()->addAnalysisPasses(functionPasses);
+    builder.populateFunctionPassManager(functionPasses);
+    functionPasses.doInitialization();
+    for (llvm::Module::iterator it = module->begin(); it != module->end(); ++it)
+        functionPasses.run(*it);
+    functionPasses.doFinalization();
+
+    llvm::PassManager modulePasses;
+    Target::instance()->addAnalysisPasses(modulePasses);
+    builder.populateModulePassManager(modulePasses);
+    modulePasses.run(*module);
 }
 
 void CodeGen::visit(IncludeDecl& node)
@@ -106,15 +394,10 @@ void CodeGen::visit(IncludeDecl& node)
     if (!buffer->isCompiled()) {
         buffer->setCompiled(true);
 
-        Lexer lexer;
-        lexer.lex(buffer);
-
-        Parser parser;
-        parser.parse(buffer);
-
         CodeGen codegen(buffer, m_context, m_module);
-        codegen.generateLLVMIR();
+        codegen.walk();
         m_source->addErrors(buffer->numberOfErrors());
+        m_functionKeys.unite(codegen.m_functionKeys);
     }
 
     m_source->typeSystem().importTypes(buffer->typeSystem());
@@ -149,9 +432,13 @@ void CodeGen::visit(FuncDecl& node)
 
     LLVMString name(node.name.toStringRef());
     llvm::Function *f = m_module->getFunction(name);
+    if (node.hasAttribute("memoize") && node.funcDef)
+        f = memoize(&node, f);
+    m_function = &node;
 
     int i = 0;
     m_namedValues.clear();
+    m_variables.clear();
     m_source->typeSystem().clearNamedTypes();
     for (llvm::Function::arg_iterator it = f->arg_begin(); it != f->arg_end(); ++it, ++i) {
         QSharedPointer<TypeObject> object = node.objects.at(i);
@@ -165,10 +452,50 @@ void CodeGen::visit(FuncDecl& node)
         llvm::BasicBlock *block = llvm::BasicBlock::Create(*m_context, "entry", f);
         m_builder->SetInsertPoint(block);
 
+        // The flags let the optimizer transform the arithmetic while the function
+        // attributes let the backend select instructions that assume the same
+        llvm::FastMathFlags flags;
+        if (Options::instance()->fastMath() || node.hasAttribute("fastmath")) {
+            flags.setUnsafeAlgebra();
+            f->addFnAttr("unsafe-fp-math", "true");
+            f->addFnAttr("no-infs-fp-math", "true");
+            f->addFnAttr("no-nans-fp-math", "true");
+        }
+        m_builder->SetFastMathFlags(flags);
+
+        // Recursive tail calls branch back to the top with the arguments of the
+        // call so the function runs in constant stack space
+        m_tailCallArgs.clear();
+        if (node.hasAttribute("tailcall")) {
+            m_tailCallHeader = llvm::BasicBlock::Create(*m_context, "tailrecurse", f);
+            m_builder->CreateBr(m_tailCallHeader);
+            m_builder->SetInsertPoint(m_tailCallHeader);
+            for (llvm::Function::arg_iterator it = f->arg_begin(); it != f->arg_end(); ++it) {
+                llvm::PHINode* phi = m_builder->CreatePHI(it->getType(), 2, it->getName());
+                phi->addIncoming(it, block);
+                m_tailCallArgs.append(phi);
+                m_namedValues.insert(toQString(it->getName()), phi);
+            }
+        }
+
         codegen(funcDef);
 
-        if (funcDef->stmts.last()->kind != Node::_ReturnStmt)
+        if (funcDef->stmts.isEmpty() || funcDef->stmts.last()->kind != Node::_ReturnStmt)
             m_source->error(node.name, "function must end with return statement", SourceBuffer::Fatal);
+
+        QList<llvm::Function*> functions;
+        functions.append(f);
+        if (node.hasAttribute("target_clones"))
+            functions.append(multiversion(&node, f));
+
+        // The body of a memoized function and the clones of a function change
+        // along with the function
+        if (!Options::instance()->cacheDir().isEmpty()) {
+            QByteArray key = ObjectCache::functionKey(&node, m_source->typeSystem());
+            m_functionKeys.insert(node.name.toString(), key);
+            foreach (llvm::Function* function, functions)
+                m_functionKeys.insert(toQString(function->getName()), key);
+        }
     }
 
     llvm::verifyFunction(*f);
@@ -233,6 +560,9 @@ void CodeGen::registerBuiltins()
     info->handle = llvm::Type::getDoubleTy(*m_context);
     info = m_source->typeSystem().toType("_builtin_pointer_double_");
     info->handle = llvm::Type::getDoublePtrTy(*m_context);
+
+    foreach (TypeInfo* vector, m_source->typeSystem().vectorTypes())
+        vector->handle = llvm::VectorType::get(vector->elementType()->handle, vector->lanes());
 }
 
 void CodeGen::registerTypeDecl(TypeDecl* node)
@@ -272,6 +602,262 @@ void CodeGen::registerFuncDecl(FuncDecl* node)
         LLVMString name(object->name.toStringRef());
         it->setName(name);
     }
+
+    if (node->hasAttribute("inline"))
+        f->addFnAttr(llvm::Attribute::AlwaysInline);
+    if (node->hasAttribute("noinline"))
+        f->addFnAttr(llvm::Attribute::NoInline);
+    if (node->hasAttribute("nounwind"))
+        f->addFnAttr(llvm::Attribute::NoUnwind);
+    if (node->hasAttribute("cold"))
+        f->addFnAttr(llvm::Attribute::Cold);
+
+    if (node->funcDef)
+        setTextSection(node, f);
+
+    // A memoized function writes its table, as does its body by calling it
+    if (!node->hasAttribute("memoize"))
+        addMemoryAttributes(node, f);
+}
+
+llvm::Function* CodeGen::memoize(FuncDecl* node, llvm::Function* f)
+{
+    foreach (QSharedPointer<TypeObject> object, node->objects) {
+        TypeInfo* info = m_source->typeSystem().toTypeAndCheck(object->type);
+        if (!info->isBuiltin() || !info->bitWidth() || info->lanes())
+            m_source->error(object->type, "memoized function parameters must be of builtin numeric type",
+                            SourceBuffer::Fatal);
+    }
+
+    // The body moves to an internal function the memoized function only calls when
+    // the result is not in the table yet, so recursive calls go through the table
+    llvm::Function* body = llvm::Function::Create(f->getFunctionType(), llvm::Function::InternalLinkage,
+                                                  f->getName() + ".memoized", m_module.data());
+    setTextSection(node, body);
+    if (node->hasAttribute("nounwind"))
+        body->addFnAttr(llvm::Attribute::NoUnwind);
+
+    // Arguments are keyed by their bits. Integer arguments of few enough bits in
+    // total index a dense table while others are hashed into a table of the size
+    // in Options, probing a few slots before evicting the result in the first.
+    int keyBits = 0;
+    bool dense = true;
+    QList<llvm::Value*> args;
+    QList<llvm::Value*> keys;
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(*m_context, "entry", f);
+    m_builder->SetInsertPoint(entry);
+    for (llvm::Function::arg_iterator it = f->arg_begin(); it != f->arg_end(); ++it) {
+        llvm::Type* type = it->getType();
+        int bits = type->getPrimitiveSizeInBits();
+        dense = dense && type->isIntegerTy();
+        keyBits += bits;
+        args.append(it);
+        keys.append(type->isIntegerTy() ? static_cast<llvm::Value*>(it)
+                    : m_builder->CreateBitCast(it, llvm::Type::getIntNTy(*m_context, bits), "key"));
+    }
+
+    int size = Options::instance()->memoizeSize();
+    dense = dense && keyBits <= 30 && (1 << keyBits) <= size;
+    int entries = dense ? 1 << keyBits : size;
+
+    QString prefix = toQString(f->getName()) + ".memo.";
+    llvm::ArrayType* valuesType = llvm::ArrayType::get(f->getReturnType(), entries);
+    llvm::GlobalVariable* values = new llvm::GlobalVariable(*m_module, valuesType, false /*isConstant*/,
+        llvm::GlobalValue::InternalLinkage, llvm::Constant::getNullValue(valuesType), LLVMString(prefix + "values"));
+    llvm::ArrayType* occupiedType = llvm::ArrayType::get(m_builder->getInt1Ty(), entries);
+    llvm::GlobalVariable* occupied = new llvm::GlobalVariable(*m_module, occupiedType, false /*isConstant*/,
+        llvm::GlobalValue::InternalLinkage, llvm::Constant::getNullValue(occupiedType), LLVMString(prefix + "occupied"));
+
+    QList<llvm::GlobalVariable*> keyTables;
+    if (!dense) {
+        for (int i = 0; i < keys.count(); ++i) {
+            llvm::ArrayType* keysType = llvm::ArrayType::get(keys.at(i)->getType(), entries);
+            keyTables.append(new llvm::GlobalVariable(*m_module, keysType, false /*isConstant*/,
+                llvm::GlobalValue::InternalLinkage, llvm::Constant::getNullValue(keysType),
+                LLVMString(prefix + "keys" + QString::number(i))));
+        }
+    }
+
+    llvm::Value* zero = m_builder->getInt64(0);
+    llvm::Value* index = zero;
+    llvm::Value* hash = zero;
+    int shift = 0;
+    foreach (llvm::Value* key, keys) {
+        llvm::Value* bits = m_builder->CreateZExtOrBitCast(key, m_builder->getInt64Ty());
+        if (dense) {
+            index = m_builder->CreateOr(index, m_builder->CreateShl(bits, shift), "index");
+            shift += key->getType()->getPrimitiveSizeInBits();
+        } else {
+            hash = m_builder->CreateMul(m_builder->CreateXor(hash, bits), m_builder->getInt64(0x9e3779b97f4a7c15ULL), "hash");
+        }
+    }
+
+    llvm::BasicBlock* hit = llvm::BasicBlock::Create(*m_context, "hit", f);
+    llvm::BasicBlock* miss = llvm::BasicBlock::Create(*m_context, "miss", f);
+    llvm::Value* slot = index;
+    llvm::Value* target = index;
+
+    if (dense) {
+        llvm::Value* occupiedIndices[] = { zero, index };
+        m_builder->CreateCondBr(m_builder->CreateLoad(m_builder->CreateInBoundsGEP(occupied, occupiedIndices)), hit, miss);
+    } else {
+        int sizeBits = 0;
+        while ((1 << sizeBits) < size)
+            ++sizeBits;
+        llvm::Value* home = m_builder->CreateLShr(hash, 64 - sizeBits, "home");
+
+        llvm::BasicBlock* probe = llvm::BasicBlock::Create(*m_context, "probe", f);
+        llvm::BasicBlock* compare = llvm::BasicBlock::Create(*m_context, "compare", f);
+        llvm::BasicBlock* next = llvm::BasicBlock::Create(*m_context, "next", f);
+        m_builder->CreateBr(probe);
+
+        m_builder->SetInsertPoint(probe);
+        llvm::PHINode* probes = m_builder->CreatePHI(m_builder->getInt64Ty(), 2, "probes");
+        probes->addIncoming(zero, entry);
+        slot = m_builder->CreateAnd(m_builder->CreateAdd(home, probes), m_builder->getInt64(size - 1), "slot");
+        llvm::Value* occupiedIndices[] = { zero, slot };
+        m_builder->CreateCondBr(m_builder->CreateLoad(m_builder->CreateInBoundsGEP(occupied, occupiedIndices)), compare, miss);
+
+        m_builder->SetInsertPoint(compare);
+        llvm::Value* equal = m_builder->getTrue();
+        for (int i = 0; i < keys.count(); ++i) {
+            llvm::Value* keyIndices[] = { zero, slot };
+            llvm::Value* key = m_builder->CreateLoad(m_builder->CreateInBoundsGEP(keyTables.at(i), keyIndices));
+            equal = m_builder->CreateAnd(equal, m_builder->CreateICmpEQ(key, keys.at(i)), "equal");
+        }
+        m_builder->CreateCondBr(equal, hit, next);
+
+        static const int s_probes = 4;
+        m_builder->SetInsertPoint(next);
+        llvm::Value* nextProbes = m_builder->CreateAdd(probes, m_builder->getInt64(1));
+        probes->addIncoming(nextProbes, next);
+        m_builder->CreateCondBr(m_builder->CreateICmpULT(nextProbes, m_builder->getInt64(s_probes)), probe, miss);
+
+        // A free slot is taken and otherwise the first slot probed is evicted
+        m_builder->SetInsertPoint(miss);
+        llvm::PHINode* taken = m_builder->CreatePHI(m_builder->getInt64Ty(), 2, "target");
+        taken->addIncoming(slot, probe);
+        taken->addIncoming(home, next);
+        target = taken;
+    }
+
+    m_builder->SetInsertPoint(hit);
+    llvm::Value* hitIndices[] = { zero, slot };
+    m_builder->CreateRet(m_builder->CreateLoad(m_builder->CreateInBoundsGEP(values, hitIndices)));
+
+    m_builder->SetInsertPoint(miss);
+    llvm::Value* result = m_builder->CreateCall(body, args.toVector().toStdVector(), "result");
+    llvm::Value* targetIndices[] = { zero, target };
+    m_builder->CreateStore(result, m_builder->CreateInBoundsGEP(values, targetIndices));
+    m_builder->CreateStore(m_builder->getTrue(), m_builder->CreateInBoundsGEP(occupied, targetIndices));
+    for (int i = 0; i < keyTables.count(); ++i)
+        m_builder->CreateStore(keys.at(i), m_builder->CreateInBoundsGEP(keyTables.at(i), targetIndices));
+    m_builder->CreateRet(result);
+
+    llvm::verifyFunction(*f);
+
+    for (llvm::Function::arg_iterator it = f->arg_begin(), to = body->arg_begin(); it != f->arg_end(); ++it, ++to)
+        to->setName(it->getName());
+    return body;
+}
+
+// The bits of the features in __cpu_model of libgcc and compiler-rt, in order
+static int cpuFeatureBit(const QString& feature)
+{
+    static const QStringList features = QStringList() << "cmov" << "mmx" << "popcnt" << "sse" << "sse2" << "sse3"
+                                                      << "ssse3" << "sse4.1" << "sse4.2" << "avx" << "avx2"
+                                                      << "sse4a" << "fma4" << "xop" << "fma" << "avx512f";
+    return features.indexOf(feature);
+}
+
+static llvm::Value* createMustTailCall(llvm::Builder* builder, llvm::Value* callee, llvm::Function* caller)
+{
+    std::vector<llvm::Value*> args;
+    for (llvm::Function::arg_iterator it = caller->arg_begin(); it != caller->arg_end(); ++it)
+        args.push_back(it);
+
+    llvm::CallInst* call = builder->CreateCall(callee, args);
+    call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+    if (caller->getReturnType()->isVoidTy())
+        return builder->CreateRetVoid();
+    return builder->CreateRet(call);
+}
+
+QList<llvm::Function*> CodeGen::multiversion(FuncDecl* node, llvm::Function* f)
+{
+    llvm::Triple triple(LLVMString(Target::instance()->triple()));
+    if (triple.getArch() != llvm::Triple::x86 && triple.getArch() != llvm::Triple::x86_64)
+        m_source->error(node->name, "function clones are only supported on x86 targets", SourceBuffer::Fatal);
+
+    // Each target gets a copy of the body compiled with its features on top of
+    // those of the whole module
+    QList<llvm::Function*> functions;
+    QHash<QString, llvm::Function*> clones;
+    foreach (QString target, node->attributeArgs("target_clones")) {
+        llvm::ValueToValueMapTy map;
+        llvm::Function* clone = llvm::CloneFunction(f, map, false /*ModuleLevelChanges*/);
+        clone->setName(f->getName() + "." + LLVMString(target));
+        clone->setLinkage(llvm::GlobalValue::InternalLinkage);
+        setTextSection(node, clone);
+        if (target != "default") {
+            QString features = Target::instance()->features();
+            clone->addFnAttr("target-features", LLVMString((features.isEmpty() ? "" : features + ",") + "+" + target));
+        }
+        m_module->getFunctionList().push_back(clone);
+        clones.insert(target, clone);
+        functions.append(clone);
+    }
+
+    // The function itself becomes a stub calling through a pointer that starts out
+    // at a resolver, which replaces it with the best clone on the first call the
+    // way the dynamic linker binds an IFUNC
+    llvm::GlobalValue::LinkageTypes linkage = f->getLinkage();
+    f->deleteBody();
+    f->setLinkage(linkage);
+    f->removeFnAttr(llvm::Attribute::ReadNone);
+    f->removeFnAttr(llvm::Attribute::ReadOnly);
+
+    llvm::Function* resolver = llvm::Function::Create(f->getFunctionType(), llvm::Function::InternalLinkage,
+                                                      f->getName() + ".resolver", m_module.data());
+    llvm::GlobalVariable* resolved = new llvm::GlobalVariable(*m_module, f->getType(), false /*isConstant*/,
+        llvm::GlobalValue::InternalLinkage, resolver, f->getName() + ".resolved");
+    functions.append(resolver);
+
+    m_builder->SetInsertPoint(llvm::BasicBlock::Create(*m_context, "entry", f));
+    createMustTailCall(m_builder.data(), m_builder->CreateLoad(resolved, "clone"), f);
+
+    // The features are detected by the constructor of the runtime library, which
+    // is called again in case the resolver runs from an earlier constructor
+    llvm::Type* cpuModelType = llvm::StructType::get(m_builder->getInt32Ty(), m_builder->getInt32Ty(),
+                                                     m_builder->getInt32Ty(),
+                                                     llvm::ArrayType::get(m_builder->getInt32Ty(), 1), NULL);
+    llvm::Constant* cpuModel = m_module->getOrInsertGlobal("__cpu_model", cpuModelType);
+    // libgcc and compiler-rt declare it returning an int, which the resolver ignores
+    llvm::Constant* cpuInit = m_module->getOrInsertFunction("__cpu_indicator_init", m_builder->getInt32Ty(), NULL);
+
+    m_builder->SetInsertPoint(llvm::BasicBlock::Create(*m_context, "entry", resolver));
+    m_builder->CreateCall(cpuInit);
+    llvm::Value* indices[] = { m_builder->getInt32(0), m_builder->getInt32(3), m_builder->getInt32(0) };
+    llvm::Value* features = m_builder->CreateLoad(m_builder->CreateInBoundsGEP(cpuModel, indices), "features");
+
+    // The first target in the attribute that the processor supports wins
+    llvm::Value* clone = clones.value("default");
+    QStringList targets = node->attributeArgs("target_clones");
+    for (int i = targets.count() - 1; i >= 0; --i) {
+        if (targets.at(i) == "default")
+            continue;
+        llvm::Value* mask = m_builder->getInt32(1u << cpuFeatureBit(targets.at(i)));
+        llvm::Value* supported = m_builder->CreateICmpEQ(m_builder->CreateAnd(features, mask), mask);
+        clone = m_builder->CreateSelect(supported, clones.value(targets.at(i)), clone);
+    }
+    m_builder->CreateStore(clone, resolved);
+    createMustTailCall(m_builder.data(), clone, resolver);
+
+    for (llvm::Function::arg_iterator it = f->arg_begin(), to = resolver->arg_begin(); it != f->arg_end(); ++it, ++to)
+        to->setName(it->getName());
+
+    llvm::verifyFunction(*resolver);
+    return functions;
 }
 
 void CodeGen::codegen(FuncDef* node)
@@ -282,6 +868,12 @@ void CodeGen::codegen(FuncDef* node)
 
 void CodeGen::codegen(Stmt* node)
 {
+    // Statements after a return are never reached but still need a block
+    if (m_builder->GetInsertBlock()->getTerminator()) {
+        llvm::Function* f = m_builder->GetInsertBlock()->getParent();
+        m_builder->SetInsertPoint(llvm::BasicBlock::Create(*m_context, "unreachable", f));
+    }
+
     switch (node->kind) {
     case Node::_IfStmt:
         codegen(static_cast<IfStmt*>(node));
@@ -292,6 +884,18 @@ void CodeGen::codegen(Stmt* node)
     case Node::_VarDeclStmt:
         codegen(static_cast<VarDeclStmt*>(node));
         break;
+    case Node::_AssignStmt:
+        codegen(static_cast<AssignStmt*>(node));
+        break;
+    case Node::_WhileStmt:
+        codegen(static_cast<WhileStmt*>(node));
+        break;
+    case Node::_ForStmt:
+        codegen(static_cast<ForStmt*>(node));
+        break;
+    case Node::_MatchStmt:
+        codegen(static_cast<MatchStmt*>(node));
+        break;
     default:
         assert(false); // should not be reached
         return;
@@ -308,7 +912,6 @@ void CodeGen::codegen(IfStmt* node)
     }
 
     TypeInfo* info = m_source->typeSystem().typeInfoForExpr(node->expr.data());
-    assert(info);
     llvm::Value *condition = codegen(node->expr.data(), info);
     assert(condition);
 
@@ -322,13 +925,33 @@ void CodeGen::codegen(IfStmt* node)
     assert(f);
 
     llvm::BasicBlock* then = llvm::BasicBlock::Create(*m_context, "then", f);
+    llvm::BasicBlock* otherwise = node->elseStmt ? llvm::BasicBlock::Create(*m_context, "else") : 0;
     llvm::BasicBlock* ifcont = llvm::BasicBlock::Create(*m_context, "ifcont");
 
-    m_builder->CreateCondBr(condition, then, ifcont);
+    // The same weights clang gives __builtin_expect
+    llvm::MDNode* weights = 0;
+    if (node->hint.toString() == "likely")
+        weights = llvm::MDBuilder(*m_context).createBranchWeights(64, 4);
+    else if (node->hint.toString() == "unlikely")
+        weights = llvm::MDBuilder(*m_context).createBranchWeights(4, 64);
+
+    m_builder->CreateCondBr(condition, then, otherwise ? otherwise : ifcont, weights);
 
     m_builder->SetInsertPoint(then);
 
     codegen(node->stmt.data());
+    if (!m_builder->GetInsertBlock()->getTerminator())
+        m_builder->CreateBr(ifcont);
+
+    // Variables assigned on either side are stack slots, which mem2reg merges
+    // with phi nodes in ifcont
+    if (otherwise) {
+        f->getBasicBlockList().push_back(otherwise);
+        m_builder->SetInsertPoint(otherwise);
+        codegen(node->elseStmt.data());
+        if (!m_builder->GetInsertBlock()->getTerminator())
+            m_builder->CreateBr(ifcont);
+    }
 
     f->getBasicBlockList().push_back(ifcont);
     m_builder->SetInsertPoint(ifcont);
@@ -336,19 +959,20 @@ void CodeGen::codegen(IfStmt* node)
 
 void CodeGen::codegen(ReturnStmt* node)
 {
-    llvm::Function* f = m_builder->GetInsertBlock()->getParent();
-    assert(f);
-
-    TypeInfo* funcInfo = m_source->typeSystem().toType(toQString(f->getName()));
-    if (!funcInfo) {
+    // The function is not looked up by the name of the llvm function since the
+    // body of a memoized function is generated into a function of its own
+    if (!m_function) {
         m_source->error(node->keyword, "return statement for function with unknown type", SourceBuffer::Fatal);
         return;
     }
 
-    assert(funcInfo->isNode());
-    FuncDecl* funcDecl = static_cast<FuncDecl*>(funcInfo);
+    TypeInfo* returnInfo = m_source->typeSystem().toTypeAndCheck(m_function->returnType->type);
+    if (m_function->hasAttribute("tailcall") && node->expr->kind == Node::_FuncCallExpr
+        && !TypeSystem::isBuiltinFunction(static_cast<FuncCallExpr*>(node->expr.data())->callee)) {
+        codegenTailCall(static_cast<FuncCallExpr*>(node->expr.data()), returnInfo);
+        return;
+    }
 
-    TypeInfo* returnInfo = m_source->typeSystem().toTypeAndCheck(funcDecl->returnType->type);
     if (llvm::Value* value = codegen(node->expr.data(), returnInfo)) {
         m_builder->CreateRet(value);
         return;
@@ -366,16 +990,328 @@ void CodeGen::codegen(VarDeclStmt* node)
     llvm::Value* value = codegen(node->expr.data(), info);
     assert(value);
 
+    // Every variable lives in a stack slot of the entry block which mem2reg and
+    // SROA turn back into registers, so assignments need no phi nodes here
+    QString name = node->name.toString();
+    llvm::AllocaInst* variable = createVariable(name, value->getType());
+    m_builder->CreateStore(value, variable);
+    m_variables.insert(name, variable);
+    m_source->typeSystem().insertNamedType(name, info);
+}
+
+void CodeGen::codegen(AssignStmt* node)
+{
+    QString name = node->name.toString();
+    llvm::AllocaInst* variable = m_variables.value(name);
+    if (!variable) {
+        if (m_namedValues.contains(name)) {
+            m_source->error(node->name, "can not assign to a parameter or the variable of a for statement",
+                SourceBuffer::Fatal);
+        }
+        m_source->error(node->name, "unknown variable name", SourceBuffer::Fatal);
+        return;
+    }
+
+    TypeInfo* info = m_source->typeSystem().namedTypes().value(name);
+    llvm::Value* value = codegen(node->expr.data(), info);
+    assert(value);
+    m_builder->CreateStore(value, variable);
+}
+
+void CodeGen::codegen(WhileStmt* node)
+{
+    if (node->expr->kind == Node::_LiteralExpr) {
+        m_source->error(node->expr->start,
+            "literal expression can not be used as the only expression of a while statement",
+            SourceBuffer::Fatal);
+        return;
+    }
+
+    llvm::Function* f = m_builder->GetInsertBlock()->getParent();
+    assert(f);
+
+    // The block before the loop is its preheader and the condition is the only
+    // header, with a single latch branching back to it
+    llvm::BasicBlock* header = llvm::BasicBlock::Create(*m_context, "while.cond", f);
+    llvm::BasicBlock* body = llvm::BasicBlock::Create(*m_context, "while.body", f);
+    llvm::BasicBlock* latch = llvm::BasicBlock::Create(*m_context, "while.latch");
+    llvm::BasicBlock* exit = llvm::BasicBlock::Create(*m_context, "while.end");
+    m_builder->CreateBr(header);
+
+    m_builder->SetInsertPoint(header);
+    TypeInfo* info = m_source->typeSystem().typeInfoForExpr(node->expr.data());
+    llvm::Value* condition = codegen(node->expr.data(), info);
+    assert(condition);
+
+    if (condition->getType() != llvm::Type::getInt1Ty(*m_context)) {
+        m_source->error(node->expr->start,
+            "expression in while statement does not evaluate to true or false",
+            SourceBuffer::Fatal);
+    }
+    m_builder->CreateCondBr(condition, body, exit);
+
+    m_builder->SetInsertPoint(body);
+    codegenBlock(node->stmts, latch);
+
+    f->getBasicBlockList().push_back(latch);
+    m_builder->SetInsertPoint(latch);
+    addLoopMetadata(node, m_builder->CreateBr(header));
+
+    f->getBasicBlockList().push_back(exit);
+    m_builder->SetInsertPoint(exit);
+}
+
+void CodeGen::codegen(ForStmt* node)
+{
+    TypeInfo* info = m_source->typeSystem().resolveAlias(m_source->typeSystem().toTypeAndCheck(node->type));
+    if (!info->isInteger()) {
+        m_source->error(node->type, "for statement counts with an integer type", SourceBuffer::Fatal);
+        return;
+    }
+
+    // The end and the step are evaluated once, before the loop
+    llvm::Value* start = codegen(node->start.data(), info);
+    llvm::Value* end = codegen(node->end.data(), info);
+    llvm::Value* step = node->step ? codegen(node->step.data(), info) : llvm::ConstantInt::get(info->handle, 1);
+    assert(start && end && step);
+
+    llvm::ConstantInt* constantStep = llvm::dyn_cast<llvm::ConstantInt>(step);
+    if (constantStep && (constantStep->isZero() || (info->isSignedInt() && constantStep->isNegative()))) {
+        m_source->error(node->step->start, "for statement needs a positive step", SourceBuffer::Fatal);
+        return;
+    }
+
+    llvm::Function* f = m_builder->GetInsertBlock()->getParent();
+    assert(f);
+
+    llvm::BasicBlock* preheader = m_builder->GetInsertBlock();
+    llvm::BasicBlock* header = llvm::BasicBlock::Create(*m_context, "for.cond", f);
+    llvm::BasicBlock* body = llvm::BasicBlock::Create(*m_context, "for.body", f);
+    llvm::BasicBlock* latch = llvm::BasicBlock::Create(*m_context, "for.inc");
+    llvm::BasicBlock* exit = llvm::BasicBlock::Create(*m_context, "for.end");
+
+    // A step that is only known at runtime runs the body no times unless positive
+    if (!constantStep) {
+        llvm::Value* zero = llvm::ConstantInt::get(info->handle, 0);
+        llvm::Value* positive = info->isSignedInt() ? m_builder->CreateICmpSGT(step, zero, "forstep")
+                                                    : m_builder->CreateICmpNE(step, zero, "forstep");
+        m_builder->CreateCondBr(positive, header, exit);
+    } else {
+        m_builder->CreateBr(header);
+    }
+
+    // The body can not assign the variable so it is the induction variable itself
+    // rather than a stack slot
+    m_builder->SetInsertPoint(header);
     QString name = node->name.toString();
-    m_namedValues.insert(name, value);
+    llvm::PHINode* counter = m_builder->CreatePHI(info->handle, 2, LLVMString(name));
+    counter->addIncoming(start, preheader);
+    llvm::Value* condition = info->isSignedInt() ? m_builder->CreateICmpSLT(counter, end, "forcond")
+                                                 : m_builder->CreateICmpULT(counter, end, "forcond");
+    m_builder->CreateCondBr(condition, body, exit);
+
+    m_builder->SetInsertPoint(body);
+    QHash<QString, llvm::Value*> namedValues = m_namedValues;
+    QHash<QString, llvm::AllocaInst*> variables = m_variables;
+    QHash<QString, TypeInfo*> namedTypes = m_source->typeSystem().namedTypes();
+    m_namedValues.insert(name, counter);
+    m_variables.remove(name);
     m_source->typeSystem().insertNamedType(name, info);
+    codegenBlock(node->stmts, latch);
+    m_namedValues = namedValues;
+    m_variables = variables;
+    m_source->typeSystem().setNamedTypes(namedTypes);
+
+    // The counter is below the end when it is incremented, so a step of one never
+    // wraps. A larger step first checks that it stays below the end, which is
+    // the distance to the end being more than the step, so neither does it.
+    f->getBasicBlockList().push_back(latch);
+    m_builder->SetInsertPoint(latch);
+    bool isSigned = info->isSignedInt();
+    llvm::Value* next = m_builder->CreateAdd(counter, step, "next", !isSigned /*HasNUW*/, isSigned /*HasNSW*/);
+    counter->addIncoming(next, latch);
+    if (constantStep && constantStep->isOne()) {
+        addLoopMetadata(node, m_builder->CreateBr(header));
+    } else {
+        llvm::Value* remaining = m_builder->CreateSub(end, counter, "remaining");
+        llvm::Value* more = m_builder->CreateICmpUGT(remaining, step, "formore");
+        addLoopMetadata(node, m_builder->CreateCondBr(more, header, exit));
+    }
+
+    f->getBasicBlockList().push_back(exit);
+    m_builder->SetInsertPoint(exit);
+}
+
+void CodeGen::codegen(MatchStmt* node)
+{
+    if (node->expr->kind == Node::_LiteralExpr) {
+        m_source->error(node->expr->start,
+            "literal expression can not be used as the expression of a match statement",
+            SourceBuffer::Fatal);
+        return;
+    }
+
+    TypeInfo* info = m_source->typeSystem().resolveAlias(m_source->typeSystem().typeInfoForExpr(node->expr.data()));
+    if (!info || !info->isInteger()) {
+        m_source->error(node->expr->start, "match statement needs an expression of integer type", SourceBuffer::Fatal);
+        return;
+    }
+
+    llvm::Value* value = codegen(node->expr.data(), info);
+    assert(value);
+
+    llvm::Function* f = m_builder->GetInsertBlock()->getParent();
+    assert(f);
+
+    llvm::BasicBlock* matchcont = llvm::BasicBlock::Create(*m_context, "matchcont");
+    QList<llvm::BasicBlock*> blocks;
+    llvm::BasicBlock* otherwise = matchcont;
+    foreach (QSharedPointer<MatchCase> matchCase, node->cases) {
+        blocks.append(llvm::BasicBlock::Create(*m_context, matchCase->isDefault() ? "default" : "case", f));
+        if (matchCase->isDefault()) {
+            if (otherwise != matchcont)
+                m_source->error(matchCase->keyword, "match statement has more than one else case", SourceBuffer::Fatal);
+            otherwise = blocks.last();
+        }
+    }
+
+    // A single switch lets the backend pick between a jump table, bit tests and
+    // a tree of compares from the density of the values
+    llvm::SwitchInst* dispatch = m_builder->CreateSwitch(value, otherwise, node->cases.count());
+    QSet<qint64> values;
+    for (int i = 0; i < node->cases.count(); ++i) {
+        foreach (QSharedPointer<LiteralExpr> literal, node->cases.at(i)->values) {
+            ConstantEvaluator::Value constant;
+            m_evaluator.evaluate(literal.data(), info, &constant);
+            if (values.contains(qint64(constant.integer)))
+                m_source->error(literal->literal, "duplicate case value in match statement", SourceBuffer::Fatal);
+            values.insert(qint64(constant.integer));
+
+            llvm::Constant* caseValue = toConstant(constant, info->handle, info->isSignedInt());
+            dispatch->addCase(llvm::cast<llvm::ConstantInt>(caseValue), blocks.at(i));
+        }
+    }
+
+    for (int i = 0; i < node->cases.count(); ++i) {
+        m_builder->SetInsertPoint(blocks.at(i));
+        codegenBlock(node->cases.at(i)->stmts, matchcont);
+    }
+
+    f->getBasicBlockList().push_back(matchcont);
+    m_builder->SetInsertPoint(matchcont);
+}
+
+void CodeGen::codegenBlock(const QList<QSharedPointer<Stmt> >& stmts, llvm::BasicBlock* next)
+{
+    // Variables declared in a block go out of scope with it and control
+    // continues at next unless the block returns
+    QHash<QString, llvm::Value*> namedValues = m_namedValues;
+    QHash<QString, llvm::AllocaInst*> variables = m_variables;
+    QHash<QString, TypeInfo*> namedTypes = m_source->typeSystem().namedTypes();
+    foreach (QSharedPointer<Stmt> stmt, stmts)
+        codegen(stmt.data());
+    m_namedValues = namedValues;
+    m_variables = variables;
+    m_source->typeSystem().setNamedTypes(namedTypes);
+
+    if (!m_builder->GetInsertBlock()->getTerminator())
+        m_builder->CreateBr(next);
+}
+
+static llvm::MDNode* loopHint(llvm::LLVMContext& context, const char* name, llvm::Constant* value)
+{
+    llvm::Metadata* operands[] = { llvm::MDString::get(context, name), llvm::ConstantAsMetadata::get(value) };
+    return llvm::MDNode::get(context, operands);
+}
+
+void CodeGen::addLoopMetadata(LoopStmt* node, llvm::BranchInst* backedge)
+{
+    if (node->attributes.isEmpty())
+        return;
+
+    // The hints the loop vectorizer and unroller read from the backedge, in a node
+    // whose first operand is the node itself so no two loops share it
+    llvm::MDNodeFwdDecl* temporary = llvm::MDNode::getTemporary(*m_context, llvm::None);
+    std::vector<llvm::Metadata*> operands;
+    operands.push_back(temporary);
+
+    if (unsigned width = node->attributeCount("vectorize")) {
+        operands.push_back(loopHint(*m_context, "llvm.loop.vectorize.enable", m_builder->getTrue()));
+        operands.push_back(loopHint(*m_context, "llvm.loop.vectorize.width", m_builder->getInt32(width)));
+    }
+    if (node->hasAttribute("novectorize"))
+        operands.push_back(loopHint(*m_context, "llvm.loop.vectorize.enable", m_builder->getFalse()));
+    if (unsigned count = node->attributeCount("unroll"))
+        operands.push_back(loopHint(*m_context, "llvm.loop.unroll.count", m_builder->getInt32(count)));
+
+    llvm::MDNode* loop = llvm::MDNode::get(*m_context, operands);
+    loop->replaceOperandWith(0, loop);
+    llvm::MDNode::deleteTemporary(temporary);
+    backedge->setMetadata("llvm.loop", loop);
+}
+
+llvm::AllocaInst* CodeGen::createVariable(const QString& name, llvm::Type* type)
+{
+    // Allocas at the top of the entry block are the ones mem2reg promotes
+    llvm::BasicBlock& entry = m_builder->GetInsertBlock()->getParent()->getEntryBlock();
+    llvm::IRBuilder<> builder(&entry, entry.begin());
+    return builder.CreateAlloca(type, 0, LLVMString(name));
+}
+
+// Whether an expression is cheap and can neither trap nor have side effects, so
+// it may be evaluated even where its value is not used
+static bool isSafeToSpeculate(Expr* node)
+{
+    switch (node->kind) {
+    case Node::_LiteralExpr:
+    case Node::_VarExpr:
+        return true;
+    case Node::_TypeCtorExpr: {
+        TypeCtorExpr* ctor = static_cast<TypeCtorExpr*>(node);
+        return ctor->type.type == Undefined && isSafeToSpeculate(ctor->args.first().data());
+    }
+    case Node::_ConditionalExpr: {
+        ConditionalExpr* conditional = static_cast<ConditionalExpr*>(node);
+        return isSafeToSpeculate(conditional->condition.data()) && isSafeToSpeculate(conditional->lhs.data())
+            && isSafeToSpeculate(conditional->rhs.data());
+    }
+    case Node::_UnaryExpr:
+        return isSafeToSpeculate(static_cast<UnaryExpr*>(node)->expr.data());
+    case Node::_BinaryExpr: {
+        BinaryExpr* binary = static_cast<BinaryExpr*>(node);
+        switch (binary->op) {
+        case BinaryExpr::OpDivision:
+        case BinaryExpr::OpRemainder:
+            return false;
+        case BinaryExpr::OpAddition:
+        case BinaryExpr::OpSubtraction:
+        case BinaryExpr::OpMultiplication:
+            if (Options::instance()->overflow() == Options::OverflowTrap)
+                return false;
+            break;
+        default:
+            break;
+        }
+        return isSafeToSpeculate(binary->lhs.data()) && isSafeToSpeculate(binary->rhs.data());
+    }
+    default:
+        return false;
+    }
 }
 
 llvm::Value* CodeGen::codegen(BinaryExpr* node, TypeInfo* info)
 {
+    if (ConstantEvaluator::isLiteral(node))
+        return codegenConstant(node, info);
+
+    if (node->isLogical())
+        return codegenLogical(node);
+
+    // The operands of a comparison are of their own type rather than of the bit
+    // or vector of bits it evaluates to
     llvm::Value* l = 0;
     llvm::Value* r = 0;
-    if (!info)
+    if (!info || node->isComparison())
         info = m_source->typeSystem().typeInfoForExpr(node);
 
     if (node->lhs->kind != Node::_LiteralExpr)
@@ -384,13 +1320,6 @@ llvm::Value* CodeGen::codegen(BinaryExpr* node, TypeInfo* info)
     if (node->rhs->kind != Node::_LiteralExpr)
         r = codegen(node->rhs.data(), info);
 
-    if (!l && !r) {
-        m_source->error(static_cast<LiteralExpr*>(node->lhs.data())->literal,
-            "we do not support binary expressions involving two literals",
-            SourceBuffer::Fatal);
-        return 0;
-    }
-
     if (!l)
         l = codegen(node->lhs.data(), info);
 
@@ -408,10 +1337,11 @@ llvm::Value* CodeGen::codegen(BinaryExpr* node, TypeInfo* info)
     assert(infoForExpressions);
     assert(infoForExpressions->handle);
 
-    bool isInteger = infoForExpressions->handle->isIntegerTy();
+    // Vectors are operated on lane by lane with the instructions of their elements
+    bool isInteger = infoForExpressions->handle->isIntOrIntVectorTy();
     bool isSignedInteger = infoForExpressions->isSignedInt();
-    bool isFloat = infoForExpressions->handle->isFloatTy();
-    bool isDouble = infoForExpressions->handle->isDoubleTy();
+    bool isFloat = infoForExpressions->handle->getScalarType()->isFloatTy();
+    bool isDouble = infoForExpressions->handle->getScalarType()->isDoubleTy();
 
     // FIXME: Still need to take ordered vs unordered comparisons into
     // account for floating point types
@@ -459,15 +1389,196 @@ llvm::Value* CodeGen::codegen(BinaryExpr* node, TypeInfo* info)
         } else if (isFloat || isDouble)
             return m_builder->CreateFCmpOGT(l, r, "ogttmp");
     case BinaryExpr::OpAddition:
-        return m_builder->CreateAdd(l, r, "addtmp");
+        if (isInteger)
+            return codegenArithmetic(node, l, r, isSignedInteger);
+        return m_builder->CreateFAdd(l, r, "faddtmp");
     case BinaryExpr::OpSubtraction:
-        return m_builder->CreateSub(l, r, "subtmp");
+        if (isInteger)
+            return codegenArithmetic(node, l, r, isSignedInteger);
+        return m_builder->CreateFSub(l, r, "fsubtmp");
     case BinaryExpr::OpMultiplication:
-        return m_builder->CreateMul(l, r, "multmp");
+        if (isInteger)
+            return codegenArithmetic(node, l, r, isSignedInteger);
+        return m_builder->CreateFMul(l, r, "fmultmp");
     case BinaryExpr::OpDivision:
+        if (isInteger) {
+            codegenCheckDivisor(l, r, isSignedInteger);
+            return isSignedInteger ? m_builder->CreateSDiv(l, r, "sdivtmp") : m_builder->CreateUDiv(l, r, "udivtmp");
+        }
+        return m_builder->CreateFDiv(l, r, "fdivtmp");
+    case BinaryExpr::OpRemainder:
+        if (isInteger) {
+            codegenCheckDivisor(l, r, isSignedInteger);
+            return isSignedInteger ? m_builder->CreateSRem(l, r, "sremtmp") : m_builder->CreateURem(l, r, "uremtmp");
+        }
+        return m_builder->CreateFRem(l, r, "fremtmp");
+    case BinaryExpr::OpLogicalAnd:
+    case BinaryExpr::OpLogicalOr:
+        break;
+    case BinaryExpr::OpBitwiseAnd:
+        return m_builder->CreateAnd(l, r, "andtmp");
+    case BinaryExpr::OpBitwiseOr:
+        return m_builder->CreateOr(l, r, "ortmp");
+    case BinaryExpr::OpBitwiseXor:
+        return m_builder->CreateXor(l, r, "xortmp");
+    case BinaryExpr::OpShiftLeft:
+    case BinaryExpr::OpShiftRight:
+        return codegenShift(node, l, r, isSignedInteger);
+    }
+
+    assert(false); // should not be reached
+    return 0;
+}
+
+llvm::Value* CodeGen::codegenLogical(BinaryExpr* node)
+{
+    bool isAnd = node->op == BinaryExpr::OpLogicalAnd;
+    llvm::Value* l = codegenCondition(node->lhs.data());
+
+    // A right operand that is cheap and can not trap or have side effects is
+    // evaluated either way and combined without a branch
+    if (isSafeToSpeculate(node->rhs.data())) {
+        llvm::Value* r = codegenCondition(node->rhs.data());
+        return isAnd ? m_builder->CreateAnd(l, r, "landtmp") : m_builder->CreateOr(l, r, "lortmp");
+    }
+
+    llvm::Function* f = m_builder->GetInsertBlock()->getParent();
+    assert(f);
+
+    llvm::BasicBlock* lhsBlock = m_builder->GetInsertBlock();
+    llvm::BasicBlock* rhs = llvm::BasicBlock::Create(*m_context, isAnd ? "land.rhs" : "lor.rhs", f);
+    llvm::BasicBlock* end = llvm::BasicBlock::Create(*m_context, isAnd ? "land.end" : "lor.end");
+    if (isAnd)
+        m_builder->CreateCondBr(l, rhs, end);
+    else
+        m_builder->CreateCondBr(l, end, rhs);
+
+    m_builder->SetInsertPoint(rhs);
+    llvm::Value* r = codegenCondition(node->rhs.data());
+    llvm::BasicBlock* rhsBlock = m_builder->GetInsertBlock();
+    m_builder->CreateBr(end);
+
+    f->getBasicBlockList().push_back(end);
+    m_builder->SetInsertPoint(end);
+    llvm::PHINode* phi = m_builder->CreatePHI(m_builder->getInt1Ty(), 2, isAnd ? "landtmp" : "lortmp");
+    phi->addIncoming(isAnd ? m_builder->getFalse() : m_builder->getTrue(), lhsBlock);
+    phi->addIncoming(r, rhsBlock);
+    return phi;
+}
+
+llvm::Value* CodeGen::codegenCondition(Expr* node)
+{
+    if (!m_source->typeSystem().isLogicalOperand(node)) {
+        m_source->error(node->start, "operand of logical operator does not evaluate to true or false",
+                        SourceBuffer::Fatal);
+        return 0;
+    }
+
+    // Comparisons are generated in the type of their operands and the literals
+    // true and false in no type at all
+    TypeInfo* info = m_source->typeSystem().typeInfoForExpr(node);
+    llvm::Value* condition = codegen(node, info ? info : m_source->typeSystem().bitType());
+    assert(condition && condition->getType() == m_builder->getInt1Ty());
+    return condition;
+}
+
+llvm::Value* CodeGen::codegenArithmetic(BinaryExpr* node, llvm::Value* l, llvm::Value* r, bool isSigned)
+{
+    // Vector arithmetic is not checked since the backend can not lower the
+    // overflow intrinsics on vectors
+    Options::Overflow overflow = Options::instance()->overflow();
+    if (overflow == Options::OverflowTrap && !l->getType()->isVectorTy())
+        return codegenCheckedArithmetic(node, l, r, isSigned);
+
+    // Unsigned types are modular so only signed arithmetic may assume it does not wrap
+    bool hasNSW = isSigned && overflow == Options::OverflowUndefined;
+    switch (node->op) {
+    case BinaryExpr::OpAddition:
+        return m_builder->CreateAdd(l, r, "addtmp", false /*HasNUW*/, hasNSW);
+    case BinaryExpr::OpSubtraction:
+        return m_builder->CreateSub(l, r, "subtmp", false /*HasNUW*/, hasNSW);
+    case BinaryExpr::OpMultiplication:
+        return m_builder->CreateMul(l, r, "multmp", false /*HasNUW*/, hasNSW);
+    default:
+        assert(false); // should not be reached
+        return 0;
+    }
+}
+
+llvm::Value* CodeGen::codegenShift(BinaryExpr* node, llvm::Value* l, llvm::Value* r, bool isSigned)
+{
+    // The amount is taken modulo the width of the type instead of giving an
+    // undefined value
+    llvm::Type* type = l->getType();
+    unsigned bits = type->getScalarSizeInBits();
+    if (bits > 1) {
+        llvm::Constant* mask = llvm::ConstantInt::get(type->getScalarType(), bits - 1);
+        if (type->isVectorTy())
+            mask = llvm::ConstantVector::getSplat(type->getVectorNumElements(), mask);
+        r = m_builder->CreateAnd(r, mask, "shiftamount");
+    } else {
+        r = llvm::Constant::getNullValue(type);
+    }
+
+    if (node->op == BinaryExpr::OpShiftLeft)
+        return m_builder->CreateShl(l, r, "shltmp");
+    return isSigned ? m_builder->CreateAShr(l, r, "ashrtmp") : m_builder->CreateLShr(l, r, "lshrtmp");
+}
+
+llvm::Value* CodeGen::codegenCheckedArithmetic(BinaryExpr* node, llvm::Value* l, llvm::Value* r, bool isSigned)
+{
+    llvm::Intrinsic::ID id;
+    switch (node->op) {
+    case BinaryExpr::OpAddition:
+        id = isSigned ? llvm::Intrinsic::sadd_with_overflow : llvm::Intrinsic::uadd_with_overflow;
+        break;
+    case BinaryExpr::OpSubtraction:
+        id = isSigned ? llvm::Intrinsic::ssub_with_overflow : llvm::Intrinsic::usub_with_overflow;
+        break;
+    case BinaryExpr::OpMultiplication:
+        id = isSigned ? llvm::Intrinsic::smul_with_overflow : llvm::Intrinsic::umul_with_overflow;
+        break;
+    default:
         assert(false); // should not be reached
         return 0;
     }
+
+    llvm::Type* type = l->getType();
+    llvm::Function* intrinsic = llvm::Intrinsic::getDeclaration(m_module.data(), id, type);
+    llvm::Value* result = m_builder->CreateCall2(intrinsic, l, r, "checked");
+    codegenTrap(m_builder->CreateExtractValue(result, 1, "overflowed"));
+    return m_builder->CreateExtractValue(result, 0);
+}
+
+void CodeGen::codegenCheckDivisor(llvm::Value* l, llvm::Value* r, bool isSigned)
+{
+    // Division by zero and the one signed division whose result is out of range
+    // trap along with the arithmetic that overflows
+    if (Options::instance()->overflow() != Options::OverflowTrap || l->getType()->isVectorTy())
+        return;
+
+    llvm::IntegerType* type = llvm::cast<llvm::IntegerType>(l->getType());
+    llvm::Value* invalid = m_builder->CreateICmpEQ(r, llvm::ConstantInt::get(type, 0), "divzero");
+    if (isSigned) {
+        llvm::Value* minimum = m_builder->CreateICmpEQ(l, llvm::ConstantInt::get(*m_context, llvm::APInt::getSignedMinValue(type->getBitWidth())), "divmin");
+        llvm::Value* minusOne = m_builder->CreateICmpEQ(r, llvm::ConstantInt::getSigned(type, -1), "divminusone");
+        invalid = m_builder->CreateOr(invalid, m_builder->CreateAnd(minimum, minusOne), "divoverflow");
+    }
+    codegenTrap(invalid);
+}
+
+void CodeGen::codegenTrap(llvm::Value* condition)
+{
+    llvm::Function* f = m_builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* trap = llvm::BasicBlock::Create(*m_context, "overflow", f);
+    llvm::BasicBlock* cont = llvm::BasicBlock::Create(*m_context, "nooverflow", f);
+    m_builder->CreateCondBr(condition, trap, cont, llvm::MDBuilder(*m_context).createBranchWeights(1, 1048575));
+
+    m_builder->SetInsertPoint(trap);
+    m_builder->CreateCall(llvm::Intrinsic::getDeclaration(m_module.data(), llvm::Intrinsic::trap));
+    m_builder->CreateUnreachable();
+
+    m_builder->SetInsertPoint(cont);
 }
 
 llvm::Value* CodeGen::codegen(Expr* node, TypeInfo* info)
@@ -475,6 +1586,8 @@ llvm::Value* CodeGen::codegen(Expr* node, TypeInfo* info)
     switch (node->kind) {
     case Node::_BinaryExpr:
         return codegen(static_cast<BinaryExpr*>(node), info);
+    case Node::_ConditionalExpr:
+        return codegen(static_cast<ConditionalExpr*>(node), info);
     case Node::_FuncCallExpr:
         return codegen(static_cast<FuncCallExpr*>(node), info);
     case Node::_LiteralExpr:
@@ -483,19 +1596,94 @@ llvm::Value* CodeGen::codegen(Expr* node, TypeInfo* info)
         return codegen(static_cast<VarExpr*>(node), info);
     case Node::_TypeCtorExpr:
         return codegen(static_cast<TypeCtorExpr*>(node), info);
+    case Node::_UnaryExpr:
+        return codegen(static_cast<UnaryExpr*>(node));
     default:
         assert(false); // should not be reached
         return 0;
     }
 }
 
+llvm::Value* CodeGen::codegen(ConditionalExpr* node, TypeInfo* info)
+{
+    TypeInfo* conditionInfo = m_source->typeSystem().typeInfoForExpr(node->condition.data());
+    llvm::Value* condition = codegen(node->condition.data(), conditionInfo);
+    assert(condition);
+
+    if (condition->getType() != llvm::Type::getInt1Ty(*m_context)) {
+        m_source->error(node->condition->start,
+            "condition of conditional expression does not evaluate to true or false",
+            SourceBuffer::Fatal);
+    }
+
+    if (!info)
+        info = m_source->typeSystem().typeInfoForExpr(node);
+    if (!info) {
+        m_source->error(node->start, "can not determine type for conditional expression", SourceBuffer::Fatal);
+        return 0;
+    }
+
+    // Cheap sides without side effects are both evaluated and one is selected
+    // without a branch, which can not be mispredicted
+    if (isSafeToSpeculate(node->lhs.data()) && isSafeToSpeculate(node->rhs.data())) {
+        llvm::Value* lhs = codegen(node->lhs.data(), info);
+        llvm::Value* rhs = codegen(node->rhs.data(), info);
+        if (lhs->getType() != rhs->getType())
+            m_source->error(node->start, "sides of conditional expression have different types", SourceBuffer::Fatal);
+        return m_builder->CreateSelect(condition, lhs, rhs, "cond");
+    }
+
+    llvm::Function* f = m_builder->GetInsertBlock()->getParent();
+    assert(f);
+
+    llvm::BasicBlock* then = llvm::BasicBlock::Create(*m_context, "cond.true", f);
+    llvm::BasicBlock* otherwise = llvm::BasicBlock::Create(*m_context, "cond.false");
+    llvm::BasicBlock* condcont = llvm::BasicBlock::Create(*m_context, "condcont");
+    m_builder->CreateCondBr(condition, then, otherwise);
+
+    // Either side may have added blocks of its own so the phi takes the value
+    // from the block each side ends in
+    m_builder->SetInsertPoint(then);
+    llvm::Value* lhs = codegen(node->lhs.data(), info);
+    llvm::BasicBlock* lhsBlock = m_builder->GetInsertBlock();
+    m_builder->CreateBr(condcont);
+
+    f->getBasicBlockList().push_back(otherwise);
+    m_builder->SetInsertPoint(otherwise);
+    llvm::Value* rhs = codegen(node->rhs.data(), info);
+    llvm::BasicBlock* rhsBlock = m_builder->GetInsertBlock();
+    m_builder->CreateBr(condcont);
+
+    if (lhs->getType() != rhs->getType())
+        m_source->error(node->start, "sides of conditional expression have different types", SourceBuffer::Fatal);
+
+    f->getBasicBlockList().push_back(condcont);
+    m_builder->SetInsertPoint(condcont);
+    llvm::PHINode* phi = m_builder->CreatePHI(lhs->getType(), 2, "cond");
+    phi->addIncoming(lhs, lhsBlock);
+    phi->addIncoming(rhs, rhsBlock);
+    return phi;
+}
+
 llvm::Value* CodeGen::codegen(FuncCallExpr* node, TypeInfo* info)
 {
     if (!info)
         info = m_source->typeSystem().typeInfoForExpr(node);
 
+    if (TypeSystem::isBuiltinFunction(node->callee))
+        return codegenBuiltin(node);
+
     LLVMString callee = node->callee.toStringRef();
     llvm::Function *calleeFunction = m_module->getFunction(callee);
+
+    // Functions of earlier REPL entries live in other modules of the JIT and are
+    // declared on first use
+    TypeInfo* declared = m_source->typeSystem().toType(node->callee.toString());
+    if (!calleeFunction && declared && declared->isFunction()) {
+        registerFuncDecl(static_cast<FuncDecl*>(declared));
+        calleeFunction = m_module->getFunction(callee);
+    }
+
     if (!calleeFunction) {
         m_source->error(node->callee, "unknown function reference", SourceBuffer::Fatal);
         return 0;
@@ -512,6 +1700,26 @@ llvm::Value* CodeGen::codegen(FuncCallExpr* node, TypeInfo* info)
     }
 
     TypeInfo* function = m_source->typeSystem().toTypeAndCheck(node->callee);
+    if (m_function && !m_function->mayCall(static_cast<FuncDecl*>(function))) {
+        m_source->error(node->callee, "function can not call a function that is less pure than itself",
+                        SourceBuffer::Fatal);
+        return 0;
+    }
+
+    // Tail calls never get here since they are generated by codegenTailCall
+    if (m_function == function && m_function->hasAttribute("tailcall")) {
+        m_source->error(node->callee, "recursive call of function with tailcall attribute is not a tail call",
+                        SourceBuffer::Fatal);
+        return 0;
+    }
+
+    // Calls of functions without side effects on constant arguments are replaced
+    // by their value when optimizing, which must not hide a call that is rejected
+    // without optimization
+    ConstantEvaluator::Value value;
+    TypeInfo* returnInfo = m_source->typeSystem().resolveAlias(info);
+    if (m_evaluator.evaluate(node, returnInfo, &value))
+        return toConstant(value, returnInfo->handle, returnInfo->isSignedInt());
 
     int i = 0;
     QList<llvm::Value*> args;
@@ -528,35 +1736,138 @@ llvm::Value* CodeGen::codegen(FuncCallExpr* node, TypeInfo* info)
     return m_builder->CreateCall(calleeFunction, args.toVector().toStdVector(), "calltmp");
 }
 
-static int integerTypeToBase(TokenType type)
+llvm::Value* CodeGen::codegenBuiltin(FuncCallExpr* node)
 {
-    switch (type) {
-    case BinLiteral: return 2;
-    case OctLiteral: return 8;
-    case DecLiteral: return 10;
-    case HexLiteral: return 16;
-    default:
-        assert(false); // should not be reached
+    QString callee = node->callee.toString();
+    TypeInfo* vector = m_source->typeSystem().resolveAlias(m_source->typeSystem().typeInfoForExpr(node->args.first().data()));
+    TypeInfo* index = m_source->typeSystem().toType("_builtin_uint32_");
+    llvm::Value* value = codegen(node->args.first().data(), vector);
+
+    if (!TypeSystem::isVectorFunction(node->callee))
+        return codegenIntrinsic(node, vector, value);
+
+    // _builtin_extract_(vector, lane) and _builtin_insert_(vector, lane, element)
+    // read and replace a lane chosen at runtime
+    if (callee == "_builtin_extract_" || callee == "_builtin_insert_") {
+        int count = callee == "_builtin_extract_" ? 2 : 3;
+        if (node->args.count() != count) {
+            m_source->error(node->callee, "incorrect number of arguments passed", SourceBuffer::Fatal);
+            return 0;
+        }
+
+        llvm::Value* lane = codegen(node->args.at(1).data(), index);
+        if (count == 2)
+            return m_builder->CreateExtractElement(value, lane, "lane");
+
+        llvm::Value* element = codegen(node->args.at(2).data(), vector->elementType());
+        return m_builder->CreateInsertElement(value, element, lane, "insert");
+    }
+
+    // _builtin_shuffle_(a, b, lane...) picks each lane of the result from the lanes
+    // of a followed by those of b, which are given as literals
+    assert(callee == "_builtin_shuffle_");
+    if (node->args.count() != 2 + vector->lanes()) {
+        m_source->error(node->callee, "shuffle expects two vectors and a lane for each lane of the result",
+                        SourceBuffer::Fatal);
         return 0;
     }
+
+    llvm::Value* other = codegen(node->args.at(1).data(), vector);
+    std::vector<llvm::Constant*> mask;
+    for (int i = 2; i < node->args.count(); ++i) {
+        ConstantEvaluator::Value lane;
+        Expr* expr = node->args.at(i).data();
+        if (expr->kind != Node::_LiteralExpr || !m_evaluator.evaluate(expr, index, &lane)
+            || lane.integer >= 2 * vector->lanes()) {
+            m_source->error(expr->start, "shuffle lane must be a literal less than twice the number of lanes",
+                            SourceBuffer::Fatal);
+            return 0;
+        }
+        mask.push_back(m_builder->getInt32(uint32_t(lane.integer)));
+    }
+    return m_builder->CreateShuffleVector(value, other, llvm::ConstantVector::get(mask), "shuffle");
 }
 
-static QString integerLiteralToString(Token token)
+llvm::Value* CodeGen::codegenIntrinsic(FuncCallExpr* node, TypeInfo* info, llvm::Value* value)
 {
-    QString literal = token.toString();
-    if (token.type == BinLiteral || token.type == HexLiteral) {
-        if (!literal.startsWith('-'))
-            return literal.remove(0, 2);
-        else
-            return literal.remove(1, 2);
+    QString callee = node->callee.toString();
+    int count = callee == "_builtin_fma_" ? 3 : callee == "_builtin_expect_" ? 2 : 1;
+    if (node->args.count() != count) {
+        m_source->error(node->callee, "incorrect number of arguments passed", SourceBuffer::Fatal);
+        return 0;
+    }
+
+    QString error = TypeSystem::intrinsicArgumentError(node->callee, info);
+    if (!error.isEmpty()) {
+        m_source->error(node->callee, error, SourceBuffer::Fatal);
+        return 0;
+    }
+
+    QList<llvm::Value*> args;
+    for (int i = 1; i < count; ++i)
+        args.append(codegen(node->args.at(i).data(), info));
+
+    // The intrinsics are overloaded on the type of their first argument so a
+    // vector is operated on lane by lane
+    llvm::Type* type = value->getType();
+    if (callee == "_builtin_ctpop_") {
+        llvm::Function* intrinsic = llvm::Intrinsic::getDeclaration(m_module.data(), llvm::Intrinsic::ctpop, type);
+        return m_builder->CreateCall(intrinsic, value, "popcount");
+    }
+
+    // Zero has as many leading and trailing zeros as its width rather than an
+    // undefined number of them
+    if (callee == "_builtin_ctlz_" || callee == "_builtin_cttz_") {
+        llvm::Intrinsic::ID id = callee == "_builtin_ctlz_" ? llvm::Intrinsic::ctlz : llvm::Intrinsic::cttz;
+        llvm::Function* intrinsic = llvm::Intrinsic::getDeclaration(m_module.data(), id, type);
+        return m_builder->CreateCall2(intrinsic, value, m_builder->getFalse(), "zeros");
+    }
+
+    if (callee == "_builtin_bswap_") {
+        llvm::Function* intrinsic = llvm::Intrinsic::getDeclaration(m_module.data(), llvm::Intrinsic::bswap, type);
+        return m_builder->CreateCall(intrinsic, value, "bswap");
     }
-    return literal;
+
+    if (callee == "_builtin_sqrt_") {
+        llvm::Function* intrinsic = llvm::Intrinsic::getDeclaration(m_module.data(), llvm::Intrinsic::sqrt, type);
+        return m_builder->CreateCall(intrinsic, value, "sqrt");
+    }
+
+    // Fused multiply add rounds once, which the backend only lowers to a single
+    // instruction when the target has one and to a library call otherwise
+    if (callee == "_builtin_fma_") {
+        llvm::Function* intrinsic = llvm::Intrinsic::getDeclaration(m_module.data(), llvm::Intrinsic::fma, type);
+        return m_builder->CreateCall3(intrinsic, value, args.at(0), args.at(1), "fma");
+    }
+
+    // _builtin_expect_(value, expected) is value, with the hint that it usually
+    // equals expected for laying out the branches depending upon it
+    if (callee == "_builtin_expect_") {
+        llvm::Function* intrinsic = llvm::Intrinsic::getDeclaration(m_module.data(), llvm::Intrinsic::expect, type);
+        return m_builder->CreateCall2(intrinsic, value, args.at(0), "expect");
+    }
+
+    // _builtin_prefetch_(pointer) is pointer, after fetching what it points to into
+    // the data cache with the highest locality so it stays there
+    assert(callee == "_builtin_prefetch_");
+    llvm::Function* intrinsic = llvm::Intrinsic::getDeclaration(m_module.data(), llvm::Intrinsic::prefetch);
+    llvm::Value* address = m_builder->CreatePointerCast(value, m_builder->getInt8PtrTy(), "address");
+    m_builder->CreateCall4(intrinsic, address, m_builder->getInt32(0) /*read*/, m_builder->getInt32(3) /*locality*/,
+                           m_builder->getInt32(1) /*data cache*/);
+    return value;
 }
 
 llvm::Value* CodeGen::codegen(LiteralExpr* node, TypeInfo* info)
 {
     assert(info);
 
+    // A literal in the context of a vector is the same value in every lane
+    info = m_source->typeSystem().resolveAlias(info);
+    if (info->lanes()) {
+        llvm::Value* element = codegen(node, info->elementType());
+        return llvm::ConstantVector::getSplat(info->lanes(), llvm::cast<llvm::Constant>(element));
+    }
+
     if (node->literal.type == True) {
         return llvm::ConstantInt::getTrue(*m_context);
     } else if (node->literal.type == False) {
@@ -642,7 +1953,34 @@ llvm::Value* CodeGen::codegen(TypeCtorExpr* node, TypeInfo* info)
 {
     if (node->type.type == Undefined)
         return codegen(node->args.first().data(), info);
-    return 0;
+
+    // A vector is constructed from a value for each lane or splat from one value
+    TypeInfo* type = m_source->typeSystem().toTypeAndCheck(node->type);
+    if (!type->lanes())
+        return 0;
+
+    if (node->args.count() != 1 && node->args.count() != type->lanes()) {
+        m_source->error(node->type, "vector constructor expects one value or a value for each lane",
+                        SourceBuffer::Fatal);
+        return 0;
+    }
+
+    llvm::Value* vector = llvm::UndefValue::get(type->handle);
+    for (int i = 0; i < node->args.count(); ++i) {
+        llvm::Value* element = codegen(node->args.at(i).data(), type->elementType());
+        vector = m_builder->CreateInsertElement(vector, element, m_builder->getInt32(i), "lane");
+    }
+
+    if (node->args.count() == 1) {
+        llvm::Value* zeros = llvm::ConstantAggregateZero::get(llvm::VectorType::get(m_builder->getInt32Ty(), type->lanes()));
+        vector = m_builder->CreateShuffleVector(vector, vector, zeros, "splat");
+    }
+    return vector;
+}
+
+llvm::Value* CodeGen::codegen(UnaryExpr* node)
+{
+    return m_builder->CreateNot(codegenCondition(node->expr.data()), "nottmp");
 }
 
 llvm::Value* CodeGen::codegen(VarExpr* node, TypeInfo* info)
@@ -652,6 +1990,8 @@ llvm::Value* CodeGen::codegen(VarExpr* node, TypeInfo* info)
 
     QString name = node->var.toString();
     llvm::Value *value = m_namedValues.contains(name) ? m_namedValues.value(name) : 0;
+    if (llvm::AllocaInst* variable = m_variables.value(name))
+        value = m_builder->CreateLoad(variable, LLVMString(name));
     if (!value)
         m_source->error(node->var, "unknown variable name", SourceBuffer::Fatal);
     if (!info || info->handle != value->getType())
@@ -659,6 +1999,78 @@ llvm::Value* CodeGen::codegen(VarExpr* node, TypeInfo* info)
     return value;
 }
 
+void CodeGen::codegenTailCall(FuncCallExpr* node, TypeInfo* info)
+{
+    TypeInfo* function = m_source->typeSystem().toTypeAndCheck(node->callee);
+    if (function != m_function) {
+        // Only a call of a function with the same signature is guaranteed to
+        // reuse the stack frame of the caller
+        llvm::Value* value = codegen(node, info);
+        if (llvm::CallInst* call = llvm::dyn_cast<llvm::CallInst>(value)) {
+            if (call->getCalledFunction()->getFunctionType() != m_builder->GetInsertBlock()->getParent()->getFunctionType()) {
+                m_source->error(node->callee, "tail call of function with a different signature can not be guaranteed",
+                                SourceBuffer::Fatal);
+                return;
+            }
+            call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+        }
+        m_builder->CreateRet(value);
+        return;
+    }
+
+    if (node->args.count() != m_tailCallArgs.count()) {
+        m_source->error(node->callee, "incorrect number of arguments passed", SourceBuffer::Fatal);
+        return;
+    }
+
+    // All arguments are evaluated before any of them is replaced
+    QList<llvm::Value*> args;
+    for (int i = 0; i < node->args.count(); ++i) {
+        TypeInfo* argInfo = m_source->typeSystem().toTypeAndCheck(m_function->objects.at(i)->type);
+        args.append(codegen(node->args.at(i).data(), argInfo));
+    }
+
+    llvm::BasicBlock* block = m_builder->GetInsertBlock();
+    for (int i = 0; i < args.count(); ++i)
+        m_tailCallArgs.at(i)->addIncoming(args.at(i), block);
+    m_builder->CreateBr(m_tailCallHeader);
+}
+
+llvm::Value* CodeGen::codegenConstant(BinaryExpr* node, TypeInfo* info)
+{
+    // Only the context gives an expression of literals a type while comparisons
+    // are always of type bit
+    info = m_source->typeSystem().resolveAlias(info);
+    bool isCondition = node->isComparison() || node->isLogical();
+    if (!isCondition && (!info || !info->handle)) {
+        m_source->error(node->start, "can not determine type for expression of literals", SourceBuffer::Fatal);
+        return 0;
+    }
+
+    // Expressions of literals in the context of a vector are splat into every lane
+    ConstantEvaluator::Value value;
+    if (!m_evaluator.evaluate(node, info && info->lanes() ? info->elementType() : info, &value))
+        return 0;
+
+    if (isCondition)
+        return toConstant(value, llvm::Type::getInt1Ty(*m_context), false /*isSigned*/);
+    return toConstant(value, info->handle, info->isSignedInt());
+}
+
+llvm::Constant* CodeGen::toConstant(const ConstantEvaluator::Value& value, llvm::Type* type, bool isSigned) const
+{
+    if (type->isVectorTy()) {
+        llvm::Constant* element = toConstant(value, type->getVectorElementType(), isSigned);
+        return llvm::ConstantVector::getSplat(type->getVectorNumElements(), element);
+    }
+
+    if (type->isFloatTy() || type->isDoubleTy())
+        return llvm::ConstantFP::get(type, value.real);
+
+    assert(type->isIntegerTy());
+    return llvm::ConstantInt::get(type, uint64_t(value.integer), isSigned);
+}
+
 llvm::Type* CodeGen::toCodeGenType(const Token& tok) const
 {
     TypeInfo* info = m_source->typeSystem().toTypeAndCheck(tok);
@@ -2,6 +2,8 @@
 #define codegen_h
 
 #include <QtCore>
+#include "constantevaluator.h"
+#include "objectcache.h"
 #include "visitor.h"
 
 class SourceBuffer;
@@ -16,8 +18,13 @@ namespace llvm {
     class Module;
     typedef llvm::IRBuilder<true, llvm::ConstantFolder, llvm::IRBuilderDefaultInserter<true> > Builder;
     class Type;
+    class Constant;
     class Function;
     class Value;
+    class BasicBlock;
+    class PHINode;
+    class AllocaInst;
+    class BranchInst;
 }
 
 typedef QSharedPointer<llvm::LLVMContext> Context;
@@ -33,12 +40,48 @@ public:
     ~CodeGen();
 
     /*!
-     * \brief walks the AST and returns the generated LLVM IR
-     * @return an LLVM IR representation of the AST in the form of a QString
+     * \brief walks the AST and generates the module optimized at the level in Options; with
+     * a cache directory the module is left unoptimized and each partition is optimized on its own
      */
-    QString generateLLVMIR();
+    void generate();
+
+    /*!
+     * \brief prints the generated module as LLVM IR straight to file or to stdout if empty
+     * @return false if the file could not be written
+     */
+    bool writeLLVMIR(const QString& file) const;
+
+    /*!
+     * \brief splits the generated module along function boundaries and prints each
+     * partition as LLVM IR into directory
+     * @return the files of at most n partitions that together define the module or an
+     * empty list if a file could not be written; internal symbols of the module referenced
+     * across partitions are promoted to hidden external symbols
+     */
+    QStringList writePartitionedLLVMIR(int n, const QString& directory);
+
+    /*!
+     * \brief the functions the module defines in module order with their ObjectCache keys
+     * @return the keys or an empty list if no cache directory is set in Options
+     */
+    FunctionKeys functionKeys() const;
+
+    /*!
+     * \brief whether the module defines global variables no function uses
+     */
+    bool hasUnownedGlobals() const;
+
+    /*!
+     * \brief prints a partition of the module that defines only the given functions and the
+     * global variables they own, optimized on its own, as LLVM IR into file; an empty list
+     * selects the global variables no function uses
+     * @return false if the file could not be written
+     */
+    bool writePartitionLLVMIR(const QStringList& functions, const QString& file);
 
 private:
+    void walk();
+    void optimize(llvm::Module* module, int level);
     virtual void begin(Node&) {}
     virtual void end(Node&) {}
     virtual void visit(IncludeDecl&);
@@ -47,17 +90,40 @@ private:
     void registerBuiltins();
     void registerTypeDecl(TypeDecl*);
     void registerFuncDecl(FuncDecl*);
+    llvm::Function* memoize(FuncDecl* node, llvm::Function* f);
+    QList<llvm::Function*> multiversion(FuncDecl* node, llvm::Function* f);
     void codegen(FuncDef* node);
     void codegen(Stmt* node);
     void codegen(IfStmt* node);
     void codegen(ReturnStmt* node);
     void codegen(VarDeclStmt* node);
+    void codegen(AssignStmt* node);
+    void codegen(WhileStmt* node);
+    void codegen(ForStmt* node);
+    void codegen(MatchStmt* node);
+    void codegenBlock(const QList<QSharedPointer<Stmt> >& stmts, llvm::BasicBlock* next);
+    void addLoopMetadata(LoopStmt* node, llvm::BranchInst* backedge);
+    llvm::AllocaInst* createVariable(const QString& name, llvm::Type* type);
     llvm::Value* codegen(BinaryExpr* node, TypeInfo* info);
+    llvm::Value* codegen(ConditionalExpr* node, TypeInfo* info);
     llvm::Value* codegen(Expr* node, TypeInfo* info);
     llvm::Value* codegen(FuncCallExpr* node, TypeInfo* info);
+    llvm::Value* codegenBuiltin(FuncCallExpr* node);
+    llvm::Value* codegenIntrinsic(FuncCallExpr* node, TypeInfo* info, llvm::Value* value);
     llvm::Value* codegen(LiteralExpr* node, TypeInfo* info);
     llvm::Value* codegen(TypeCtorExpr* node, TypeInfo* info);
+    llvm::Value* codegen(UnaryExpr* node);
     llvm::Value* codegen(VarExpr* node, TypeInfo* info);
+    void codegenTailCall(FuncCallExpr* node, TypeInfo* info);
+    llvm::Value* codegenConstant(BinaryExpr* node, TypeInfo* info);
+    llvm::Value* codegenLogical(BinaryExpr* node);
+    llvm::Value* codegenCondition(Expr* node);
+    llvm::Value* codegenArithmetic(BinaryExpr* node, llvm::Value* l, llvm::Value* r, bool isSigned);
+    llvm::Value* codegenCheckedArithmetic(BinaryExpr* node, llvm::Value* l, llvm::Value* r, bool isSigned);
+    void codegenCheckDivisor(llvm::Value* l, llvm::Value* r, bool isSigned);
+    void codegenTrap(llvm::Value* condition);
+    llvm::Value* codegenShift(BinaryExpr* node, llvm::Value* l, llvm::Value* r, bool isSigned);
+    llvm::Constant* toConstant(const ConstantEvaluator::Value& value, llvm::Type* type, bool isSigned) const;
     llvm::Type* toCodeGenType(const Token& tok) const;
 
 private:
@@ -66,7 +132,13 @@ private:
     Module m_module;
     Builder m_builder;
     bool m_declPass;
+    FuncDecl* m_function;
+    llvm::BasicBlock* m_tailCallHeader;
+    QList<llvm::PHINode*> m_tailCallArgs;
     QHash<QString, llvm::Value*> m_namedValues;
+    QHash<QString, llvm::AllocaInst*> m_variables;
+    QHash<QString, QByteArray> m_functionKeys;
+    ConstantEvaluator m_evaluator;
 };
 
 #endif // codegen_h
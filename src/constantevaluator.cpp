@@ -0,0 +1,545 @@
+#include "constantevaluator.h"
+#include "ast.h"
+#include "options.h"
+
+#include <cmath>
+
+static bool isReal(Expr* node, TypeInfo* info)
+{
+    if (info)
+        return info->isFloatingPoint();
+    if (node->kind == Node::_LiteralExpr)
+        return static_cast<LiteralExpr*>(node)->literal.type == FloatLiteral;
+    if (node->kind == Node::_BinaryExpr) {
+        BinaryExpr* expr = static_cast<BinaryExpr*>(node);
+        return isReal(expr->lhs.data(), 0) || isReal(expr->rhs.data(), 0);
+    }
+    if (node->kind == Node::_TypeCtorExpr)
+        return isReal(static_cast<TypeCtorExpr*>(node)->args.first().data(), 0);
+    return false;
+}
+
+ConstantEvaluator::ConstantEvaluator(SourceBuffer* source, SourceBuffer::ErrorType errorType)
+    : m_source(source)
+    , m_errorType(errorType)
+    , m_evaluateCalls(false)
+    , m_reportErrors(false)
+    , m_steps(0)
+    , m_depth(0)
+{
+}
+
+ConstantEvaluator::~ConstantEvaluator()
+{
+}
+
+bool ConstantEvaluator::isLiteral(Expr* node)
+{
+    switch (node->kind) {
+    case Node::_LiteralExpr:
+        return true;
+    case Node::_BinaryExpr:
+        return isLiteral(static_cast<BinaryExpr*>(node)->lhs.data())
+            && isLiteral(static_cast<BinaryExpr*>(node)->rhs.data());
+    case Node::_TypeCtorExpr:
+    {
+        TypeCtorExpr* expr = static_cast<TypeCtorExpr*>(node);
+        return expr->type.type == Undefined && isLiteral(expr->args.first().data());
+    }
+    default:
+        return false;
+    }
+}
+
+bool ConstantEvaluator::evaluate(Expr* node, TypeInfo* info, Value* value)
+{
+    // Only an expression of literals is reported as an error since any other
+    // expression is still compiled when it is not constant
+    m_steps = Options::instance()->constexprSteps();
+    m_depth = 0;
+    m_reportErrors = isLiteral(node);
+    return evaluate(node, info, Frame(), value);
+}
+
+bool ConstantEvaluator::evaluate(Expr* node, TypeInfo* info, const Frame& frame, Value* value)
+{
+    if (--m_steps < 0)
+        return error(node->start, "constant expression exceeds the evaluation step limit");
+
+    switch (node->kind) {
+    case Node::_BinaryExpr:
+        return evaluate(static_cast<BinaryExpr*>(node), info, frame, value);
+    case Node::_ConditionalExpr:
+    {
+        ConditionalExpr* expr = static_cast<ConditionalExpr*>(node);
+        Value condition;
+        if (!evaluate(expr->condition.data(), typeInfoForExpr(expr->condition.data(), frame), frame, &condition))
+            return false;
+        return evaluate(condition.integer ? expr->lhs.data() : expr->rhs.data(), info, frame, value);
+    }
+    case Node::_FuncCallExpr:
+        return evaluate(static_cast<FuncCallExpr*>(node), frame, value);
+    case Node::_LiteralExpr:
+        return evaluate(static_cast<LiteralExpr*>(node), info, value);
+    case Node::_TypeCtorExpr:
+    {
+        TypeCtorExpr* expr = static_cast<TypeCtorExpr*>(node);
+        return expr->type.type == Undefined && evaluate(expr->args.first().data(), info, frame, value);
+    }
+    case Node::_UnaryExpr:
+    {
+        Expr* operand = static_cast<UnaryExpr*>(node)->expr.data();
+        Value condition;
+        if (!evaluate(operand, typeInfoForExpr(operand, frame), frame, &condition))
+            return false;
+        *value = Value();
+        value->integer = !condition.integer;
+        return true;
+    }
+    case Node::_VarExpr:
+    {
+        QString name = static_cast<VarExpr*>(node)->var.toString();
+        if (!frame.contains(name))
+            return false;
+        *value = frame.value(name).first;
+        return true;
+    }
+    default:
+        assert(false); // should not be reached
+        return false;
+    }
+}
+
+bool ConstantEvaluator::evaluate(BinaryExpr* node, TypeInfo* info, const Frame& frame, Value* value)
+{
+    // The right operand of a logical operator is only evaluated when the left
+    // one does not decide the result, as at run time
+    if (node->isLogical()) {
+        Value condition;
+        Expr* lhs = node->lhs.data();
+        Expr* rhs = node->rhs.data();
+        if (!evaluate(lhs, typeInfoForExpr(lhs, frame), frame, &condition))
+            return false;
+        if (bool(condition.integer) == (node->op == BinaryExpr::OpLogicalAnd)
+            && !evaluate(rhs, typeInfoForExpr(rhs, frame), frame, &condition))
+            return false;
+        *value = Value();
+        value->integer = condition.integer != 0;
+        return true;
+    }
+
+    // Comparisons of literals compare their exact values since nothing gives
+    // their operands a type
+    bool comparison = node->isComparison();
+    TypeInfo* operandInfo = typeInfoForExpr(node->lhs.data(), frame);
+    if (!operandInfo)
+        operandInfo = typeInfoForExpr(node->rhs.data(), frame);
+    if (!operandInfo && !comparison)
+        operandInfo = info;
+
+    Value l;
+    Value r;
+    if (!evaluate(node->lhs.data(), operandInfo, frame, &l) || !evaluate(node->rhs.data(), operandInfo, frame, &r))
+        return false;
+
+    bool real = isReal(node, operandInfo);
+    if (real && !operandInfo) {
+        // An untyped comparison of an integer and a float literal
+        if (!isReal(node->lhs.data(), 0))
+            l.real = double(l.integer);
+        if (!isReal(node->rhs.data(), 0))
+            r.real = double(r.integer);
+    }
+
+    // Shifts by at least the width of the type wrap the amount at run time, which is
+    // left to the generated code
+    if (node->isBitwise()) {
+        if (real)
+            return error(node->start, "bitwise operator expects integer operands");
+        int bits = operandInfo ? operandInfo->bitWidth() : 64;
+        bool shift = node->op == BinaryExpr::OpShiftLeft || node->op == BinaryExpr::OpShiftRight;
+        if (shift && (r.integer < 0 || r.integer >= bits))
+            return error(node->start, "shift amount out of range in constant expression");
+    }
+
+    *value = Value();
+    bool overflow = false;
+    switch (node->op) {
+    case BinaryExpr::OpEquality:
+        value->integer = real ? l.real == r.real : l.integer == r.integer;
+        return true;
+    case BinaryExpr::OpNotEquality:
+        value->integer = real ? l.real < r.real || l.real > r.real : l.integer != r.integer;
+        return true;
+    case BinaryExpr::OpLessThanOrEquality:
+        value->integer = real ? l.real <= r.real : l.integer <= r.integer;
+        return true;
+    case BinaryExpr::OpGreaterThanOrEquality:
+        value->integer = real ? l.real >= r.real : l.integer >= r.integer;
+        return true;
+    case BinaryExpr::OpLessThan:
+        value->integer = real ? l.real < r.real : l.integer < r.integer;
+        return true;
+    case BinaryExpr::OpGreaterThan:
+        value->integer = real ? l.real > r.real : l.integer > r.integer;
+        return true;
+    case BinaryExpr::OpAddition:
+        if (real)
+            value->real = l.real + r.real;
+        else
+            overflow = __builtin_add_overflow(l.integer, r.integer, &value->integer);
+        break;
+    case BinaryExpr::OpSubtraction:
+        if (real)
+            value->real = l.real - r.real;
+        else
+            overflow = __builtin_sub_overflow(l.integer, r.integer, &value->integer);
+        break;
+    case BinaryExpr::OpMultiplication:
+        if (real)
+            value->real = l.real * r.real;
+        else
+            overflow = __builtin_mul_overflow(l.integer, r.integer, &value->integer);
+        break;
+    case BinaryExpr::OpDivision:
+        if (!real && !r.integer)
+            return error(node->start, "division by zero in constant expression");
+        if (real)
+            value->real = l.real / r.real;
+        else
+            value->integer = l.integer / r.integer;
+        break;
+    case BinaryExpr::OpRemainder:
+        if (!real && !r.integer)
+            return error(node->start, "division by zero in constant expression");
+        if (real)
+            value->real = std::fmod(l.real, r.real);
+        else
+            value->integer = l.integer % r.integer;
+        break;
+    case BinaryExpr::OpLogicalAnd:
+    case BinaryExpr::OpLogicalOr:
+        assert(false); // should not be reached
+        return false;
+    case BinaryExpr::OpBitwiseAnd:
+        value->integer = l.integer & r.integer;
+        break;
+    case BinaryExpr::OpBitwiseOr:
+        value->integer = l.integer | r.integer;
+        break;
+    case BinaryExpr::OpBitwiseXor:
+        value->integer = l.integer ^ r.integer;
+        break;
+    case BinaryExpr::OpShiftLeft:
+        value->integer = l.integer << int(r.integer);
+        overflow = value->integer >> int(r.integer) != l.integer;
+        break;
+    case BinaryExpr::OpShiftRight:
+        value->integer = l.integer >> int(r.integer);
+        break;
+    }
+
+    if (real && operandInfo && operandInfo->bitWidth() == 32)
+        value->real = float(value->real);
+
+    // Results that would wrap at run time are only folded when they are the
+    // value of an expression of literals, where wrapping is surely a mistake
+    if (overflow || !isInRange(*value, operandInfo))
+        return error(node->start, "constant expression out of range");
+    return true;
+}
+
+bool ConstantEvaluator::evaluate(FuncCallExpr* node, const Frame& frame, Value* value)
+{
+    // Running out of depth fails the whole evaluation as running out of steps does
+    QString name = node->callee.toString();
+    if (!m_evaluateCalls || m_exhausted.contains(name))
+        return false;
+    if (m_depth >= Options::instance()->constexprDepth()) {
+        m_steps = -1;
+        return false;
+    }
+
+    TypeInfo* info = m_source->typeSystem().toType(name);
+    if (!info || !info->isFunction())
+        return false;
+
+    // Extern functions are the only source of side effects
+    FuncDecl* function = static_cast<FuncDecl*>(info);
+    FuncDef* funcDef = function->funcDef.data();
+    if (!funcDef || function->objects.count() != node->args.count())
+        return false;
+
+    // Values are scalars so functions of vectors are left to run
+    Frame callee;
+    for (int i = 0; i < node->args.count(); ++i) {
+        TypeInfo* type = m_source->typeSystem().resolveAlias(m_source->typeSystem().toType(function->objects.at(i)->type.toString()));
+        Value arg;
+        if (!type || type->lanes() || !evaluate(node->args.at(i).data(), type, frame, &arg))
+            return false;
+        callee.insert(function->objects.at(i)->name.toString(), qMakePair(arg, type));
+    }
+
+    TypeInfo* returnInfo = m_source->typeSystem().resolveAlias(m_source->typeSystem().toType(function->returnType->type.toString()));
+    if (!returnInfo || returnInfo->lanes())
+        return false;
+
+    ++m_depth;
+    Result result = Continue;
+    for (int i = 0; i < funcDef->stmts.count() && result == Continue; ++i)
+        result = execute(funcDef->stmts.at(i).data(), returnInfo, callee, value);
+    --m_depth;
+
+    // A function too expensive to evaluate once is likely to be so again, and
+    // every other call site would otherwise spend the whole budget on it too
+    if (m_steps < 0)
+        m_exhausted.insert(name);
+
+    return result == Returned;
+}
+
+bool ConstantEvaluator::evaluate(LiteralExpr* node, TypeInfo* info, Value* value)
+{
+    *value = Value();
+    TokenType type = node->literal.type;
+    if (type == True || type == False) {
+        value->integer = type == True;
+        return true;
+    }
+
+    if (type == StringLiteral)
+        return error(node->literal, "string literal in constant expression");
+
+    bool success = false;
+    if (type == FloatLiteral) {
+        if (info && !info->isFloatingPoint())
+            return error(node->literal, "expression for float literal has incompatible type");
+
+        value->real = node->literal.toString().toDouble(&success);
+        if (info && info->bitWidth() == 32)
+            value->real = float(value->real);
+        return success || error(node->literal, "float literal out of range");
+    }
+
+    if (info && info->isFloatingPoint())
+        return error(node->literal, "expression for integer literal has incompatible type");
+
+    // Untyped literals take whichever of the 64 bit types holds them
+    QString digits = integerLiteralToString(node->literal);
+    int base = integerTypeToBase(type);
+    if (!info || info->isSignedInt()) {
+        value->integer = digits.toLongLong(&success, base);
+        if (!success && !info)
+            value->integer = digits.toULongLong(&success, base);
+    } else {
+        value->integer = digits.toULongLong(&success, base);
+    }
+
+    if (!success || !isInRange(*value, info))
+        return error(node->literal, "integer literal out of range");
+    return true;
+}
+
+ConstantEvaluator::Result ConstantEvaluator::execute(Stmt* node, TypeInfo* returnInfo, Frame& frame, Value* value)
+{
+    if (--m_steps < 0)
+        return NotConstant;
+
+    switch (node->kind) {
+    case Node::_IfStmt:
+    {
+        IfStmt* stmt = static_cast<IfStmt*>(node);
+        Value condition;
+        if (!evaluate(stmt->expr.data(), typeInfoForExpr(stmt->expr.data(), frame), frame, &condition))
+            return NotConstant;
+        if (condition.integer)
+            return execute(stmt->stmt.data(), returnInfo, frame, value);
+        return stmt->elseStmt ? execute(stmt->elseStmt.data(), returnInfo, frame, value) : Continue;
+    }
+    case Node::_ReturnStmt:
+        return evaluate(static_cast<ReturnStmt*>(node)->expr.data(), returnInfo, frame, value) ? Returned : NotConstant;
+    case Node::_VarDeclStmt:
+    {
+        VarDeclStmt* stmt = static_cast<VarDeclStmt*>(node);
+        TypeInfo* type = m_source->typeSystem().resolveAlias(m_source->typeSystem().toType(stmt->type.toString()));
+        Value var;
+        if (!evaluate(stmt->expr.data(), type, frame, &var))
+            return NotConstant;
+        frame.insert(stmt->name.toString(), qMakePair(var, type));
+        return Continue;
+    }
+    case Node::_AssignStmt:
+    {
+        AssignStmt* stmt = static_cast<AssignStmt*>(node);
+        QString name = stmt->name.toString();
+        if (!frame.contains(name))
+            return NotConstant;
+        Value var;
+        if (!evaluate(stmt->expr.data(), frame.value(name).second, frame, &var))
+            return NotConstant;
+        frame[name].first = var;
+        return Continue;
+    }
+    case Node::_WhileStmt:
+    {
+        // Every iteration runs statements so the step budget ends loops that never do
+        WhileStmt* stmt = static_cast<WhileStmt*>(node);
+        for (;;) {
+            Value condition;
+            if (!evaluate(stmt->expr.data(), typeInfoForExpr(stmt->expr.data(), frame), frame, &condition))
+                return NotConstant;
+            if (!condition.integer)
+                return Continue;
+            Result result = executeBlock(stmt->stmts, returnInfo, frame, frame, value);
+            if (result != Continue)
+                return result;
+        }
+    }
+    case Node::_ForStmt:
+    {
+        ForStmt* stmt = static_cast<ForStmt*>(node);
+        TypeInfo* type = m_source->typeSystem().resolveAlias(m_source->typeSystem().toType(stmt->type.toString()));
+        Value counter, end, step;
+        step.integer = 1;
+        if (!evaluate(stmt->start.data(), type, frame, &counter) || !evaluate(stmt->end.data(), type, frame, &end)
+            || (stmt->step && !evaluate(stmt->step.data(), type, frame, &step))) {
+            return NotConstant;
+        }
+
+        // A step that is not positive runs the body no times
+        if (type->isSignedInt() ? step.integer <= 0 : step.integer == 0)
+            return Continue;
+
+        // The counter only shadows a variable of the same name in the body
+        QString name = stmt->name.toString();
+        bool shadows = frame.contains(name);
+        QPair<Value, TypeInfo*> shadowed = frame.value(name);
+        while (counter.integer < end.integer) {
+            Frame body = frame;
+            body.insert(name, qMakePair(counter, type));
+            Result result = executeBlock(stmt->stmts, returnInfo, frame, body, value);
+            if (shadows)
+                frame.insert(name, shadowed);
+            else
+                frame.remove(name);
+            if (result != Continue)
+                return result;
+
+            // The loop ends before the step takes the counter to or past the end
+            if (quint64(end.integer) - quint64(counter.integer) <= quint64(step.integer))
+                break;
+            counter.integer += step.integer;
+        }
+        return Continue;
+    }
+    case Node::_MatchStmt:
+    {
+        MatchStmt* stmt = static_cast<MatchStmt*>(node);
+        TypeInfo* type = typeInfoForExpr(stmt->expr.data(), frame);
+        Value subject;
+        if (!evaluate(stmt->expr.data(), type, frame, &subject))
+            return NotConstant;
+
+        MatchCase* selected = 0;
+        foreach (QSharedPointer<MatchCase> matchCase, stmt->cases) {
+            if (matchCase->isDefault() && !selected)
+                selected = matchCase.data();
+
+            foreach (QSharedPointer<LiteralExpr> literal, matchCase->values) {
+                Value constant;
+                if (!evaluate(literal.data(), type, &constant))
+                    return NotConstant;
+                if (constant.integer == subject.integer)
+                    return executeBlock(matchCase->stmts, returnInfo, frame, frame, value);
+            }
+        }
+
+        return selected ? executeBlock(selected->stmts, returnInfo, frame, frame, value) : Continue;
+    }
+    default:
+        assert(false); // should not be reached
+        return NotConstant;
+    }
+}
+
+ConstantEvaluator::Result ConstantEvaluator::executeBlock(const QList<QSharedPointer<Stmt> >& stmts, TypeInfo* returnInfo,
+                                                          Frame& frame, Frame body, Value* value)
+{
+    foreach (QSharedPointer<Stmt> stmt, stmts) {
+        Result result = execute(stmt.data(), returnInfo, body, value);
+        if (result != Continue)
+            return result;
+    }
+
+    // Variables declared in a block go out of scope while assignments to the
+    // variables around it remain
+    for (Frame::iterator it = frame.begin(); it != frame.end(); ++it)
+        it.value() = body.value(it.key());
+    return Continue;
+}
+
+TypeInfo* ConstantEvaluator::typeInfoForExpr(Expr* node, const Frame& frame) const
+{
+    // The variables are those of the evaluated call rather than of the function
+    // being compiled so the type system can not be asked for their types
+    switch (node->kind) {
+    case Node::_BinaryExpr:
+    {
+        BinaryExpr* expr = static_cast<BinaryExpr*>(node);
+        if (expr->isLogical())
+            return m_source->typeSystem().bitType();
+        if (TypeInfo* info = typeInfoForExpr(expr->lhs.data(), frame))
+            return info;
+        return typeInfoForExpr(expr->rhs.data(), frame);
+    }
+    case Node::_ConditionalExpr:
+    {
+        ConditionalExpr* expr = static_cast<ConditionalExpr*>(node);
+        if (TypeInfo* info = typeInfoForExpr(expr->lhs.data(), frame))
+            return info;
+        return typeInfoForExpr(expr->rhs.data(), frame);
+    }
+    case Node::_FuncCallExpr:
+    {
+        TypeInfo* function = m_source->typeSystem().toType(static_cast<FuncCallExpr*>(node)->callee.toString());
+        if (!function || !function->returnTypeRef())
+            return 0;
+        return m_source->typeSystem().resolveAlias(m_source->typeSystem().toType(function->returnTypeRef()->typeName()));
+    }
+    case Node::_TypeCtorExpr:
+    {
+        TypeCtorExpr* expr = static_cast<TypeCtorExpr*>(node);
+        if (expr->type.type == Undefined)
+            return typeInfoForExpr(expr->args.first().data(), frame);
+        return m_source->typeSystem().resolveAlias(m_source->typeSystem().toType(expr->type.toString()));
+    }
+    case Node::_UnaryExpr:
+        return m_source->typeSystem().bitType();
+    case Node::_VarExpr:
+        return frame.value(static_cast<VarExpr*>(node)->var.toString()).second;
+    default:
+        return 0;
+    }
+}
+
+bool ConstantEvaluator::error(const Token& tok, const QString& message)
+{
+    if (m_reportErrors)
+        m_source->error(tok, message, m_errorType);
+    return false;
+}
+
+bool ConstantEvaluator::isInRange(const Value& value, TypeInfo* info) const
+{
+    if (!info || info->isFloatingPoint() || !info->bitWidth())
+        return true;
+
+    int bits = info->bitWidth();
+    if (bits == 1)
+        return value.integer == 0 || value.integer == 1;
+
+    Integer one = 1;
+    if (info->isSignedInt())
+        return value.integer >= -(one << (bits - 1)) && value.integer < (one << (bits - 1));
+    return value.integer >= 0 && value.integer < (one << bits);
+}
@@ -0,0 +1,70 @@
+#ifndef constantevaluator_h
+#define constantevaluator_h
+
+#include <QtCore>
+#include "sourcebuffer.h"
+
+class ConstantEvaluator {
+public:
+    // Wide enough to hold every value of the 64 bit signed and unsigned types and
+    // the exact result of any operation on two of them
+    typedef __int128 Integer;
+
+    struct Value {
+        Value() : integer(0), real(0) {}
+        Integer integer;
+        double real;
+    };
+
+    ConstantEvaluator(SourceBuffer* source, SourceBuffer::ErrorType errorType = SourceBuffer::Error);
+    ~ConstantEvaluator();
+
+    /*!
+     * \brief evaluates an expression of type info, where comparisons are of type bit and
+     * info may be 0 for literals and expressions of literals; calls are only evaluated when
+     * enabled and only for functions that call no extern function and finish within the
+     * step and depth budgets in Options, where a function that once exhausted them is no
+     * longer evaluated
+     * @return false if the expression is not constant or its value is out of range for its
+     * type; either is reported as an error when the expression only involves literals
+     */
+    bool evaluate(Expr* node, TypeInfo* info, Value* value);
+
+    void setEvaluateCalls(bool evaluateCalls) { m_evaluateCalls = evaluateCalls; }
+
+    /*!
+     * \brief whether both operands of a binary expression are literals, possibly nested
+     */
+    static bool isLiteral(Expr* node);
+
+private:
+    typedef QHash<QString, QPair<Value, TypeInfo*> > Frame;
+
+    enum Result {
+        Continue,
+        Returned,
+        NotConstant
+    };
+
+    bool evaluate(Expr* node, TypeInfo* info, const Frame& frame, Value* value);
+    bool evaluate(BinaryExpr* node, TypeInfo* info, const Frame& frame, Value* value);
+    bool evaluate(FuncCallExpr* node, const Frame& frame, Value* value);
+    bool evaluate(LiteralExpr* node, TypeInfo* info, Value* value);
+    Result execute(Stmt* node, TypeInfo* returnInfo, Frame& frame, Value* value);
+    Result executeBlock(const QList<QSharedPointer<Stmt> >& stmts, TypeInfo* returnInfo, Frame& frame, Frame body,
+                        Value* value);
+    TypeInfo* typeInfoForExpr(Expr* node, const Frame& frame) const;
+    bool error(const Token& tok, const QString& message);
+    bool isInRange(const Value& value, TypeInfo* info) const;
+
+private:
+    SourceBuffer* m_source;
+    SourceBuffer::ErrorType m_errorType;
+    bool m_evaluateCalls;
+    bool m_reportErrors;
+    int m_steps;
+    int m_depth;
+    QSet<QString> m_exhausted;
+};
+
+#endif // constantevaluator_h
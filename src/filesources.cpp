@@ -1,7 +1,9 @@
 #include "filesources.h"
 
-#include "sourcebuffer.h"
+#include "lexer.h"
 #include "options.h"
+#include "parser.h"
+#include "sourcebuffer.h"
 
 FileSources* FileSources::instance()
 {
@@ -12,10 +14,16 @@ FileSources* FileSources::instance()
 }
 
 SourceBuffer* FileSources::sourceBuffer(const QString& name)
+{
+    QFileInfo info = findFile(name);
+    return info.exists() ? sourceBuffer(info) : 0;
+}
+
+QFileInfo FileSources::findFile(const QString& name) const
 {
     QFileInfo info(name);
     if (info.exists())
-        return sourceBuffer(info);
+        return info;
 
     QStringList dirs;
     dirs << Options::instance()->includeDirs();
@@ -23,16 +31,19 @@ SourceBuffer* FileSources::sourceBuffer(const QString& name)
     foreach (QString dir, dirs) {
         QFileInfo info(dir + QDir::separator() + name);
         if (info.exists())
-            return sourceBuffer(info);
+            return info;
     }
 
-    return 0;
+    return QFileInfo();
 }
 
 SourceBuffer* FileSources::sourceBuffer(const QFileInfo& info)
 {
-    if (m_sourceBuffers.contains(info.absoluteFilePath()))
-        return m_sourceBuffers.value(info.absoluteFilePath()).data();
+    QString path = info.absoluteFilePath();
+    if (m_sourceBuffers.contains(path)) {
+        addDependency(path);
+        return m_sourceBuffers.value(path).data();
+    }
 
     QString fileContents;
     QFile file(info.absoluteFilePath());
@@ -44,10 +55,52 @@ SourceBuffer* FileSources::sourceBuffer(const QFileInfo& info)
         return 0;
 
     SourceBuffer* buffer = new SourceBuffer(fileContents, info.fileName());
-    m_sourceBuffers.insert(info.absoluteFilePath(), QSharedPointer<SourceBuffer>(buffer));
+    m_sourceBuffers.insert(path, QSharedPointer<SourceBuffer>(buffer));
+
+    addDependency(path);
+
+    Lexer lexer;
+    lexer.lex(buffer);
+
+    Parser parser;
+    parser.parse(buffer);
+
+    // The includes of a file are resolved as it is loaded since the phases only
+    // visit the includes of a file the first time it is included
+    QStringList includes;
+    foreach (QSharedPointer<IncludeDecl> decl, buffer->translationUnit().includeDecl) {
+        QString include = decl->include.toString();
+        include.remove(0, 1); // remove leading quote
+        include.chop(1); // remove trailing quote
+
+        QFileInfo includeInfo = findFile(include);
+        if (includeInfo.exists() && sourceBuffer(includeInfo))
+            includes.append(includeInfo.absoluteFilePath());
+    }
+    m_includes.insert(path, includes);
     return buffer;
 }
 
+void FileSources::addDependency(const QString& path)
+{
+    if (m_dependencies.contains(path))
+        return;
+
+    m_dependencies.append(path);
+    foreach (QString include, m_includes.value(path))
+        addDependency(include);
+}
+
+QString FileSources::filePath(const Token& tok) const
+{
+    QHash<QString, QSharedPointer<SourceBuffer> >::const_iterator it = m_sourceBuffers.begin();
+    for (; it != m_sourceBuffers.end(); ++it) {
+        if (it.value()->contains(tok))
+            return it.key();
+    }
+    return QString();
+}
+
 FileSources::FileSources()
 {
 }
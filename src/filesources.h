@@ -4,20 +4,43 @@
 #include <QtCore>
 
 class SourceBuffer;
+struct Token;
 
 class FileSources {
 public:
     static FileSources* instance();
 
+    /*!
+     * \brief finds, loads, lexes and parses the named file once
+     * @return the cached source buffer or 0 if the file could not be found
+     */
     SourceBuffer* sourceBuffer(const QString& fileName);
 
+    /*!
+     * \brief the absolute path of the loaded file a token was lexed from
+     * @return the path or an empty string if the token is not from a file loaded here
+     */
+    QString filePath(const Token& tok) const;
+
+    /*!
+     * \brief the files resolved by sourceBuffer since the last reset together with
+     * the files they include, however deeply and whenever they were loaded
+     * @return the absolute paths in the order they were first resolved
+     */
+    QStringList dependencies() const { return m_dependencies; }
+    void resetDependencies() { m_dependencies.clear(); }
+
 private:
     SourceBuffer* sourceBuffer(const QFileInfo&);
+    QFileInfo findFile(const QString& name) const;
+    void addDependency(const QString& path);
 
     FileSources();
     ~FileSources();
 
     QHash<QString, QSharedPointer<SourceBuffer> > m_sourceBuffers;
+    QStringList m_dependencies;
+    QHash<QString, QStringList> m_includes;
 };
 
 #endif // filesources_h
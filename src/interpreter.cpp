@@ -0,0 +1,359 @@
+#include "interpreter.h"
+
+#include <cmath>
+
+// The registers of every active call share one stack of this many values
+static const int s_stackSize = 1 << 20;
+
+// Threading the dispatch through a table of label addresses gives every
+// instruction its own indirect branch, which predicts far better than the
+// single branch of a switch
+#if defined(__GNUC__)
+#define UNV_COMPUTED_GOTO
+#endif
+
+#ifdef UNV_COMPUTED_GOTO
+#define DISPATCH() goto *labels[pc->op];
+#define CASE(op) op_##op:
+#define NEXT() goto *labels[pc->op]
+#else
+#define DISPATCH() switch (pc->op)
+#define CASE(op) case Bytecode::op:
+#define NEXT() continue
+#endif
+
+#define R(reg) registers[reg]
+
+typedef quint64 (*Extern0)();
+typedef quint64 (*Extern1)(quint64);
+typedef quint64 (*Extern2)(quint64, quint64);
+typedef quint64 (*Extern3)(quint64, quint64, quint64);
+typedef quint64 (*Extern4)(quint64, quint64, quint64, quint64);
+typedef quint64 (*Extern5)(quint64, quint64, quint64, quint64, quint64);
+typedef quint64 (*Extern6)(quint64, quint64, quint64, quint64, quint64, quint64);
+
+// Unlike sums and products, quotients depend upon the bits above the width
+// of their operands so those are made into a sign or zero extension first
+static inline qint64 toSigned(quint64 value, quint64 shift)
+{
+    return qint64(value << shift) >> shift;
+}
+
+static inline quint64 toUnsigned(quint64 value, quint64 shift)
+{
+    return value << shift >> shift;
+}
+
+struct Frame {
+    const Bytecode::Function* function;
+    const Bytecode::Instruction* pc;
+    Bytecode::Value* registers;
+};
+
+static quint64 callExtern(const Bytecode::Extern& function, const quint64* a)
+{
+    // Integers and pointers are all passed as 64 bit words and the callee only
+    // reads the width of its parameters
+    void* address = function.address;
+    switch (function.parameterCount) {
+    case 0: return reinterpret_cast<Extern0>(address)();
+    case 1: return reinterpret_cast<Extern1>(address)(a[0]);
+    case 2: return reinterpret_cast<Extern2>(address)(a[0], a[1]);
+    case 3: return reinterpret_cast<Extern3>(address)(a[0], a[1], a[2]);
+    case 4: return reinterpret_cast<Extern4>(address)(a[0], a[1], a[2], a[3]);
+    case 5: return reinterpret_cast<Extern5>(address)(a[0], a[1], a[2], a[3], a[4]);
+    case 6: return reinterpret_cast<Extern6>(address)(a[0], a[1], a[2], a[3], a[4], a[5]);
+    default:
+        assert(false); // should not be reached
+        return 0;
+    }
+}
+
+Interpreter::Interpreter(const Bytecode::Program& program)
+    : m_program(program)
+    , m_stack(s_stackSize)
+{
+}
+
+Interpreter::~Interpreter()
+{
+}
+
+bool Interpreter::run(int index, qint64* result)
+{
+#ifdef UNV_COMPUTED_GOTO
+    static void* labels[] = {
+        &&op_Constant, &&op_Move,
+        &&op_AddInt, &&op_SubInt, &&op_MulInt,
+        &&op_AddFloat, &&op_SubFloat, &&op_MulFloat,
+        &&op_AddDouble, &&op_SubDouble, &&op_MulDouble,
+        &&op_DivSigned, &&op_DivUnsigned, &&op_RemSigned, &&op_RemUnsigned,
+        &&op_DivFloat, &&op_DivDouble, &&op_RemDouble,
+        &&op_AndInt, &&op_OrInt, &&op_XorInt,
+        &&op_ShiftLeft, &&op_ShiftRightSigned, &&op_ShiftRightUnsigned,
+        &&op_PopCount, &&op_CountLeadingZeros, &&op_CountTrailingZeros, &&op_ByteSwap,
+        &&op_SqrtFloat, &&op_SqrtDouble, &&op_FmaFloat, &&op_FmaDouble,
+        &&op_EqualInt, &&op_NotEqualInt,
+        &&op_LessThanSigned, &&op_LessThanOrEqualSigned,
+        &&op_LessThanUnsigned, &&op_LessThanOrEqualUnsigned,
+        &&op_EqualDouble, &&op_NotEqualDouble,
+        &&op_LessThanDouble, &&op_LessThanOrEqualDouble,
+        &&op_Jump, &&op_JumpIfFalse, &&op_JumpIfTrue,
+        &&op_Call, &&op_CallExtern, &&op_Return
+    };
+    Q_STATIC_ASSERT(sizeof(labels) / sizeof(labels[0]) == Bytecode::OpcodeCount);
+#endif
+
+    const Bytecode::Function* function = &m_program.functions.at(index);
+    Bytecode::Value* registers = m_stack.data();
+    Bytecode::Value* stackEnd = m_stack.data() + m_stack.count();
+    if (registers + function->registerCount > stackEnd)
+        return false;
+
+    const Bytecode::Instruction* code = function->code.constData();
+    const Bytecode::Instruction* pc = code;
+    QVector<Frame> frames;
+
+    for (;;) {
+        DISPATCH() {
+        CASE(Constant)
+            R(pc->dst) = pc->imm;
+            ++pc;
+            NEXT();
+        CASE(Move)
+            R(pc->dst) = R(pc->a);
+            ++pc;
+            NEXT();
+        CASE(AddInt)
+            R(pc->dst).i = R(pc->a).i + R(pc->b).i;
+            ++pc;
+            NEXT();
+        CASE(SubInt)
+            R(pc->dst).i = R(pc->a).i - R(pc->b).i;
+            ++pc;
+            NEXT();
+        CASE(MulInt)
+            R(pc->dst).i = R(pc->a).i * R(pc->b).i;
+            ++pc;
+            NEXT();
+        CASE(AddFloat)
+            R(pc->dst).d = float(R(pc->a).d + R(pc->b).d);
+            ++pc;
+            NEXT();
+        CASE(SubFloat)
+            R(pc->dst).d = float(R(pc->a).d - R(pc->b).d);
+            ++pc;
+            NEXT();
+        CASE(MulFloat)
+            R(pc->dst).d = float(R(pc->a).d * R(pc->b).d);
+            ++pc;
+            NEXT();
+        CASE(AddDouble)
+            R(pc->dst).d = R(pc->a).d + R(pc->b).d;
+            ++pc;
+            NEXT();
+        CASE(SubDouble)
+            R(pc->dst).d = R(pc->a).d - R(pc->b).d;
+            ++pc;
+            NEXT();
+        CASE(MulDouble)
+            R(pc->dst).d = R(pc->a).d * R(pc->b).d;
+            ++pc;
+            NEXT();
+        CASE(DivSigned)
+            R(pc->dst).i = toSigned(R(pc->a).i, pc->imm.i) / toSigned(R(pc->b).i, pc->imm.i);
+            ++pc;
+            NEXT();
+        CASE(DivUnsigned)
+            R(pc->dst).i = toUnsigned(R(pc->a).i, pc->imm.i) / toUnsigned(R(pc->b).i, pc->imm.i);
+            ++pc;
+            NEXT();
+        CASE(RemSigned)
+            R(pc->dst).i = toSigned(R(pc->a).i, pc->imm.i) % toSigned(R(pc->b).i, pc->imm.i);
+            ++pc;
+            NEXT();
+        CASE(RemUnsigned)
+            R(pc->dst).i = toUnsigned(R(pc->a).i, pc->imm.i) % toUnsigned(R(pc->b).i, pc->imm.i);
+            ++pc;
+            NEXT();
+        CASE(DivFloat)
+            R(pc->dst).d = float(R(pc->a).d / R(pc->b).d);
+            ++pc;
+            NEXT();
+        CASE(DivDouble)
+            R(pc->dst).d = R(pc->a).d / R(pc->b).d;
+            ++pc;
+            NEXT();
+        CASE(RemDouble)
+            R(pc->dst).d = fmod(R(pc->a).d, R(pc->b).d);
+            ++pc;
+            NEXT();
+        CASE(AndInt)
+            R(pc->dst).i = R(pc->a).i & R(pc->b).i;
+            ++pc;
+            NEXT();
+        CASE(OrInt)
+            R(pc->dst).i = R(pc->a).i | R(pc->b).i;
+            ++pc;
+            NEXT();
+        CASE(XorInt)
+            R(pc->dst).i = R(pc->a).i ^ R(pc->b).i;
+            ++pc;
+            NEXT();
+        CASE(ShiftLeft)
+            R(pc->dst).i = R(pc->a).i << (R(pc->b).i & (63 - pc->imm.i));
+            ++pc;
+            NEXT();
+        CASE(ShiftRightSigned)
+            R(pc->dst).i = toSigned(R(pc->a).i, pc->imm.i) >> (R(pc->b).i & (63 - pc->imm.i));
+            ++pc;
+            NEXT();
+        CASE(ShiftRightUnsigned)
+            R(pc->dst).i = toUnsigned(R(pc->a).i, pc->imm.i) >> (R(pc->b).i & (63 - pc->imm.i));
+            ++pc;
+            NEXT();
+        CASE(PopCount)
+            R(pc->dst).i = __builtin_popcountll(R(pc->a).i << pc->imm.i);
+            ++pc;
+            NEXT();
+        CASE(CountLeadingZeros)
+        {
+            quint64 value = toUnsigned(R(pc->a).i, pc->imm.i);
+            R(pc->dst).i = value ? __builtin_clzll(value) - pc->imm.i : 64 - pc->imm.i;
+            ++pc;
+            NEXT();
+        }
+        CASE(CountTrailingZeros)
+        {
+            quint64 value = R(pc->a).i << pc->imm.i;
+            R(pc->dst).i = value ? __builtin_ctzll(value) - pc->imm.i : 64 - pc->imm.i;
+            ++pc;
+            NEXT();
+        }
+        CASE(ByteSwap)
+            R(pc->dst).i = __builtin_bswap64(R(pc->a).i << pc->imm.i);
+            ++pc;
+            NEXT();
+        CASE(SqrtFloat)
+            R(pc->dst).d = sqrtf(float(R(pc->a).d));
+            ++pc;
+            NEXT();
+        CASE(SqrtDouble)
+            R(pc->dst).d = sqrt(R(pc->a).d);
+            ++pc;
+            NEXT();
+        CASE(FmaFloat)
+            R(pc->dst).d = fmaf(float(R(pc->a).d), float(R(pc->b).d), float(R(pc->imm.i).d));
+            ++pc;
+            NEXT();
+        CASE(FmaDouble)
+            R(pc->dst).d = fma(R(pc->a).d, R(pc->b).d, R(pc->imm.i).d);
+            ++pc;
+            NEXT();
+        CASE(EqualInt)
+            R(pc->dst).i = (R(pc->a).i << pc->imm.i) == (R(pc->b).i << pc->imm.i);
+            ++pc;
+            NEXT();
+        CASE(NotEqualInt)
+            R(pc->dst).i = (R(pc->a).i << pc->imm.i) != (R(pc->b).i << pc->imm.i);
+            ++pc;
+            NEXT();
+        CASE(LessThanSigned)
+            R(pc->dst).i = qint64(R(pc->a).i << pc->imm.i) < qint64(R(pc->b).i << pc->imm.i);
+            ++pc;
+            NEXT();
+        CASE(LessThanOrEqualSigned)
+            R(pc->dst).i = qint64(R(pc->a).i << pc->imm.i) <= qint64(R(pc->b).i << pc->imm.i);
+            ++pc;
+            NEXT();
+        CASE(LessThanUnsigned)
+            R(pc->dst).i = (R(pc->a).i << pc->imm.i) < (R(pc->b).i << pc->imm.i);
+            ++pc;
+            NEXT();
+        CASE(LessThanOrEqualUnsigned)
+            R(pc->dst).i = (R(pc->a).i << pc->imm.i) <= (R(pc->b).i << pc->imm.i);
+            ++pc;
+            NEXT();
+        CASE(EqualDouble)
+            R(pc->dst).i = R(pc->a).d == R(pc->b).d;
+            ++pc;
+            NEXT();
+        CASE(NotEqualDouble)
+            R(pc->dst).i = R(pc->a).d < R(pc->b).d || R(pc->a).d > R(pc->b).d;
+            ++pc;
+            NEXT();
+        CASE(LessThanDouble)
+            R(pc->dst).i = R(pc->a).d < R(pc->b).d;
+            ++pc;
+            NEXT();
+        CASE(LessThanOrEqualDouble)
+            R(pc->dst).i = R(pc->a).d <= R(pc->b).d;
+            ++pc;
+            NEXT();
+        CASE(Jump)
+            pc = code + pc->imm.i;
+            NEXT();
+        CASE(JumpIfFalse)
+            pc = R(pc->a).i & 1 ? pc + 1 : code + pc->imm.i;
+            NEXT();
+        CASE(JumpIfTrue)
+            pc = R(pc->a).i & 1 ? code + pc->imm.i : pc + 1;
+            NEXT();
+        CASE(Call)
+        {
+            const Bytecode::Function* callee = &m_program.functions.at(pc->a);
+            Bytecode::Value* calleeRegisters = registers + function->registerCount;
+            if (calleeRegisters + callee->registerCount > stackEnd)
+                return false;
+
+            const int* args = function->arguments.constData() + pc->b;
+            for (int i = 0; i < callee->parameterCount; ++i)
+                calleeRegisters[i] = R(args[i]);
+
+            Frame frame = { function, pc, registers };
+            frames.append(frame);
+            function = callee;
+            registers = calleeRegisters;
+            code = pc = callee->code.constData();
+            NEXT();
+        }
+        CASE(CallExtern)
+        {
+            const Bytecode::Extern& callee = m_program.externs.at(pc->a);
+            const int* args = function->arguments.constData() + pc->b;
+            quint64 a[6];
+            for (int i = 0; i < callee.parameterCount; ++i)
+                a[i] = R(args[i]).i;
+
+            R(pc->dst).i = callExtern(callee, a);
+            ++pc;
+            NEXT();
+        }
+        CASE(Return)
+        {
+            Bytecode::Value value = R(pc->a);
+            if (frames.isEmpty()) {
+                int shift = function->resultShift;
+                *result = function->isSignedResult ? qint64(value.i << shift) >> shift : qint64(value.i << shift >> shift);
+                return true;
+            }
+
+            const Frame& frame = frames.last();
+            function = frame.function;
+            registers = frame.registers;
+            code = function->code.constData();
+            pc = frame.pc;
+            frames.removeLast();
+
+            R(pc->dst) = value;
+            ++pc;
+            NEXT();
+        }
+#ifndef UNV_COMPUTED_GOTO
+        default:
+            assert(false); // should not be reached
+            return false;
+#endif
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef interpreter_h
+#define interpreter_h
+
+#include <QtCore>
+#include "bytecode.h"
+
+class Interpreter {
+public:
+    Interpreter(const Bytecode::Program& program);
+    ~Interpreter();
+
+    /*!
+     * \brief runs a function of the program that takes no arguments until it returns
+     * and stores its result extended from the width of its return type into result
+     * @return false if the call stack overflowed
+     */
+    bool run(int function, qint64* result);
+
+private:
+    const Bytecode::Program& m_program;
+    QVector<Bytecode::Value> m_stack;
+};
+
+#endif // interpreter_h
@@ -0,0 +1,367 @@
+#include "languageserver.h"
+#include "ast.h"
+#include "filesources.h"
+#include "lexer.h"
+#include "parser.h"
+#include "sourcebuffer.h"
+#include "typechecker.h"
+
+#include <stdio.h>
+
+static int indexForPosition(SourceBuffer* buffer, const QJsonObject& position)
+{
+    int line = position.value("line").toInt();
+    int character = position.value("character").toInt();
+
+    // Lines the lexer has not seen, after a fatal error, are found by scanning
+    int known = qMin(line, buffer->newlineCount());
+    TokenPosition pos;
+    pos.line = known + 1;
+    pos.column = 1;
+    int index = buffer->indexForPosition(pos);
+
+    QStringRef text = buffer->text(0, buffer->count());
+    for (int i = known; i < line && index < text.count(); ++i) {
+        int newline = text.indexOf('\n', index);
+        index = newline == -1 ? text.count() : newline + 1;
+    }
+
+    return qMin(index + character, buffer->count());
+}
+
+static QJsonObject range(const Token& tok)
+{
+    QJsonObject start;
+    start.insert("line", tok.start.line - 1);
+    start.insert("character", tok.start.column - 1);
+
+    QJsonObject end;
+    end.insert("line", tok.end.line - 1);
+    end.insert("character", tok.end.column);
+
+    QJsonObject range;
+    range.insert("start", start);
+    range.insert("end", end);
+    return range;
+}
+
+static int tokenIndexAt(SourceBuffer* buffer, int index)
+{
+    // The last token that starts at or before index
+    int low = 0;
+    int high = buffer->tokenCount();
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (buffer->tokenAt(middle).text.position() <= index)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low - 1;
+}
+
+LanguageServer::LanguageServer()
+    : m_shutdown(false)
+{
+    m_in.open(stdin, QIODevice::ReadOnly);
+    m_out.open(stdout, QIODevice::WriteOnly);
+    SourceBuffer::setInteractive(true);
+}
+
+LanguageServer::~LanguageServer()
+{
+    SourceBuffer::setInteractive(false);
+}
+
+int LanguageServer::exec()
+{
+    QJsonObject message;
+    while (read(&message)) {
+        if (message.value("method").toString() == "exit")
+            return m_shutdown ? EXIT_SUCCESS : EXIT_FAILURE;
+        handle(message);
+    }
+    return EXIT_FAILURE;
+}
+
+bool LanguageServer::read(QJsonObject* message)
+{
+    int length = -1;
+    for (;;) {
+        QByteArray line = m_in.readLine();
+        if (line.isEmpty())
+            return false;
+
+        line = line.trimmed();
+        if (line.isEmpty())
+            break;
+
+        if (line.toLower().startsWith("content-length:"))
+            length = line.mid(15).trimmed().toInt();
+    }
+
+    if (length < 0)
+        return false;
+
+    QByteArray content;
+    while (content.count() < length) {
+        QByteArray data = m_in.read(length - content.count());
+        if (data.isEmpty())
+            return false;
+        content.append(data);
+    }
+
+    *message = QJsonDocument::fromJson(content).object();
+    return true;
+}
+
+void LanguageServer::write(const QJsonObject& message)
+{
+    QByteArray content = QJsonDocument(message).toJson(QJsonDocument::Compact);
+    m_out.write("Content-Length: " + QByteArray::number(content.count()) + "\r\n\r\n");
+    m_out.write(content);
+    m_out.flush();
+}
+
+void LanguageServer::respond(const QJsonValue& id, const QJsonValue& result)
+{
+    QJsonObject response;
+    response.insert("jsonrpc", QString("2.0"));
+    response.insert("id", id);
+    response.insert("result", result);
+    write(response);
+}
+
+void LanguageServer::handle(const QJsonObject& message)
+{
+    QString method = message.value("method").toString();
+    QJsonObject params = message.value("params").toObject();
+    QJsonObject document = params.value("textDocument").toObject();
+    QString uri = document.value("uri").toString();
+
+    if (method == "initialize") {
+        QJsonObject capabilities;
+        capabilities.insert("textDocumentSync", 2 /*incremental*/);
+        capabilities.insert("hoverProvider", true);
+        capabilities.insert("definitionProvider", true);
+
+        QJsonObject result;
+        result.insert("capabilities", capabilities);
+        respond(message.value("id"), result);
+    } else if (method == "shutdown") {
+        m_shutdown = true;
+        respond(message.value("id"), QJsonValue());
+    } else if (method == "textDocument/didOpen") {
+        open(uri, document.value("text").toString());
+    } else if (method == "textDocument/didChange") {
+        change(uri, params.value("contentChanges").toArray());
+    } else if (method == "textDocument/didClose") {
+        m_documents.remove(uri);
+    } else if (method == "textDocument/hover") {
+        respond(message.value("id"), hover(uri, params.value("position").toObject()));
+    } else if (method == "textDocument/definition") {
+        respond(message.value("id"), definition(uri, params.value("position").toObject()));
+    } else if (message.contains("id")) {
+        QJsonObject error;
+        error.insert("code", -32601);
+        error.insert("message", "unsupported method " + method);
+
+        QJsonObject response;
+        response.insert("jsonrpc", QString("2.0"));
+        response.insert("id", message.value("id"));
+        response.insert("error", error);
+        write(response);
+    }
+}
+
+void LanguageServer::open(const QString& uri, const QString& text)
+{
+    QSharedPointer<SourceBuffer> buffer(new SourceBuffer(text, QUrl(uri).toLocalFile()));
+    m_documents.insert(uri, buffer);
+
+    try {
+        buffer->reparse();
+    } catch (SourceBuffer::FatalError&) {
+    }
+
+    check(buffer.data(), false /*incremental*/);
+    publishDiagnostics(uri);
+}
+
+void LanguageServer::change(const QString& uri, const QJsonArray& changes)
+{
+    QSharedPointer<SourceBuffer> buffer = m_documents.value(uri);
+    if (!buffer)
+        return;
+
+    // Only the functions whose bodies were edited are checked again unless a
+    // declaration others depend upon changed, when the buffer is parsed and
+    // checked again in full so no stale diagnostic survives
+    bool full = false;
+    foreach (QJsonValue value, changes) {
+        QJsonObject change = value.toObject();
+        int start = 0;
+        int end = buffer->count();
+        if (change.contains("range")) {
+            QJsonObject range = change.value("range").toObject();
+            start = indexForPosition(buffer.data(), range.value("start").toObject());
+            end = qMax(start, indexForPosition(buffer.data(), range.value("end").toObject()));
+        }
+
+        try {
+            if (buffer->applyEdit(start, end - start, change.value("text").toString()) != SourceBuffer::EditedBodies)
+                full = true;
+            else if (!full)
+                check(buffer.data(), true /*incremental*/);
+        } catch (SourceBuffer::FatalError&) {
+            full = true;
+        }
+    }
+
+    if (full) {
+        try {
+            buffer->reparse();
+        } catch (SourceBuffer::FatalError&) {
+        }
+        check(buffer.data(), false /*incremental*/);
+    }
+
+    publishDiagnostics(uri);
+}
+
+void LanguageServer::check(SourceBuffer* buffer, bool incremental)
+{
+    TypeChecker checker(buffer);
+    if (!incremental) {
+        try {
+            checker.check();
+        } catch (SourceBuffer::FatalError&) {
+        }
+        return;
+    }
+
+    // A fatal error in one function leaves the others to be checked
+    foreach (FuncDecl* function, buffer->editedFunctions()) {
+        try {
+            checker.check(*function);
+        } catch (SourceBuffer::FatalError&) {
+        }
+    }
+}
+
+void LanguageServer::publishDiagnostics(const QString& uri)
+{
+    QSharedPointer<SourceBuffer> buffer = m_documents.value(uri);
+    if (!buffer)
+        return;
+
+    QJsonArray diagnostics;
+    foreach (SourceBuffer::Diagnostic diagnostic, buffer->diagnostics()) {
+        QJsonObject object;
+        object.insert("range", range(diagnostic.token));
+        object.insert("severity", 1 /*error*/);
+        object.insert("source", QString("unv"));
+        object.insert("message", diagnostic.message);
+        diagnostics.append(object);
+    }
+
+    QJsonObject params;
+    params.insert("uri", uri);
+    params.insert("diagnostics", diagnostics);
+
+    QJsonObject notification;
+    notification.insert("jsonrpc", QString("2.0"));
+    notification.insert("method", QString("textDocument/publishDiagnostics"));
+    notification.insert("params", params);
+    write(notification);
+}
+
+QJsonValue LanguageServer::hover(const QString& uri, const QJsonObject& position) const
+{
+    QSharedPointer<SourceBuffer> buffer = m_documents.value(uri);
+    if (!buffer)
+        return QJsonValue();
+
+    Token tok;
+    TypeDecl* decl = declarationAt(uri, position, &tok);
+    QString text;
+    if (decl && decl->isFunction()) {
+        FuncDecl* function = static_cast<FuncDecl*>(decl);
+        text = textBetween(function->keyword, function->returnType->type);
+    } else if (decl) {
+        QStringList objects;
+        foreach (QSharedPointer<TypeObject> object, decl->objects)
+            objects.append(object->type.toString());
+        text = "type " + decl->name.toString() + " : " + objects.join(", ");
+        if (TypeInfo* info = buffer->typeSystem().resolveAlias(decl))
+            text += " (" + info->qualifiedTypeName() + ")";
+    } else if (tok.type == Identifier) {
+        TypeInfo* info = buffer->typeSystem().toType(tok.toString());
+        if (!info || !info->isBuiltin())
+            return QJsonValue();
+        text = info->qualifiedTypeName();
+    } else {
+        return QJsonValue();
+    }
+
+    QJsonObject contents;
+    contents.insert("kind", QString("plaintext"));
+    contents.insert("value", text);
+
+    QJsonObject result;
+    result.insert("contents", contents);
+    result.insert("range", range(tok));
+    return result;
+}
+
+QJsonValue LanguageServer::definition(const QString& uri, const QJsonObject& position) const
+{
+    Token tok;
+    TypeDecl* decl = declarationAt(uri, position, &tok);
+    if (!decl)
+        return QJsonValue();
+
+    QString location = uriForToken(decl->name);
+    if (location.isEmpty())
+        return QJsonValue();
+
+    QJsonObject result;
+    result.insert("uri", location);
+    result.insert("range", range(decl->name));
+    return result;
+}
+
+TypeDecl* LanguageServer::declarationAt(const QString& uri, const QJsonObject& position, Token* tok) const
+{
+    QSharedPointer<SourceBuffer> buffer = m_documents.value(uri);
+    if (!buffer)
+        return 0;
+
+    int index = indexForPosition(buffer.data(), position);
+    int i = tokenIndexAt(buffer.data(), index);
+    if (i < 0)
+        return 0;
+
+    *tok = buffer->tokenAt(i);
+    if (tok->type != Identifier || tok->text.position() + tok->text.length() < index)
+        return 0;
+
+    // Type and function names resolve through the resident type system, which
+    // also holds the declarations imported from includes
+    TypeInfo* info = buffer->typeSystem().toType(tok->toString());
+    if (!info || !info->isNode())
+        return 0;
+    return static_cast<TypeDecl*>(info);
+}
+
+QString LanguageServer::uriForToken(const Token& tok) const
+{
+    QHash<QString, QSharedPointer<SourceBuffer> >::const_iterator it = m_documents.begin();
+    for (; it != m_documents.end(); ++it) {
+        if (it.value()->contains(tok))
+            return it.key();
+    }
+
+    QString path = FileSources::instance()->filePath(tok);
+    return path.isEmpty() ? QString() : QUrl::fromLocalFile(path).toString();
+}
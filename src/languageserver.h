@@ -0,0 +1,42 @@
+#ifndef languageserver_h
+#define languageserver_h
+
+#include <QtCore>
+
+class SourceBuffer;
+struct Token;
+struct TypeDecl;
+
+class LanguageServer {
+public:
+    LanguageServer();
+    ~LanguageServer();
+
+    /*!
+     * \brief answers the LSP messages read from stdin until the client exits
+     * @return the exit code
+     */
+    int exec();
+
+private:
+    bool read(QJsonObject* message);
+    void write(const QJsonObject& message);
+    void respond(const QJsonValue& id, const QJsonValue& result);
+    void handle(const QJsonObject& message);
+    void open(const QString& uri, const QString& text);
+    void change(const QString& uri, const QJsonArray& changes);
+    void check(SourceBuffer* buffer, bool incremental);
+    void publishDiagnostics(const QString& uri);
+    QJsonValue hover(const QString& uri, const QJsonObject& position) const;
+    QJsonValue definition(const QString& uri, const QJsonObject& position) const;
+    TypeDecl* declarationAt(const QString& uri, const QJsonObject& position, Token* tok) const;
+    QString uriForToken(const Token& tok) const;
+
+private:
+    QFile m_in;
+    QFile m_out;
+    QHash<QString, QSharedPointer<SourceBuffer> > m_documents;
+    bool m_shutdown;
+};
+
+#endif // languageserver_h
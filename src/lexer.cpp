@@ -12,12 +12,17 @@ Lexer::~Lexer()
 }
 
 void Lexer::lex(SourceBuffer* source)
+{
+    lex(source, 0, source->count());
+}
+
+void Lexer::lex(SourceBuffer* source, int start, int end)
 {
     m_source = source;
-    m_index = -1;
+    m_index = start - 1;
     m_column = 0;
 
-    while (m_index < m_source->count() - 1) {
+    while (m_index < end - 1) {
         const QChar ch = advance(1);
         TokenPosition pos = tokenPosition();
         switch (ch.unicode()) {
@@ -31,9 +36,9 @@ void Lexer::lex(SourceBuffer* source)
 //        case '@': appendToken(At, pos, pos); break;
 //        case '#': appendToken(Hash, pos, pos); break;
 //        case '$': appendToken(Dollar, pos, pos); break;
-//        case '%': appendToken(Percent, pos, pos); break;
-//        case '^': appendToken(Cap, pos, pos); break;
-//        case '&': appendToken(Ampersand, pos, pos); break;
+        case '%': appendToken(Percent, pos, pos); break;
+        case '^': appendToken(Cap, pos, pos); break;
+        case '&': appendToken(Ampersand, pos, pos); break;
         case '*': appendToken(Star, pos, pos); break;
         case '(': appendToken(OpenParenthesis, pos, pos); break;
         case ')': appendToken(CloseParenthesis, pos, pos); break;
@@ -41,7 +46,7 @@ void Lexer::lex(SourceBuffer* source)
         case '+': appendToken(Plus, pos, pos); break;
 //        case '{': appendToken(OpenCurly, pos, pos); break;
 //        case '}': appendToken(ClosedCurly, pos, pos); break;
-//        case '|': appendToken(Pipe, pos, pos); break;
+        case '|': appendToken(Pipe, pos, pos); break;
         case ':': appendToken(Colon, pos, pos); break;
         case '"':
             if (consumeStringLiteral()) {
@@ -50,7 +55,7 @@ void Lexer::lex(SourceBuffer* source)
             }
         case '<': appendToken(LessThan, pos, pos); break;
         case '>': appendToken(GreaterThan, pos, pos); break;
-//        case '?': appendToken(QuestionMark, pos, pos); break;
+        case '?': appendToken(QuestionMark, pos, pos); break;
         case '-':
             if (isNumericLiteral())
                 handleNumericLiteral();
@@ -81,6 +86,14 @@ void Lexer::lex(SourceBuffer* source)
         /*
          * keywords: in alphabetical order
          */
+        case 'c':
+            if (consumeString("ase")) {
+                appendToken(Case, pos, tokenPosition());
+                break;
+            } else if (consumeIdentifier()) {
+                appendToken(Identifier, pos, tokenPosition());
+                break;
+            }
         case 'e':
             if (consumeString("lse")) {
                 appendToken(Else, pos, tokenPosition());
@@ -96,6 +109,9 @@ void Lexer::lex(SourceBuffer* source)
             if (consumeString("alse")) {
                 appendToken(False, pos, tokenPosition());
                 break;
+            } else if (consumeString("or")) {
+                appendToken(For, pos, tokenPosition());
+                break;
             } else if (consumeString("unction")) {
                 appendToken(Function, pos, tokenPosition());
                 break;
@@ -114,6 +130,14 @@ void Lexer::lex(SourceBuffer* source)
                 appendToken(Identifier, pos, tokenPosition());
                 break;
             }
+        case 'm':
+            if (consumeString("atch")) {
+                appendToken(Match, pos, tokenPosition());
+                break;
+            } else if (consumeIdentifier()) {
+                appendToken(Identifier, pos, tokenPosition());
+                break;
+            }
         case 'n':
             if (consumeString("ew")) {
                 appendToken(New, pos, tokenPosition());
@@ -144,12 +168,20 @@ void Lexer::lex(SourceBuffer* source)
                 appendToken(Identifier, pos, tokenPosition());
                 break;
             }
+        case 'w':
+            if (consumeString("hile")) {
+                appendToken(While, pos, tokenPosition());
+                break;
+            } else if (consumeIdentifier()) {
+                appendToken(Identifier, pos, tokenPosition());
+                break;
+            }
         /* identifier */
         case '_':
-        case 'a': case 'b': case 'c': case 'd': /*case 'e':*/ /*case 'f':*/
+        case 'a': case 'b': /*case 'c':*/ case 'd': /*case 'e':*/ /*case 'f':*/
         case 'g': case 'h': /*case 'i':*/ case 'j': case 'k': case 'l':
-        case 'm': /*case 'n':*/ case 'o': case 'p': case 'q': /*case 'r':*/
-        case 's': /*case 't':*/ case 'u': case 'v': case 'w': case 'x':
+        /*case 'm':*/ /*case 'n':*/ case 'o': case 'p': case 'q': /*case 'r':*/
+        case 's': /*case 't':*/ case 'u': case 'v': /*case 'w':*/ case 'x':
         case 'y': case 'z':
         case 'A': case 'B': case 'C': case 'D': case 'E': case 'F':
         case 'G': case 'H': case 'I': case 'J': case 'K': case 'L':
@@ -219,6 +251,11 @@ TokenPosition Lexer::consumeChar()
 
 bool Lexer::consumeString(const QString& string)
 {
+    // A keyword is only one when it is not the start of a longer identifier
+    QStringRef next = m_source->text(m_index + 1 + string.length(), 1);
+    if (!next.isEmpty() && (next.at(0).isLetterOrNumber() || next.at(0) == '_'))
+        return false;
+
     if (m_source->text(m_index + 1, string.length()) == string) {
         advance(string.length());
         return true;
@@ -12,6 +12,12 @@ public:
 
     void lex(SourceBuffer* source);
 
+    /*!
+     * \brief appends the tokens of the characters [start, end) of source where start is the
+     * beginning of the line after the last newline source knows about
+     */
+    void lex(SourceBuffer* source, int start, int end);
+
 private:
     void newline();
     QChar advance(int i);
@@ -1,15 +1,49 @@
 #include <QtCore>
 
+#include "bytecode.h"
 #include "codegen.h"
+#include "filesources.h"
+#include "interpreter.h"
+#include "languageserver.h"
 #include "lexer.h"
 #include "output.h"
 #include "parser.h"
+#include "repl.h"
+#include "typechecker.h"
 
 static bool s_error = false;
+static int s_result = EXIT_SUCCESS;
+
+static void interpret(SourceBuffer* buffer)
+{
+    Bytecode bytecode(buffer);
+    bytecode.compile();
+    if (buffer->hasErrors())
+        return;
+
+    QTextStream err(stderr);
+    int entry = bytecode.functionIndex("main");
+    if (entry == -1) {
+        err << buffer->name() << ": no main function to interpret\n";
+        s_error = true;
+        return;
+    }
+
+    qint64 result = 0;
+    Interpreter interpreter(bytecode.program());
+    if (!interpreter.run(entry, &result)) {
+        err << buffer->name() << ": call stack overflow\n";
+        s_error = true;
+        return;
+    }
+
+    s_result = int(result);
+}
 
 void compile(const QString& source, const QString& name)
 {
     SourceBuffer buffer(source, name);
+    FileSources::instance()->resetDependencies();
 
     Lexer lexer;
     lexer.lex(&buffer);
@@ -17,11 +51,28 @@ void compile(const QString& source, const QString& name)
     Parser parser;
     parser.parse(&buffer);
 
-    CodeGen codegen(&buffer);
-    QString llvmIR = codegen.generateLLVMIR();
+    // Only run the phases the requested outputs need, where the checker is the
+    // one place a program is rejected before anything is generated from it
+    QStringList types = Options::instance()->outputTypes();
+    bool generate = types.contains("llvm") || types.contains("obj");
+    if (Options::instance()->syntaxOnly() || Options::instance()->interpret() || generate) {
+        TypeChecker checker(&buffer);
+        checker.check();
+    }
+
+    if (Options::instance()->syntaxOnly() || Options::instance()->interpret()) {
+        if (Options::instance()->interpret() && !buffer.hasErrors())
+            interpret(&buffer);
+    } else if (!buffer.hasErrors()) {
+        QScopedPointer<CodeGen> codegen;
+        if (generate) {
+            codegen.reset(new CodeGen(&buffer));
+            codegen->generate();
+        }
 
-    Output output(&buffer);
-    output.write(llvmIR);
+        Output output(&buffer);
+        output.write(codegen.data());
+    }
 
     s_error = buffer.hasErrors() ? true : s_error;
 }
@@ -34,6 +85,16 @@ int main(int argc, char** argv)
 
     Options::instance()->parseCommandLine();
 
+    if (Options::instance()->languageServer()) {
+        LanguageServer server;
+        return server.exec();
+    }
+
+    if (Options::instance()->repl()) {
+        Repl repl;
+        return repl.exec();
+    }
+
     QStringList args = Options::instance()->files();
 
     foreach (QString f, args) {
@@ -50,5 +111,5 @@ int main(int argc, char** argv)
         compile(in.readAll(), "stdin");
     }
 
-    return s_error ? EXIT_FAILURE : EXIT_SUCCESS;
+    return s_error ? EXIT_FAILURE : s_result;
 }
@@ -0,0 +1,265 @@
+#include "objectcache.h"
+#include "ast.h"
+#include "options.h"
+#include "target.h"
+#include "typesystem.h"
+#include "visitor.h"
+
+// The most functions lowered together into one cached object. Smaller fragments
+// make rebuilds after an edit cheaper at the cost of more llc processes when the
+// cache is cold.
+static const int s_fragmentSize = 32;
+
+struct ReferenceCollector : public Visitor {
+    virtual void begin(Node&) {}
+    virtual void end(Node&) {}
+    virtual void visit(ForStmt& node) { types.insert(node.type.toString()); }
+    virtual void visit(FuncCallExpr& node) { callees.insert(node.callee.toString()); }
+    virtual void visit(TypeCtorExpr& node) { types.insert(node.type.toString()); }
+    virtual void visit(TypeObject& node) { types.insert(node.type.toString()); }
+    virtual void visit(VarDeclStmt& node) { types.insert(node.type.toString()); }
+
+    QSet<QString> callees;
+    QSet<QString> types;
+};
+
+static QString typeDescription(const QString& name, const TypeSystem& typeSystem)
+{
+    TypeInfo* info = typeSystem.resolveAlias(typeSystem.toType(name));
+    if (!info)
+        return name + "=?";
+
+    QString description = name + "=" + info->qualifiedTypeName();
+    if (info->isStructure()) {
+        foreach (TypeRef* ref, info->typeRefList())
+            description += " " + ref->typeName().toString();
+    }
+    return description;
+}
+
+static QStringList sorted(const QSet<QString>& set)
+{
+    QStringList list = set.toList();
+    list.sort();
+    return list;
+}
+
+// Entries are written under a temporary name and renamed so a build that is
+// interrupted, or runs alongside another, never leaves a partial entry behind
+static bool replaceFile(const QString& temporary, const QString& file)
+{
+    QFile::remove(file);
+    if (QFile::rename(temporary, file))
+        return true;
+
+    QFile::remove(temporary);
+    return false;
+}
+
+ObjectCache::ObjectCache(const QString& directory, const QString& output)
+    : m_directory(directory)
+{
+    m_directory.mkpath(".");
+    m_output = QCryptographicHash::hash(QFileInfo(output).absoluteFilePath().toUtf8(),
+                                        QCryptographicHash::Sha1).toHex();
+}
+
+ObjectCache::~ObjectCache()
+{
+}
+
+QByteArray ObjectCache::functionKey(FuncDecl* node, const TypeSystem& typeSystem)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QCoreApplication::applicationVersion().toUtf8());
+    hash.addData(QByteArray::number(Options::instance()->optimizationLevel()));
+    hash.addData(QByteArray::number(Options::instance()->memoizeSize()));
+    hash.addData(QByteArray::number(Options::instance()->fastMath()));
+    hash.addData(QByteArray::number(Options::instance()->overflow()));
+    hash.addData(Target::instance()->cpu().toUtf8());
+    hash.addData(Target::instance()->features().toUtf8());
+
+    foreach (Token attribute, node->attributes)
+        hash.addData(attribute.toString().toUtf8());
+    hash.addData(textBetween(node->keyword, node->end).toUtf8());
+
+    ReferenceCollector references;
+    references.walk(*node);
+
+    // The object code of a function depends upon the signatures of its callees,
+    // never upon their bodies, since functions are optimized separately
+    foreach (QString callee, sorted(references.callees)) {
+        TypeInfo* info = typeSystem.toType(callee);
+        if (!info || !info->isFunction())
+            continue;
+
+        FuncDecl* decl = static_cast<FuncDecl*>(info);
+        foreach (Token attribute, decl->attributes)
+            hash.addData(attribute.toString().toUtf8());
+        hash.addData(textBetween(decl->keyword, decl->returnType->type).toUtf8());
+        foreach (QSharedPointer<TypeObject> object, decl->objects)
+            references.types.insert(object->type.toString());
+        references.types.insert(decl->returnType->type.toString());
+    }
+
+    foreach (QString type, sorted(references.types))
+        hash.addData(typeDescription(type, typeSystem).toUtf8());
+
+    return hash.result().toHex();
+}
+
+QList<ObjectCache::Fragment> ObjectCache::fragments(const FunctionKeys& functions) const
+{
+    QHash<QString, QByteArray> keyForFunction;
+    for (int i = 0; i < functions.count(); ++i)
+        keyForFunction.insert(functions.at(i).first, functions.at(i).second);
+
+    // A fragment of the last build is reused when every function it defines is
+    // unchanged and not already defined by an earlier fragment
+    QList<Fragment> fragments;
+    QSet<QString> defined;
+    foreach (QByteArray key, manifest()) {
+        Fragment fragment;
+        fragment.key = key;
+        fragment.functions = readFunctions(key);
+        if (fragment.functions.isEmpty() || !contains(fragment))
+            continue;
+
+        bool unchanged = true;
+        for (int i = 0; i < fragment.functions.count() && unchanged; ++i) {
+            QPair<QString, QByteArray> function = fragment.functions.at(i);
+            unchanged = keyForFunction.value(function.first) == function.second && !defined.contains(function.first);
+        }
+
+        if (!unchanged)
+            continue;
+
+        for (int i = 0; i < fragment.functions.count(); ++i)
+            defined.insert(fragment.functions.at(i).first);
+        fragments.append(fragment);
+    }
+
+    // The rest are grouped in module order into new fragments
+    Fragment fragment;
+    for (int i = 0; i <= functions.count(); ++i) {
+        if (i == functions.count() || fragment.functions.count() == s_fragmentSize) {
+            if (fragment.functions.isEmpty())
+                continue;
+
+            QCryptographicHash hash(QCryptographicHash::Sha1);
+            for (int j = 0; j < fragment.functions.count(); ++j) {
+                hash.addData(fragment.functions.at(j).first.toUtf8());
+                hash.addData(fragment.functions.at(j).second);
+            }
+            fragment.key = hash.result().toHex();
+            fragments.append(fragment);
+            fragment = Fragment();
+        }
+
+        if (i < functions.count() && !defined.contains(functions.at(i).first))
+            fragment.functions.append(functions.at(i));
+    }
+
+    return fragments;
+}
+
+bool ObjectCache::contains(const Fragment& fragment) const
+{
+    return QFileInfo(objectFile(fragment)).exists() && QFileInfo(path(fragment.key, ".functions")).exists();
+}
+
+QString ObjectCache::objectFile(const Fragment& fragment) const
+{
+    return path(fragment.key, ".o");
+}
+
+bool ObjectCache::insert(const Fragment& fragment, const QString& object)
+{
+    // The object is complete before its functions are, which contains checks last
+    QString temporary = objectFile(fragment) + ".tmp";
+    QFile::remove(temporary);
+    if (!QFile::copy(object, temporary) || !replaceFile(temporary, objectFile(fragment)))
+        return false;
+
+    QString functions = path(fragment.key, ".functions");
+    QFile f(functions + ".tmp");
+    if (!f.open(QIODevice::WriteOnly))
+        return false;
+
+    QTextStream out(&f);
+    for (int i = 0; i < fragment.functions.count(); ++i)
+        out << fragment.functions.at(i).first << ' ' << fragment.functions.at(i).second << '\n';
+    out.flush();
+    f.close();
+
+    return replaceFile(f.fileName(), functions);
+}
+
+void ObjectCache::setFragments(const QList<Fragment>& fragments)
+{
+    QList<QByteArray> unused = manifest();
+
+    QFile f(path(m_output, ".manifest.tmp"));
+    if (!f.open(QIODevice::WriteOnly))
+        return;
+
+    foreach (Fragment fragment, fragments)
+        f.write(fragment.key + '\n');
+    f.close();
+    if (!replaceFile(f.fileName(), path(m_output, ".manifest")))
+        return;
+
+    // Outputs with the same functions share fragments, so a fragment is only
+    // removed once no manifest of any output lists it
+    QSet<QByteArray> used;
+    foreach (QString name, m_directory.entryList(QStringList() << "*.manifest", QDir::Files)) {
+        foreach (QByteArray key, readManifest(m_directory.filePath(name)))
+            used.insert(key);
+    }
+
+    foreach (QByteArray key, unused) {
+        if (used.contains(key))
+            continue;
+        QFile::remove(path(key, ".o"));
+        QFile::remove(path(key, ".functions"));
+    }
+}
+
+QString ObjectCache::path(const QByteArray& key, const QString& suffix) const
+{
+    return m_directory.filePath(QString::fromLatin1(key) + suffix);
+}
+
+QList<QByteArray> ObjectCache::manifest() const
+{
+    return readManifest(path(m_output, ".manifest"));
+}
+
+QList<QByteArray> ObjectCache::readManifest(const QString& file)
+{
+    QList<QByteArray> keys;
+    QFile f(file);
+    if (!f.open(QIODevice::ReadOnly))
+        return keys;
+
+    foreach (QByteArray line, f.readAll().split('\n')) {
+        if (!line.isEmpty())
+            keys.append(line);
+    }
+    return keys;
+}
+
+FunctionKeys ObjectCache::readFunctions(const QByteArray& key) const
+{
+    FunctionKeys functions;
+    QFile f(path(key, ".functions"));
+    if (!f.open(QIODevice::ReadOnly))
+        return functions;
+
+    foreach (QByteArray line, f.readAll().split('\n')) {
+        QList<QByteArray> fields = line.split(' ');
+        if (fields.count() == 2)
+            functions.append(qMakePair(QString::fromUtf8(fields.at(0)), fields.at(1)));
+    }
+    return functions;
+}
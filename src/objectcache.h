@@ -0,0 +1,61 @@
+#ifndef objectcache_h
+#define objectcache_h
+
+#include <QtCore>
+
+struct FuncDecl;
+class TypeSystem;
+
+typedef QList<QPair<QString, QByteArray> > FunctionKeys;
+
+class ObjectCache {
+public:
+    struct Fragment {
+        QByteArray key;
+        FunctionKeys functions;
+    };
+
+    ObjectCache(const QString& directory, const QString& output);
+    ~ObjectCache();
+
+    /*!
+     * \brief hashes the source of the function together with the signatures and types it
+     * references and the options that affect its object code
+     * @return a key that changes whenever the object code of the function could change
+     */
+    static QByteArray functionKey(FuncDecl* node, const TypeSystem& typeSystem);
+
+    /*!
+     * \brief groups the functions into fragments reusing every fragment of the last build of
+     * the output whose functions are all unchanged
+     * @return the fragments that together define the functions in link order
+     */
+    QList<Fragment> fragments(const FunctionKeys& functions) const;
+
+    bool contains(const Fragment& fragment) const;
+    QString objectFile(const Fragment& fragment) const;
+
+    /*!
+     * \brief moves the object code of the fragment into the cache
+     * @return false if the object could not be stored
+     */
+    bool insert(const Fragment& fragment, const QString& object);
+
+    /*!
+     * \brief records the fragments of this build of the output and removes the fragments
+     * of the last build that neither it nor any other output in the cache still uses
+     */
+    void setFragments(const QList<Fragment>& fragments);
+
+private:
+    QString path(const QByteArray& key, const QString& suffix) const;
+    QList<QByteArray> manifest() const;
+    static QList<QByteArray> readManifest(const QString& file);
+    FunctionKeys readFunctions(const QByteArray& key) const;
+
+private:
+    QDir m_directory;
+    QByteArray m_output;
+};
+
+#endif // objectcache_h
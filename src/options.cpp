@@ -1,5 +1,13 @@
 #include "options.h"
 
+static void error(const QString& err)
+{
+    QTextStream out(stderr);
+    out << err << '\n';
+    out.flush();
+    exit(EXIT_FAILURE);
+}
+
 Options* Options::instance()
 {
     static Options* _instance = 0;
@@ -10,7 +18,19 @@ Options* Options::instance()
 
 Options::Options()
     : m_errorLimit(20)
+    , m_optimizationLevel(-1)
+    , m_jobs(1)
     , m_readFromStdin(false)
+    , m_syntaxOnly(false)
+    , m_writeDependencies(false)
+    , m_languageServer(false)
+    , m_interpret(false)
+    , m_repl(false)
+    , m_constexprSteps(1048576)
+    , m_constexprDepth(512)
+    , m_memoizeSize(4096)
+    , m_fastMath(false)
+    , m_overflow(OverflowUndefined)
 {
 }
 
@@ -33,27 +53,152 @@ void Options::parseCommandLine()
     parser.addOption(errorLimit);
 
     QCommandLineOption outputFile(QStringList() << "o" << "out",
-                                  "Output to file or stdout if empty.", "file", "");
+                                  "Output to file or stdout if empty when emitting a single type.", "file", "");
     parser.addOption(outputFile);
 
     QCommandLineOption outputType(QStringList() << "e" << "emit",
-                                  "Specify the type of output. [Default: obj]\n   type=obj|llvm|ast", "type", "obj");
+                                  "Specify a comma separated list of output types, each with an optional\n"
+                                  "   file as type=file. [Default: obj]\n   type=obj|llvm|ast", "types", "obj");
     parser.addOption(outputType);
 
     QCommandLineOption readFromStdin("stdin", "Read from stdin.");
     parser.addOption(readFromStdin);
 
+    QCommandLineOption syntaxOnly("fsyntax-only", "Check for errors without generating any output.");
+    parser.addOption(syntaxOnly);
+
+    QList<QCommandLineOption> optimizationLevels;
+    optimizationLevels.append(QCommandLineOption("O0", "Disable optimizations."));
+    optimizationLevels.append(QCommandLineOption("O1", "Optimize."));
+    optimizationLevels.append(QCommandLineOption("O2", "Optimize more."));
+    optimizationLevels.append(QCommandLineOption("O3", "Optimize even more."));
+    foreach (QCommandLineOption level, optimizationLevels)
+        parser.addOption(level);
+
+    QCommandLineOption jobs(QStringList() << "j" << "jobs",
+                            "Generate object code from N module partitions in parallel. [Default: 1]", "N", "1");
+    parser.addOption(jobs);
+
+    QCommandLineOption writeDependencies("MD", "Write a Makefile rule listing the files the outputs depend upon.");
+    parser.addOption(writeDependencies);
+
+    QCommandLineOption dependencyFile("MF", "Write the dependency rule to file. [Default: output with .d suffix]",
+                                      "file", "");
+    parser.addOption(dependencyFile);
+
+    QCommandLineOption cacheDir("cache-dir",
+                                "Keep the object code of each function in dir and only regenerate the\n"
+                                "   functions that changed. Functions are optimized separately.", "dir", "");
+    parser.addOption(cacheDir);
+
+    QCommandLineOption languageServer("lsp", "Run as a language server speaking LSP over stdin and stdout.");
+    parser.addOption(languageServer);
+
+    QCommandLineOption interpret("interpret", "Run main with the bytecode interpreter and exit with its result\n"
+                                 "   instead of writing any output.");
+    parser.addOption(interpret);
+
+    QCommandLineOption repl("repl", "Read declarations and expressions interactively, printing the value of\n"
+                            "   each expression as it is compiled by the JIT.");
+    parser.addOption(repl);
+
+    QCommandLineOption constexprSteps("fconstexpr-steps",
+                                      "Stop evaluating a call at compile time after N expressions and\n"
+                                      "   statements, and no longer evaluate calls of the function.\n"
+                                      "   [Default: 1048576]", "N", "1048576");
+    parser.addOption(constexprSteps);
+
+    QCommandLineOption constexprDepth("fconstexpr-depth",
+                                      "Stop evaluating a call at compile time below N nested calls.\n"
+                                      "   [Default: 512]", "N", "512");
+    parser.addOption(constexprDepth);
+
+    QCommandLineOption memoizeSize("memoize-size",
+                                   "Keep at most N results of each memoized function, rounded up to a power\n"
+                                   "   of two. A result evicts an older one when its slots are taken.\n"
+                                   "   [Default: 4096]", "N", "4096");
+    parser.addOption(memoizeSize);
+
+    QCommandLineOption fastMath("fast-math", "Let floating point arithmetic be reassociated, use reciprocals and\n"
+                                "   contract into fused multiply adds, assuming no NaNs or infinities.");
+    parser.addOption(fastMath);
+
+    QCommandLineOption overflow("overflow",
+                                "What signed integer arithmetic does when it overflows: let the optimizer\n"
+                                "   assume it never does, wrap around or trap. Unsigned arithmetic always\n"
+                                "   wraps unless it traps. Trapping also traps on division by zero and on\n"
+                                "   dividing the most negative value by -1. [Default: undefined]\n"
+                                "   mode=undefined|wrap|trap",
+                                "mode", "undefined");
+    parser.addOption(overflow);
+
+    QCommandLineOption march("march", "Generate code for processor, or the processor and features of the\n"
+                             "   host if native, as with gcc.", "cpu", "");
+    parser.addOption(march);
+
+    QCommandLineOption mcpu("mcpu", "Generate code for processor or the host processor if native, as with\n"
+                            "   llc. Overrides -march.", "cpu", "");
+    parser.addOption(mcpu);
+
+    QCommandLineOption mattr("mattr", "Enable +feature or disable -feature of the processor, given as a\n"
+                             "   comma separated list as with llc.", "features", "");
+    parser.addOption(mattr);
+
     parser.process(*QCoreApplication::instance());
 
     m_files = parser.positionalArguments();
     m_includeDirs = parser.values(include);
     m_errorLimit = parser.value(errorLimit).toInt();
-    m_outputFile = parser.value(outputFile);
-    m_outputType = parser.value(outputType);
-    if (m_outputType != "obj" && m_outputType != "llvm" && m_outputType != "ast")
-        m_outputType = "obj";
+    foreach (QString value, parser.values(outputType)) {
+        foreach (QString emit, value.split(',', QString::SkipEmptyParts)) {
+            QString type = emit.section('=', 0, 0);
+            QString file = emit.section('=', 1);
+            if (type != "obj" && type != "llvm" && type != "ast")
+                continue;
+            if (!m_outputTypes.contains(type))
+                m_outputTypes.append(type);
+            if (!file.isEmpty())
+                m_outputFiles.insert(type, file);
+        }
+    }
+    if (m_outputTypes.isEmpty())
+        m_outputTypes.append("obj");
+    if (m_outputTypes.count() == 1 && !m_outputFiles.contains(m_outputTypes.first()))
+        m_outputFiles.insert(m_outputTypes.first(), parser.value(outputFile));
     m_readFromStdin = parser.isSet(readFromStdin);
+    m_syntaxOnly = parser.isSet(syntaxOnly);
+    for (int i = 0; i < optimizationLevels.count(); ++i) {
+        if (parser.isSet(optimizationLevels.at(i)))
+            m_optimizationLevel = i;
+    }
+    m_jobs = qMax(1, parser.value(jobs).toInt());
+    m_dependencyFile = parser.value(dependencyFile);
+    m_writeDependencies = parser.isSet(writeDependencies) || !m_dependencyFile.isEmpty();
+    m_cacheDir = parser.value(cacheDir);
+    m_languageServer = parser.isSet(languageServer);
+    m_interpret = parser.isSet(interpret);
+    m_repl = parser.isSet(repl);
+    m_constexprSteps = qMax(0, parser.value(constexprSteps).toInt());
+    m_constexprDepth = qMax(0, parser.value(constexprDepth).toInt());
+    m_fastMath = parser.isSet(fastMath);
+    if (parser.value(overflow) == "wrap")
+        m_overflow = OverflowWrap;
+    else if (parser.value(overflow) == "trap")
+        m_overflow = OverflowTrap;
+    else if (parser.value(overflow) != "undefined")
+        error(QString("unknown overflow mode %1").arg(parser.value(overflow)));
+    m_cpu = parser.isSet(mcpu) ? parser.value(mcpu) : parser.value(march);
+    foreach (QString value, parser.values(mattr)) {
+        foreach (QString feature, value.split(',', QString::SkipEmptyParts)) {
+            if (!feature.startsWith('+') && !feature.startsWith('-'))
+                feature.prepend('+');
+            m_features.append(feature);
+        }
+    }
+    m_memoizeSize = 16;
+    while (m_memoizeSize < parser.value(memoizeSize).toInt() && m_memoizeSize < (1 << 30))
+        m_memoizeSize <<= 1;
 
-    if (m_files.isEmpty() && !m_readFromStdin)
+    if (m_files.isEmpty() && !m_readFromStdin && !m_languageServer && !m_repl)
         parser.showHelp();
 }
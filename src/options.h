@@ -5,6 +5,12 @@
 
 class Options {
 public:
+    enum Overflow {
+        OverflowUndefined,
+        OverflowWrap,
+        OverflowTrap
+    };
+
     static Options* instance();
 
     void parseCommandLine();
@@ -12,9 +18,25 @@ public:
     QStringList files() const { return m_files; }
     QStringList includeDirs() const { return m_includeDirs; }
     int errorLimit() const { return m_errorLimit; }
-    QString outputFile() const { return m_outputFile; }
-    QString outputType() const { return m_outputType; }
+    QStringList outputTypes() const { return m_outputTypes; }
+    QString outputFile(const QString& type) const { return m_outputFiles.value(type); }
+    int optimizationLevel() const { return m_optimizationLevel; }
+    int jobs() const { return m_jobs; }
     bool readFromStdin() const { return m_readFromStdin; }
+    bool syntaxOnly() const { return m_syntaxOnly; }
+    bool writeDependencies() const { return m_writeDependencies; }
+    QString dependencyFile() const { return m_dependencyFile; }
+    QString cacheDir() const { return m_cacheDir; }
+    bool languageServer() const { return m_languageServer; }
+    bool interpret() const { return m_interpret; }
+    bool repl() const { return m_repl; }
+    int constexprSteps() const { return m_constexprSteps; }
+    int constexprDepth() const { return m_constexprDepth; }
+    int memoizeSize() const { return m_memoizeSize; }
+    bool fastMath() const { return m_fastMath; }
+    Overflow overflow() const { return m_overflow; }
+    QString cpu() const { return m_cpu; }
+    QStringList features() const { return m_features; }
 
 private:
     Options();
@@ -23,9 +45,25 @@ private:
     QStringList m_files;
     QStringList m_includeDirs;
     int m_errorLimit;
-    QString m_outputFile;
-    QString m_outputType;
+    QStringList m_outputTypes;
+    QHash<QString, QString> m_outputFiles;
+    int m_optimizationLevel;
+    int m_jobs;
     bool m_readFromStdin;
+    bool m_syntaxOnly;
+    bool m_writeDependencies;
+    QString m_dependencyFile;
+    QString m_cacheDir;
+    bool m_languageServer;
+    bool m_interpret;
+    bool m_repl;
+    int m_constexprSteps;
+    int m_constexprDepth;
+    int m_memoizeSize;
+    bool m_fastMath;
+    Overflow m_overflow;
+    QString m_cpu;
+    QStringList m_features;
 };
 
 #endif // options_h
@@ -1,7 +1,11 @@
 #include "output.h"
 #include "astprinter.h"
+#include "codegen.h"
+#include "filesources.h"
+#include "objectcache.h"
 #include "options.h"
 #include "sourcebuffer.h"
+#include "target.h"
 
 static void error(const QString& err)
 {
@@ -11,84 +15,286 @@ static void error(const QString& err)
     exit(EXIT_FAILURE);
 }
 
+static QString escapeMakePath(QString path)
+{
+    path.replace('$', "$$");
+    path.replace('#', "\\#");
+    path.replace(' ', "\\ ");
+    return path;
+}
+
+static QStringList llcArguments()
+{
+    QStringList arguments;
+    arguments << "-filetype=obj";
+    int level = Options::instance()->optimizationLevel();
+    if (level >= 0)
+        arguments << "-O" + QString::number(level);
+
+    // Contraction is only a target option so functions with a fastmath attribute
+    // do not get it on their own
+    if (Options::instance()->fastMath())
+        arguments << "-fp-contract=fast";
+
+    if (!Target::instance()->cpu().isEmpty())
+        arguments << "-mcpu=" + Target::instance()->cpu();
+    if (!Target::instance()->features().isEmpty())
+        arguments << "-mattr=" + Target::instance()->features();
+    return arguments;
+}
+
+static void run(const QString& program, const QStringList& arguments)
+{
+    QProcess process;
+    process.setProgram(program);
+    process.setArguments(arguments);
+    process.start();
+    if (!process.waitForStarted())
+        error(QString("could not start %1 tool").arg(program));
+
+    if (!process.waitForFinished(-1) || process.exitStatus() != QProcess::NormalExit)
+        error(QString("%1 tool crashed").arg(program));
+
+    if (process.exitCode() != 0)
+        error(QString("%1 tool exited with error").arg(program));
+}
+
+static void runConcurrently(const QString& program, const QList<QStringList>& argumentLists, int jobs)
+{
+    // At most jobs processes run at a time. Each writes to its own file, so the
+    // result does not depend upon which process finishes first. Diagnostics such
+    // as warnings are passed on and only the exit code tells a failure.
+    QList<QSharedPointer<QProcess> > running;
+    for (int i = 0; i < argumentLists.count() || !running.isEmpty();) {
+        if (i < argumentLists.count() && running.count() < jobs) {
+            QSharedPointer<QProcess> process(new QProcess);
+            process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+            process->setProgram(program);
+            process->setArguments(argumentLists.at(i++));
+            process->start();
+            if (!process->waitForStarted())
+                error(QString("could not start %1 tool").arg(program));
+            running.append(process);
+            continue;
+        }
+
+        QSharedPointer<QProcess> process = running.takeFirst();
+        if (!process->waitForFinished(-1) || process->exitStatus() != QProcess::NormalExit)
+            error(QString("%1 tool crashed").arg(program));
+
+        if (process->exitCode() != 0)
+            error(QString("%1 tool exited with error").arg(program));
+    }
+}
+
 Output::Output(SourceBuffer* source)
     : m_source(source)
 {
 }
 
-void Output::write(const QString& llvmIR)
+void Output::write(CodeGen* codegen)
 {
-    QString file = Options::instance()->outputFile();
-    QString type = Options::instance()->outputType();
-    if (type == "ast") {
-        QTextStream out(stdout);
-        QFile f(file);
-        if (!file.isEmpty()) {
-            if (f.open(QIODevice::WriteOnly))
-                out.setDevice(&f);
-        }
-        f.close();
-        ASTPrinter printer(m_source, &out);
-        printer.walk();
-    } else if (type == "llvm") {
-        if (file.isEmpty()) {
-            QTextStream out(stdout);
-            out << llvmIR;
-            out.flush();
-        } else {
-            QFile f(file);
-            if (f.open(QIODevice::WriteOnly)) {
-                QTextStream out(&f);
-                out << llvmIR;
-                out.flush();
-                f.close();
-            } else {
-                error(QString("can not write to file $0").arg(file));
-            }
-        }
-    } else if (type == "obj") {
-        if (file.isEmpty()) {
-            QFileInfo info(m_source->name());
-            file = info.dir().path() + QDir::separator() + info.baseName() + ".o";
-        }
+    // The object is written last since partitioning promotes the internal
+    // symbols of the module
+    QStringList types = Options::instance()->outputTypes();
+    if (types.contains("ast"))
+        writeAST(outputFile("ast"));
 
-        QProcess config;
-        config.setProgram("llvm-config-3.6");
-        config.setArguments(QStringList() << "--bindir");
-        config.start(QIODevice::ReadOnly);
-        if (!config.waitForFinished())
-            error("could not find llvm-config tool");
-        QString bindir = config.readAllStandardOutput();
-        bindir.remove('\n');
-
-        QProcess llc;
-        llc.setProgram("llc-3.6");
-        llc.setArguments(QStringList() << "-filetype=obj");
-        llc.start();
-        if (!llc.waitForStarted())
-            error("could not start llc tool");
-
-        llc.write(llvmIR.toLatin1());
-
-        llc.waitForBytesWritten();
-        llc.closeWriteChannel();
-
-        if (!llc.waitForFinished())
-            error("llc tool crashed");
-
-        QByteArray err = llc.readAllStandardError();
-        if (!err.isEmpty())
-            error("llc tool exited with error");
-
-        QByteArray output = llc.readAllStandardOutput();
-
-        QFile f(file);
-        if (f.open(QIODevice::WriteOnly)) {
-            f.write(output);
-            f.flush();
-            f.close();
-        } else {
-            error(QString("can not write to file $0").arg(file));
-        }
+    if (types.contains("llvm"))
+        writeLLVMIR(codegen, outputFile("llvm"));
+
+    if (types.contains("obj"))
+        writeObject(codegen, outputFile("obj"));
+
+    if (Options::instance()->writeDependencies())
+        writeDependencies();
+}
+
+void Output::writeAST(const QString& file)
+{
+    QTextStream out(stdout);
+    QFile f(file);
+    if (!file.isEmpty()) {
+        if (f.open(QIODevice::WriteOnly))
+            out.setDevice(&f);
+        else
+            error(QString("can not write to file %1").arg(file));
     }
+    ASTPrinter printer(m_source, &out);
+    printer.walk();
+    out.flush();
+    f.close();
+}
+
+void Output::writeLLVMIR(CodeGen* codegen, const QString& file)
+{
+    assert(codegen);
+    if (!codegen->writeLLVMIR(file))
+        error(QString("can not write to file %1").arg(file));
+}
+
+void Output::writeObject(CodeGen* codegen, const QString& file)
+{
+    assert(codegen);
+    if (!Options::instance()->cacheDir().isEmpty()) {
+        writeCachedObject(codegen, file);
+        return;
+    }
+
+    QTemporaryDir dir;
+    if (!dir.isValid())
+        error("can not create temporary directory for partitions");
+
+    QStringList partitions = codegen->writePartitionedLLVMIR(Options::instance()->jobs(), dir.path());
+    if (partitions.isEmpty())
+        error(QString("can not write to directory %1").arg(dir.path()));
+
+    if (partitions.count() == 1) {
+        run("llc-3.6", llcArguments() << partitions.first() << "-o" << file);
+        return;
+    }
+
+    // The partitions are lowered concurrently and linked in partition order
+    QList<QStringList> arguments;
+    QStringList objects;
+    for (int i = 0; i < partitions.count(); ++i) {
+        QString object = dir.path() + QDir::separator() + QString("partition%1.o").arg(i);
+        objects.append(object);
+        arguments.append(llcArguments() << partitions.at(i) << "-o" << object);
+    }
+    runConcurrently("llc-3.6", arguments, partitions.count());
+
+    run("ld", QStringList() << "-r" << "-o" << file << objects);
+
+    // Symbols promoted to hidden for the partitions become local again
+    run("objcopy", QStringList() << "--localize-hidden" << file);
+}
+
+void Output::writeCachedObject(CodeGen* codegen, const QString& file)
+{
+    QTemporaryDir dir;
+    if (!dir.isValid())
+        error("can not create temporary directory for partitions");
+
+    ObjectCache cache(Options::instance()->cacheDir(), file);
+    QList<ObjectCache::Fragment> fragments = cache.fragments(codegen->functionKeys());
+
+    // Only the fragments with a function that changed are generated and lowered
+    QList<QStringList> arguments;
+    QHash<int, QString> objectForFragment;
+    for (int i = 0; i < fragments.count(); ++i) {
+        if (cache.contains(fragments.at(i)))
+            continue;
+
+        QStringList functions;
+        for (int j = 0; j < fragments.at(i).functions.count(); ++j)
+            functions.append(fragments.at(i).functions.at(j).first);
+
+        QString partition = dir.path() + QDir::separator() + QString("fragment%1.ll").arg(i);
+        if (!codegen->writePartitionLLVMIR(functions, partition))
+            error(QString("can not write to file %1").arg(partition));
+
+        QString object = dir.path() + QDir::separator() + QString("fragment%1.o").arg(i);
+        objectForFragment.insert(i, object);
+        arguments.append(llcArguments() << partition << "-o" << object);
+    }
+
+    // Global variables no function uses are never cached
+    QString globals;
+    if (codegen->hasUnownedGlobals()) {
+        QString partition = dir.path() + QDir::separator() + "globals.ll";
+        if (!codegen->writePartitionLLVMIR(QStringList(), partition))
+            error(QString("can not write to file %1").arg(partition));
+
+        globals = dir.path() + QDir::separator() + "globals.o";
+        arguments.append(llcArguments() << partition << "-o" << globals);
+    }
+
+    runConcurrently("llc-3.6", arguments, Options::instance()->jobs());
+
+    QStringList objects;
+    for (int i = 0; i < fragments.count(); ++i) {
+        if (objectForFragment.contains(i) && !cache.insert(fragments.at(i), objectForFragment.value(i)))
+            error(QString("can not write to directory %1").arg(Options::instance()->cacheDir()));
+        objects.append(cache.objectFile(fragments.at(i)));
+    }
+
+    if (!globals.isEmpty())
+        objects.append(globals);
+
+    // A module that defines nothing still needs an object
+    if (objects.isEmpty()) {
+        QString module = dir.path() + QDir::separator() + "module.ll";
+        if (!codegen->writeLLVMIR(module))
+            error(QString("can not write to file %1").arg(module));
+        run("llc-3.6", llcArguments() << module << "-o" << file);
+        cache.setFragments(fragments);
+        return;
+    }
+
+    run("ld", QStringList() << "-r" << "-o" << file << objects);
+
+    // Symbols promoted to hidden for the fragments become local again
+    run("objcopy", QStringList() << "--localize-hidden" << file);
+
+    cache.setFragments(fragments);
+}
+
+void Output::writeDependencies()
+{
+    QStringList targets;
+    foreach (QString type, Options::instance()->outputTypes()) {
+        QString file = outputFile(type);
+        if (!file.isEmpty())
+            targets.append(file);
+    }
+
+    if (targets.isEmpty())
+        error("can not write dependencies for outputs written to stdout");
+
+    QString file = Options::instance()->dependencyFile();
+    if (file.isEmpty()) {
+        QFileInfo info(targets.first());
+        file = info.dir().path() + QDir::separator() + info.completeBaseName() + ".d";
+    }
+
+    QStringList prerequisites;
+    if (QFileInfo(m_source->name()).exists())
+        prerequisites.append(m_source->name());
+    prerequisites << FileSources::instance()->dependencies();
+
+    QFile f(file);
+    if (!f.open(QIODevice::WriteOnly))
+        error(QString("can not write to file %1").arg(file));
+
+    QTextStream out(&f);
+    for (int i = 0; i < targets.count(); ++i)
+        out << (i ? " " : "") << escapeMakePath(targets.at(i));
+    out << ':';
+    foreach (QString prerequisite, prerequisites)
+        out << " \\\n  " << escapeMakePath(prerequisite);
+    out << '\n';
+
+    // An empty rule for every include keeps make from failing once it is
+    // deleted or no longer included
+    foreach (QString prerequisite, FileSources::instance()->dependencies())
+        out << '\n' << escapeMakePath(prerequisite) << ":\n";
+    out.flush();
+    f.close();
+}
+
+QString Output::outputFile(const QString& type) const
+{
+    QString file = Options::instance()->outputFile(type);
+    if (!file.isEmpty())
+        return file;
+
+    // A single textual output goes to stdout, everything else is written
+    // next to the source
+    if (type != "obj" && Options::instance()->outputTypes().count() == 1)
+        return QString();
+
+    QString suffix = type == "obj" ? ".o" : type == "llvm" ? ".ll" : ".ast";
+    QFileInfo info(m_source->name());
+    return info.dir().path() + QDir::separator() + info.baseName() + suffix;
 }
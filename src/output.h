@@ -3,6 +3,7 @@
 
 #include <QtCore>
 
+class CodeGen;
 class SourceBuffer;
 
 class Output {
@@ -10,9 +11,18 @@ public:
     Output(SourceBuffer*);
 
     /*!
-     * \brief writes the LLVM IR to the specified output in Options
+     * \brief writes every output type specified in Options from the one AST and module
+     * @param codegen the generated module or 0 if only the AST is requested
      */
-    void write(const QString&);
+    void write(CodeGen* codegen);
+
+private:
+    void writeAST(const QString& file);
+    void writeLLVMIR(CodeGen* codegen, const QString& file);
+    void writeObject(CodeGen* codegen, const QString& file);
+    void writeCachedObject(CodeGen* codegen, const QString& file);
+    void writeDependencies();
+    QString outputFile(const QString& type) const;
 
 private:
     SourceBuffer* m_source;
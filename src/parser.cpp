@@ -1,5 +1,30 @@
 #include "parser.h"
 
+// Function attributes other than extern are identifiers rather than keywords so
+// they remain usable as names
+static bool isFunctionAttribute(const Token& tok)
+{
+    static const QStringList attributes = QStringList() << "cold" << "const" << "fastmath" << "hot" << "inline"
+                                                        << "memoize" << "noinline" << "nounwind" << "pure"
+                                                        << "tailcall" << "target_clones";
+    return tok.type == Identifier && attributes.contains(tok.toString());
+}
+
+// The features a function can be cloned for are those the resolver can detect
+static bool isCloneTarget(const QString& target)
+{
+    static const QStringList targets = QStringList() << "default" << "cmov" << "mmx" << "popcnt" << "sse" << "sse2"
+                                                     << "sse3" << "ssse3" << "sse4.1" << "sse4.2" << "avx" << "avx2"
+                                                     << "sse4a" << "fma4" << "xop" << "fma" << "avx512f";
+    return targets.contains(target);
+}
+
+static bool isLoopAttribute(const Token& tok)
+{
+    static const QStringList attributes = QStringList() << "novectorize" << "unroll" << "vectorize";
+    return tok.type == Identifier && attributes.contains(tok.toString());
+}
+
 Parser::Parser()
 {
     clear();
@@ -18,15 +43,25 @@ void Parser::clear()
     m_expectedScope = 0;
     m_indent = Unset;
     m_source = 0;
+    m_end = 0;
+    m_namespace = QString();
 }
 
 void Parser::parse(SourceBuffer* source)
+{
+    parse(source, 0, source->tokenCount());
+}
+
+void Parser::parse(SourceBuffer* source, int first, int last, const QString& _namespace)
 {
     clear();
     m_source = source;
+    m_index = first - 1;
+    m_end = last;
+    m_namespace = _namespace;
 
     QList<Token> currentAttributes;
-    while (m_index < m_source->tokenCount() - 1) {
+    while (m_index < m_end - 1) {
         Token tok = advance(1);
         if (tok.type == Newline)
             continue;
@@ -56,7 +91,7 @@ void Parser::newline()
 
 Token Parser::advance(int i, bool skipComments)
 {
-    if (m_index + 1 >= m_source->tokenCount()) {
+    if (m_index + 1 >= m_end) {
         TokenPosition pos;
         pos.line = m_source->newlineCount() + 1;
         pos.column = 0;
@@ -79,7 +114,7 @@ Token Parser::advance(int i, bool skipComments)
 
 Token Parser::current(bool skipComments) const
 {
-    assert(m_index >= 0 && m_index < m_source->tokenCount());
+    assert(m_index >= 0 && m_index < m_end);
     return look(0, skipComments);
 }
 
@@ -88,7 +123,7 @@ Token Parser::look(int i, bool skipComments) const
     if (!skipComments) {
         int index = m_index + i;
         assert(index >= 0);
-        if (index >= m_source->tokenCount())
+        if (index >= m_end)
             return Token();
 
         return m_source->tokenAt(index);
@@ -99,11 +134,11 @@ Token Parser::look(int i, bool skipComments) const
         index++;
         for (;;) {
             assert(index >= 0);
-            if (index >= m_source->tokenCount())
+            if (index >= m_end)
                 return Token();
 
             Token tok = m_source->tokenAt(index);
-            Token next = index + 1 >= m_source->tokenCount() ? Token() : m_source->tokenAt(index + 1);
+            Token next = index + 1 >= m_end ? Token() : m_source->tokenAt(index + 1);
             if (tok.type == Comment || (tok.type == Whitespace && next.type == Comment))
                 index++;
             else
@@ -144,6 +179,14 @@ bool Parser::hasTokenType(const QList<Token>& tokens, TokenType type) const
     return false;
 }
 
+bool Parser::hasAttribute(const QList<Token>& tokens, const QString& name) const
+{
+    foreach (Token tok, tokens)
+        if (tok.type == Identifier && tok.toString() == name)
+            return true;
+    return false;
+}
+
 bool Parser::checkLeadingWhitespace(const Token& tok)
 {
     if (m_indent == Tabs) {
@@ -273,6 +316,7 @@ void Parser::parseFuncDecl(const QList<Token>& attributes)
 {
     ParserContext context(this, "function declaration");
 
+    Token keyword = current();
     Token tok = advance(1);
     if (!expect(tok, Whitespace))
         return;
@@ -336,6 +380,39 @@ void Parser::parseFuncDecl(const QList<Token>& attributes)
     if (!expect(tok, Newline))
         return;
 
+    if (hasTokenType(attributes, Extern) && hasAttribute(attributes, "memoize")) {
+        m_source->error(keyword, "function with extern attribute can not be memoized");
+        return;
+    }
+
+    // Results are only reused when calls on the same arguments have the same
+    // result and no other effect
+    if (hasAttribute(attributes, "memoize") && !hasAttribute(attributes, "pure")
+        && !hasAttribute(attributes, "const")) {
+        m_source->error(keyword, "memoized function must have pure or const attribute");
+        return;
+    }
+
+    if (hasAttribute(attributes, "inline") && hasAttribute(attributes, "noinline")) {
+        m_source->error(keyword, "function can not have both inline and noinline attributes");
+        return;
+    }
+
+    if (hasAttribute(attributes, "hot") && hasAttribute(attributes, "cold")) {
+        m_source->error(keyword, "function can not have both hot and cold attributes");
+        return;
+    }
+
+    if (hasTokenType(attributes, Extern) && hasAttribute(attributes, "target_clones")) {
+        m_source->error(keyword, "function with extern attribute can not be cloned");
+        return;
+    }
+
+    if (hasAttribute(attributes, "memoize") && hasAttribute(attributes, "target_clones")) {
+        m_source->error(keyword, "memoized function can not be cloned");
+        return;
+    }
+
     FuncDef* funcDef = 0;
     if (hasTokenType(attributes, Extern)) {
         funcDef = parseEmptyFuncDef();
@@ -346,6 +423,8 @@ void Parser::parseFuncDecl(const QList<Token>& attributes)
     }
 
     FuncDecl* decl = new FuncDecl;
+    decl->keyword = keyword;
+    decl->end = current();
     decl->name = name;
     decl->_namespace = m_namespace;
     decl->objects = objects;
@@ -396,6 +475,7 @@ QList<Token> Parser::parseTypeAttrs()
 
     QList<TokenType> expectedAttributes;
     expectedAttributes.append(Extern);
+    expectedAttributes.append(Identifier);
 
     Token tok = advance(1);
     if (!expect(tok, expectedAttributes))
@@ -403,6 +483,8 @@ QList<Token> Parser::parseTypeAttrs()
 
     QList<Token> attributes;
     attributes.append(tok);
+    if (!parseAttributeArgs(&attributes))
+        return QList<Token>();
 
     for (;;) {
         if (look(1).type != Comma)
@@ -417,6 +499,8 @@ QList<Token> Parser::parseTypeAttrs()
             return QList<Token>();
 
         attributes.append(tok);
+        if (!parseAttributeArgs(&attributes))
+            return QList<Token>();
     }
 
     tok = advance(1);
@@ -432,9 +516,83 @@ QList<Token> Parser::parseTypeAttrs()
         return QList<Token>();
     }
 
+    // Arguments follow the attribute they belong to, so every other token is an
+    // attribute whose arguments are checked, extern included
+    for (int i = 0; i < attributes.count(); ++i) {
+        Token attribute = attributes.at(i);
+        if (attribute.type == StringLiteral)
+            continue;
+
+        if (attribute.type == Identifier && !isFunctionAttribute(attribute)) {
+            m_source->error(attribute, "unknown attribute");
+            return QList<Token>();
+        }
+
+        if (attribute.type == Identifier && look(1).type != Function) {
+            m_source->error(attribute, "attribute can only be used on functions");
+            return QList<Token>();
+        }
+
+        bool takesArgs = attribute.toString() == "target_clones";
+        bool hasArgs = i + 1 < attributes.count() && attributes.at(i + 1).type == StringLiteral;
+        if (takesArgs != hasArgs) {
+            m_source->error(attribute, takesArgs ? "attribute needs a list of targets" : "attribute does not take arguments");
+            return QList<Token>();
+        }
+
+        if (!takesArgs)
+            continue;
+
+        QStringList targets;
+        for (int j = i + 1; j < attributes.count() && attributes.at(j).type == StringLiteral; ++j) {
+            QString target = attributes.at(j).toString();
+            target.remove(0, 1); // remove leading quote
+            target.chop(1); // remove trailing quote
+
+            if (!isCloneTarget(target) || targets.contains(target)) {
+                m_source->error(attributes.at(j), "unknown or repeated target for function clone");
+                return QList<Token>();
+            }
+            targets.append(target);
+        }
+
+        if (!targets.contains("default")) {
+            m_source->error(attribute, "function clones need a default target");
+            return QList<Token>();
+        }
+    }
+
     return attributes;
 }
 
+// (arg[, arg]*) where every arg is a token of the given type
+bool Parser::parseAttributeArgs(QList<Token>* attributes, TokenType type)
+{
+    if (look(1).type != OpenParenthesis)
+        return true;
+
+    Token tok = advance(2);
+    if (!expect(tok, type))
+        return false;
+
+    attributes->append(tok);
+
+    while (look(1).type == Comma) {
+        tok = advance(2);
+        if (!expect(tok, Whitespace))
+            return false;
+
+        tok = advance(1);
+        if (!expect(tok, type))
+            return false;
+
+        attributes->append(tok);
+    }
+
+    tok = advance(1);
+    return expect(tok, CloseParenthesis);
+}
+
 QList<QSharedPointer<TypeObject> > Parser::parseTypeObjects()
 {
     bool unnamedTypeObject = false;
@@ -579,6 +737,16 @@ FuncDef* Parser::parseEmptyFuncDef()
     return 0;
 }
 
+unsigned Parser::indentOf(const Token& tok) const
+{
+    int columns = tok.end.column - tok.start.column + 1;
+    if (tok.type == Tab)
+        return columns;
+    if (tok.type == Whitespace)
+        return m_originalSpacesForIndent ? columns / m_originalSpacesForIndent : 1;
+    return 0;
+}
+
 bool Parser::parseIndent(unsigned expected)
 {
     if (look(1).type != Whitespace && look(1).type != Tab)
@@ -606,7 +774,50 @@ Expr* Parser::parseExpr()
     if (!lhs)
         return 0;
 
-    return parseBinaryOpExpr(0, lhs);
+    Expr* expr = parseBinaryOpExpr(0, lhs);
+    if (!expr || look(1).type != Whitespace || look(2).type != QuestionMark)
+        return expr;
+
+    return parseConditionalExpr(expr);
+}
+
+// condition ? expr : expr binds looser than any binary operator and associates
+// to the right
+ConditionalExpr* Parser::parseConditionalExpr(Expr* condition)
+{
+    ParserContext context(this, "conditional expression");
+
+    QScopedPointer<ConditionalExpr> conditionalExpr(new ConditionalExpr);
+    conditionalExpr->start = condition->start;
+    conditionalExpr->condition = QSharedPointer<Expr>(condition);
+
+    Token tok = advance(3);
+    if (!expect(tok, Whitespace))
+        return 0;
+
+    Expr* lhs = parseExpr();
+    if (!lhs)
+        return 0;
+    conditionalExpr->lhs = QSharedPointer<Expr>(lhs);
+
+    tok = advance(1);
+    if (!expect(tok, Whitespace))
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, Colon))
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, Whitespace))
+        return 0;
+
+    Expr* rhs = parseExpr();
+    if (!rhs)
+        return 0;
+    conditionalExpr->rhs = QSharedPointer<Expr>(rhs);
+
+    return conditionalExpr.take();
 }
 
 Expr* Parser::parseBasicExpr()
@@ -632,6 +843,9 @@ Expr* Parser::parseBasicExpr()
     case True:
         expr = parseLiteralExpr();
         break;
+    case Bang:
+        expr = parseUnaryExpr();
+        break;
     default:
         break;
     };
@@ -653,38 +867,81 @@ Expr* Parser::parseBinaryOpExpr(int precedence, Expr* lhs)
         BinaryExpr::BinaryOp op;
         bool foundBinaryOp = false;
 
-        if (tok.type == Equals && look(3).type == Equals
+        // From loosest to tightest: ||, &&, comparisons, |, ^, &, shifts, additive
+        // and multiplicative operators
+        if (tok.type == Pipe && look(3).type == Pipe
             && precedence <= 1) {
+            op = BinaryExpr::OpLogicalOr;
+            tok = advance(4);
+            foundBinaryOp = true;
+            newPrecedence = 1;
+        } else if (tok.type == Ampersand && look(3).type == Ampersand
+            && precedence <= 2) {
+            op = BinaryExpr::OpLogicalAnd;
+            tok = advance(4);
+            foundBinaryOp = true;
+            newPrecedence = 2;
+        } else if (tok.type == Equals && look(3).type == Equals
+            && precedence <= 3) {
             op = BinaryExpr::OpEquality;
             tok = advance(4);
             foundBinaryOp = true;
+            newPrecedence = 3;
         } else if (tok.type == Bang && look(3).type == Equals
-            && precedence <= 1) {
+            && precedence <= 3) {
             op = BinaryExpr::OpNotEquality;
             tok = advance(4);
             foundBinaryOp = true;
+            newPrecedence = 3;
         } else if ((tok.type == LessThan || tok.type == GreaterThan) && look(3).type == Equals
-            && precedence <= 1) {
+            && precedence <= 3) {
             op = tok.type == LessThan ? BinaryExpr::OpLessThanOrEquality : BinaryExpr::OpGreaterThanOrEquality;
             tok = advance(4);
             foundBinaryOp = true;
+            newPrecedence = 3;
+        } else if ((tok.type == LessThan || tok.type == GreaterThan) && look(3).type == tok.type
+            && precedence <= 7) {
+            op = tok.type == LessThan ? BinaryExpr::OpShiftLeft : BinaryExpr::OpShiftRight;
+            tok = advance(4);
+            foundBinaryOp = true;
+            newPrecedence = 7;
         } else if ((tok.type == LessThan || tok.type == GreaterThan)
-            && precedence <= 1) {
+            && precedence <= 3) {
             op = tok.type == LessThan ? BinaryExpr::OpLessThan : BinaryExpr::OpGreaterThan;
             tok = advance(3);
             foundBinaryOp = true;
+            newPrecedence = 3;
+        } else if (tok.type == Pipe && look(3).type != Pipe
+            && precedence <= 4) {
+            op = BinaryExpr::OpBitwiseOr;
+            tok = advance(3);
+            foundBinaryOp = true;
+            newPrecedence = 4;
+        } else if (tok.type == Cap
+            && precedence <= 5) {
+            op = BinaryExpr::OpBitwiseXor;
+            tok = advance(3);
+            foundBinaryOp = true;
+            newPrecedence = 5;
+        } else if (tok.type == Ampersand && look(3).type != Ampersand
+            && precedence <= 6) {
+            op = BinaryExpr::OpBitwiseAnd;
+            tok = advance(3);
+            foundBinaryOp = true;
+            newPrecedence = 6;
         } else if ((tok.type == Plus || tok.type == Minus)
-            && precedence <= 2) {
+            && precedence <= 8) {
             op = tok.type == Plus ? BinaryExpr::OpAddition : BinaryExpr::OpSubtraction;
             tok = advance(3);
             foundBinaryOp = true;
-            newPrecedence = 2;
-        } else if ((tok.type == Star || tok.type == Slash)
-            && precedence <= 3) {
-            op = tok.type == Star ? BinaryExpr::OpMultiplication : BinaryExpr::OpDivision;
+            newPrecedence = 8;
+        } else if ((tok.type == Star || tok.type == Slash || tok.type == Percent)
+            && precedence <= 9) {
+            op = tok.type == Star ? BinaryExpr::OpMultiplication
+                : tok.type == Slash ? BinaryExpr::OpDivision : BinaryExpr::OpRemainder;
             tok = advance(3);
             foundBinaryOp = true;
-            newPrecedence = 3;
+            newPrecedence = 9;
         }
 
         if (!foundBinaryOp)
@@ -697,7 +954,9 @@ Expr* Parser::parseBinaryOpExpr(int precedence, Expr* lhs)
         if (!rhs)
             return 0;
 
-        Expr* nextRHS = parseBinaryOpExpr(newPrecedence, rhs);
+        // Only operators that bind tighter belong to the right hand side so that
+        // operators of the same precedence associate to the left
+        Expr* nextRHS = parseBinaryOpExpr(newPrecedence + 1, rhs);
         if (nextRHS)
             rhs = nextRHS;
 
@@ -710,6 +969,25 @@ Expr* Parser::parseBinaryOpExpr(int precedence, Expr* lhs)
     }
 }
 
+UnaryExpr* Parser::parseUnaryExpr()
+{
+    ParserContext context(this, "unary expression");
+
+    // The operator binds tighter than any binary operator so it only takes the
+    // basic expression following it
+    Token op = current();
+    Expr* expr = parseBasicExpr();
+    if (!expr) {
+        m_source->error(op, "expecting an expression to follow unary operator");
+        return 0;
+    }
+
+    UnaryExpr* unaryExpr = new UnaryExpr;
+    unaryExpr->op = UnaryExpr::OpLogicalNot;
+    unaryExpr->expr = QSharedPointer<Expr>(expr);
+    return unaryExpr;
+}
+
 VarExpr* Parser::parseVarExpr()
 {
     ParserContext context(this, "variable expression");
@@ -792,10 +1070,14 @@ Stmt* Parser::parseStmt()
     while (current().type == Newline && look(1).type == Newline)
         advance(1);
 
+    // A line indented less than expected ends the body of a loop
+    if (current().type == Newline && indentOf(look(1)) < m_expectedScope)
+        return 0;
+
     if (current().type == Newline && !parseIndent(m_expectedScope))
         return 0;
 
-    if (m_index == m_source->tokenCount() - 1)
+    if (m_index == m_end - 1)
         return 0;
 
     Stmt* stmt = 0;
@@ -805,8 +1087,31 @@ Stmt* Parser::parseStmt()
         stmt = parseIfStmt(); break;
     case Return:
         stmt = parseReturnStmt(); break;
+    case While:
+        stmt = parseWhileStmt(QList<Token>()); break;
+    case For:
+        stmt = parseForStmt(QList<Token>()); break;
+    case Match:
+        stmt = parseMatchStmt(); break;
+    case OpenSquare:
+    {
+        QList<Token> attributes = parseLoopAttrs();
+        if (attributes.isEmpty())
+            return 0;
+
+        tok = advance(1);
+        if (tok.type == While)
+            stmt = parseWhileStmt(attributes);
+        else
+            stmt = parseForStmt(attributes);
+        break;
+    }
     case Identifier:
-        stmt = parseVarDeclStmt(); break;
+        if (look(1).type == Whitespace && look(2).type == Equals)
+            stmt = parseAssignStmt();
+        else
+            stmt = parseVarDeclStmt();
+        break;
     default:
         return 0;
     };
@@ -814,6 +1119,322 @@ Stmt* Parser::parseStmt()
     return stmt;
 }
 
+// [attr[(count)][, attr[(count)]]*]\n
+QList<Token> Parser::parseLoopAttrs()
+{
+    ParserContext context(this, "loop attribute");
+
+    QList<Token> attributes;
+    for (;;) {
+        Token tok = advance(1);
+        if (!expect(tok, Identifier))
+            return QList<Token>();
+
+        if (!isLoopAttribute(tok)) {
+            m_source->error(tok, "unknown loop attribute");
+            return QList<Token>();
+        }
+
+        int first = attributes.count();
+        attributes.append(tok);
+        if (!parseAttributeArgs(&attributes, DecLiteral))
+            return QList<Token>();
+
+        // The vectorizer only handles widths that are powers of two
+        int args = attributes.count() - first - 1;
+        int count = args == 1 ? attributes.last().toString().toInt() : 0;
+        if (tok.toString() == "novectorize" && args) {
+            m_source->error(tok, "attribute does not take arguments");
+            return QList<Token>();
+        } else if (tok.toString() == "vectorize" && (args != 1 || count <= 0 || (count & (count - 1)))) {
+            m_source->error(tok, "vectorize needs a width that is a power of two");
+            return QList<Token>();
+        } else if (tok.toString() == "unroll" && (args != 1 || count <= 0)) {
+            m_source->error(tok, "unroll needs a positive count");
+            return QList<Token>();
+        }
+
+        if (look(1).type != Comma)
+            break;
+
+        tok = advance(2);
+        if (!expect(tok, Whitespace))
+            return QList<Token>();
+    }
+
+    Token tok = advance(1);
+    if (!expect(tok, ClosedSquare))
+        return QList<Token>();
+
+    if (hasAttribute(attributes, "vectorize") && hasAttribute(attributes, "novectorize")) {
+        m_source->error(tok, "loop can not both be vectorized and not be vectorized");
+        return QList<Token>();
+    }
+
+    tok = advance(1);
+    if (!expect(tok, Newline) || !parseIndent(m_expectedScope))
+        return QList<Token>();
+
+    if (look(1).type != While && look(1).type != For) {
+        m_source->error(tok, "expecting loop to follow loop attribute", SourceBuffer::Fatal);
+        return QList<Token>();
+    }
+
+    return attributes;
+}
+
+bool Parser::parseLoopBody(LoopStmt* loop)
+{
+    Token tok = advance(1);
+    if (!expect(tok, Newline))
+        return false;
+
+    IndentLevel indent(this);
+    while (Stmt* stmt = parseStmt())
+        loop->stmts.append(QSharedPointer<Stmt>(stmt));
+
+    if (loop->stmts.isEmpty()) {
+        m_source->error(loop->keyword, "loop must define at least one statement");
+        return false;
+    }
+
+    return true;
+}
+
+// while (expr)\n
+WhileStmt* Parser::parseWhileStmt(const QList<Token>& attributes)
+{
+    ParserContext context(this, "while statement");
+
+    Token keyword = current();
+
+    Token tok = advance(1);
+    if (!expect(tok, Whitespace))
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, OpenParenthesis))
+        return 0;
+
+    Expr* expr = parseExpr();
+    if (!expr)
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, CloseParenthesis))
+        return 0;
+
+    WhileStmt* whileStmt = new WhileStmt;
+    whileStmt->keyword = keyword;
+    whileStmt->attributes = attributes;
+    whileStmt->expr = QSharedPointer<Expr>(expr);
+    if (!parseLoopBody(whileStmt)) {
+        delete whileStmt;
+        return 0;
+    }
+    return whileStmt;
+}
+
+// for (Type name = start, end[, step])\n
+ForStmt* Parser::parseForStmt(const QList<Token>& attributes)
+{
+    ParserContext context(this, "for statement");
+
+    Token keyword = current();
+
+    Token tok = advance(1);
+    if (!expect(tok, Whitespace))
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, OpenParenthesis))
+        return 0;
+
+    Token type = advance(1);
+    if (!expect(type, Identifier))
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, Whitespace))
+        return 0;
+
+    Token name = advance(1);
+    if (!expect(name, Identifier))
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, Whitespace))
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, Equals))
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, Whitespace))
+        return 0;
+
+    QList<QSharedPointer<Expr> > exprs;
+    for (;;) {
+        Expr* expr = parseExpr();
+        if (!expr)
+            return 0;
+        exprs.append(QSharedPointer<Expr>(expr));
+
+        if (look(1).type != Comma || exprs.count() == 3)
+            break;
+
+        tok = advance(2);
+        if (!expect(tok, Whitespace))
+            return 0;
+    }
+
+    tok = advance(1);
+    if (!expect(tok, CloseParenthesis))
+        return 0;
+
+    if (exprs.count() < 2) {
+        m_source->error(tok, "for statement needs an end after its start");
+        return 0;
+    }
+
+    ForStmt* forStmt = new ForStmt;
+    forStmt->keyword = keyword;
+    forStmt->attributes = attributes;
+    forStmt->type = type;
+    forStmt->name = name;
+    forStmt->start = exprs.at(0);
+    forStmt->end = exprs.at(1);
+    if (exprs.count() == 3)
+        forStmt->step = exprs.at(2);
+    if (!parseLoopBody(forStmt)) {
+        delete forStmt;
+        return 0;
+    }
+    return forStmt;
+}
+
+// match (expr)\n followed by its cases, indented
+MatchStmt* Parser::parseMatchStmt()
+{
+    ParserContext context(this, "match statement");
+
+    Token keyword = current();
+
+    Token tok = advance(1);
+    if (!expect(tok, Whitespace))
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, OpenParenthesis))
+        return 0;
+
+    Expr* expr = parseExpr();
+    if (!expr)
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, CloseParenthesis))
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, Newline))
+        return 0;
+
+    MatchStmt* matchStmt = new MatchStmt;
+    matchStmt->keyword = keyword;
+    matchStmt->expr = QSharedPointer<Expr>(expr);
+
+    // A line indented less than the cases ends the match
+    IndentLevel indent(this);
+    for (;;) {
+        while (current().type == Newline && look(1).type == Newline)
+            advance(1);
+
+        if (current().type != Newline || indentOf(look(1)) < m_expectedScope)
+            break;
+
+        MatchCase* matchCase = parseIndent(m_expectedScope) ? parseMatchCase() : 0;
+        if (!matchCase) {
+            delete matchStmt;
+            return 0;
+        }
+        matchStmt->cases.append(QSharedPointer<MatchCase>(matchCase));
+    }
+
+    if (matchStmt->cases.isEmpty()) {
+        m_source->error(keyword, "match statement must define at least one case");
+        delete matchStmt;
+        return 0;
+    }
+
+    return matchStmt;
+}
+
+// case literal[, literal]*: stmt or else: stmt, where the statement may instead
+// be a block indented on the lines that follow
+MatchCase* Parser::parseMatchCase()
+{
+    ParserContext context(this, "match case");
+
+    Token keyword = advance(1);
+    if (keyword.type != Case && keyword.type != Else) {
+        m_source->error(keyword, "expecting case or else in match statement");
+        return 0;
+    }
+
+    QScopedPointer<MatchCase> matchCase(new MatchCase);
+    matchCase->keyword = keyword;
+
+    Token tok;
+    while (keyword.type == Case) {
+        tok = advance(1);
+        if (!expect(tok, Whitespace))
+            return 0;
+
+        tok = advance(1);
+        if (tok.type != DecLiteral && tok.type != HexLiteral && tok.type != OctLiteral && tok.type != BinLiteral) {
+            m_source->error(tok, "expecting integer literal for case");
+            return 0;
+        }
+
+        LiteralExpr* value = new LiteralExpr;
+        value->start = tok;
+        value->literal = tok;
+        matchCase->values.append(QSharedPointer<LiteralExpr>(value));
+
+        if (look(1).type != Comma)
+            break;
+        advance(1);
+    }
+
+    tok = advance(1);
+    if (!expect(tok, Colon))
+        return 0;
+
+    if (look(1).type == Newline) {
+        advance(1);
+        IndentLevel indent(this);
+        while (Stmt* stmt = parseStmt())
+            matchCase->stmts.append(QSharedPointer<Stmt>(stmt));
+    } else {
+        tok = advance(1);
+        if (!expect(tok, Whitespace))
+            return 0;
+
+        IndentLevel indent(this);
+        if (Stmt* stmt = parseStmt())
+            matchCase->stmts.append(QSharedPointer<Stmt>(stmt));
+    }
+
+    if (matchCase->stmts.isEmpty()) {
+        m_source->error(keyword, "case must define at least one statement");
+        return 0;
+    }
+
+    return matchCase.take();
+}
+
 IfStmt* Parser::parseIfStmt()
 {
     ParserContext context(this, "if statement");
@@ -822,6 +1443,19 @@ IfStmt* Parser::parseIfStmt()
     if (!expect(tok, Whitespace))
         return 0;
 
+    Token hint;
+    if (look(1).type == Identifier) {
+        hint = advance(1);
+        if (hint.toString() != "likely" && hint.toString() != "unlikely") {
+            m_source->error(hint, "expecting likely or unlikely for if statement");
+            return 0;
+        }
+
+        tok = advance(1);
+        if (!expect(tok, Whitespace))
+            return 0;
+    }
+
     tok = advance(1);
     if (!expect(tok, OpenParenthesis))
         return 0;
@@ -836,17 +1470,45 @@ IfStmt* Parser::parseIfStmt()
 
     tok = advance(1);
 
-    IndentLevel indent(this);
-    Stmt* stmt = parseStmt();
+    Stmt* stmt = 0;
+    {
+        IndentLevel indent(this);
+        stmt = parseStmt();
+    }
     if (!stmt) {
         m_source->error(tok, "no statement following condition");
         return 0;
     }
 
-    IfStmt* ifStmt = new IfStmt;
+    QScopedPointer<IfStmt> ifStmt(new IfStmt);
+    ifStmt->hint = hint;
     ifStmt->expr = QSharedPointer<Expr>(expr);
     ifStmt->stmt = QSharedPointer<Stmt>(stmt);
-    return ifStmt;
+
+    // else [stmt] on the next line at the indentation of the if, where an if
+    // following it continues the chain at the same indentation
+    if (current().type == Newline && indentOf(look(1)) == m_expectedScope && look(2).type == Else) {
+        if (!parseIndent(m_expectedScope))
+            return 0;
+
+        Token keyword = advance(1);
+        advance(1);
+
+        Stmt* elseStmt = 0;
+        if (look(1).type == If) {
+            elseStmt = parseStmt();
+        } else {
+            IndentLevel indent(this);
+            elseStmt = parseStmt();
+        }
+        if (!elseStmt) {
+            m_source->error(keyword, "no statement following else");
+            return 0;
+        }
+        ifStmt->elseStmt = QSharedPointer<Stmt>(elseStmt);
+    }
+
+    return ifStmt.take();
 }
 
 ReturnStmt* Parser::parseReturnStmt()
@@ -863,7 +1525,7 @@ ReturnStmt* Parser::parseReturnStmt()
     if (!expr)
         return 0;
 
-    if (m_index < m_source->tokenCount() - 1) {
+    if (m_index < m_end - 1) {
         tok = advance(1);
         if (!expect(tok, Newline))
             return 0;
@@ -908,6 +1570,40 @@ FuncCallExpr* Parser::parseFuncCallExpr()
     return funcCallExpr;
 }
 
+AssignStmt* Parser::parseAssignStmt()
+{
+    ParserContext context(this, "assignment statement");
+
+    Token name = current();
+
+    Token tok = advance(1);
+    if (!expect(tok, Whitespace))
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, Equals))
+        return 0;
+
+    tok = advance(1);
+    if (!expect(tok, Whitespace))
+        return 0;
+
+    TypeCtorExpr* expr = parseTypeCtorExpr();
+    if (!expr) {
+        m_source->error(tok, "expected expression for assignment");
+        return 0;
+    }
+
+    tok = advance(1);
+    if (!expect(tok, Newline))
+        return 0;
+
+    AssignStmt* assignStmt = new AssignStmt;
+    assignStmt->name = name;
+    assignStmt->expr = QSharedPointer<TypeCtorExpr>(expr);
+    return assignStmt;
+}
+
 VarDeclStmt* Parser::parseVarDeclStmt()
 {
     ParserContext context(this, "variable declaration statement");
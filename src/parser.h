@@ -13,6 +13,12 @@ public:
 
     void parse(SourceBuffer* source);
 
+    /*!
+     * \brief parses the top level declarations in the tokens [first, last) of source as if
+     * the given namespace were in effect and appends them to its translation unit
+     */
+    void parse(SourceBuffer* source, int first, int last, const QString& _namespace = QString());
+
 private:
     enum Indent {
         Spaces,
@@ -61,6 +67,7 @@ private:
     bool expect(Token tok, TokenType t) const;
     bool expect(Token tok, const QList<TokenType>& types) const;
     bool hasTokenType(const QList<Token>& tokens, TokenType t) const;
+    bool hasAttribute(const QList<Token>& tokens, const QString& name) const;
     bool checkLeadingWhitespace(const Token&);
     bool checkLeadingTab(const Token&);
 
@@ -69,27 +76,39 @@ private:
     void parseFuncDecl(const QList<Token>& attr);
     void parseNamespace();
     QList<Token> parseTypeAttrs();
+    bool parseAttributeArgs(QList<Token>* attributes, TokenType type = StringLiteral);
     QList<QSharedPointer<TypeObject> > parseTypeObjects();
     TypeObject* parseTypeObject();
     QList<QSharedPointer<TypeParam> > parseTypeParams();
     TypeParam* parseTypeParam();
     FuncDef* parseFuncDef();
     FuncDef* parseEmptyFuncDef();
+    unsigned indentOf(const Token& tok) const;
     bool parseIndent(unsigned expect);
     Expr* parseExpr();
     Expr* parseBasicExpr();
     Expr* parseBinaryOpExpr(int, Expr*);
+    ConditionalExpr* parseConditionalExpr(Expr* condition);
+    UnaryExpr* parseUnaryExpr();
     VarExpr* parseVarExpr();
     LiteralExpr* parseLiteralExpr();
     TypeCtorExpr* parseTypeCtorExpr();
     Stmt* parseStmt();
     IfStmt* parseIfStmt();
     ReturnStmt* parseReturnStmt();
+    QList<Token> parseLoopAttrs();
+    bool parseLoopBody(LoopStmt* loop);
+    WhileStmt* parseWhileStmt(const QList<Token>& attributes);
+    ForStmt* parseForStmt(const QList<Token>& attributes);
+    AssignStmt* parseAssignStmt();
+    MatchStmt* parseMatchStmt();
+    MatchCase* parseMatchCase();
     FuncCallExpr* parseFuncCallExpr();
     VarDeclStmt* parseVarDeclStmt();
 
 private:
     int m_index;
+    int m_end;
     int m_originalSpacesForIndent;
     unsigned m_scope;
     unsigned m_expectedScope;
@@ -0,0 +1,279 @@
+#include "repl.h"
+#include "filesources.h"
+#include "lexer.h"
+#include "parser.h"
+#include "sourcebuffer.h"
+#include "target.h"
+#include "typechecker.h"
+
+#include <stdio.h>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter"
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/TargetSelect.h>
+
+#pragma clang diagnostic pop
+
+// The JIT owns the modules so CodeGen only borrows them
+static void doNotDelete(llvm::Module*)
+{
+}
+
+static bool isDeclaration(const QString& entry)
+{
+    return entry.startsWith("type ") || entry.startsWith("function ") || entry.startsWith("include ")
+        || entry.startsWith("[");
+}
+
+static QString typeForLiteral(TokenType type)
+{
+    switch (type) {
+    case True:
+    case False:
+        return "_builtin_bit_";
+    case FloatLiteral:
+        return "_builtin_double_";
+    case StringLiteral:
+        return "_builtin_pointer_int8_";
+    default:
+        return "_builtin_int64_";
+    }
+}
+
+Repl::Repl()
+    : m_in(stdin)
+    , m_out(stdout)
+    , m_context(new llvm::LLVMContext)
+    , m_engine(0)
+    , m_expressions(0)
+{
+    SourceBuffer::setInteractive(true);
+
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+
+    std::vector<std::string> features;
+    foreach (QString feature, Target::instance()->features().split(',', QString::SkipEmptyParts))
+        features.push_back(feature.toStdString());
+
+    std::string error;
+    std::unique_ptr<llvm::Module> module(new llvm::Module("repl", *m_context));
+    m_engine = llvm::EngineBuilder(std::move(module))
+        .setErrorStr(&error)
+        .setEngineKind(llvm::EngineKind::JIT)
+        .setMCPU(Target::instance()->cpu().toStdString())
+        .setMAttrs(features)
+        .setMCJITMemoryManager(std::unique_ptr<llvm::RTDyldMemoryManager>(new llvm::SectionMemoryManager))
+        .create();
+
+    if (!m_engine)
+        QTextStream(stderr) << "could not create the JIT: " << QString::fromStdString(error) << '\n';
+}
+
+Repl::~Repl()
+{
+    // The modules refer to types of the context so the JIT goes first
+    delete m_engine;
+    SourceBuffer::setInteractive(false);
+}
+
+int Repl::exec()
+{
+    if (!m_engine)
+        return EXIT_FAILURE;
+
+    // The core types are loaded once and every later entry imports them
+    bool hasCore = false;
+    try {
+        hasCore = FileSources::instance()->sourceBuffer("core.unv");
+    } catch (SourceBuffer::FatalError&) {
+    }
+
+    if (hasCore)
+        evaluate("include \"core.unv\"\n", QString());
+    else
+        m_out << "core.unv was not found in the include directories\n";
+
+    QString entry;
+    while (read(&entry)) {
+        if (entry.trimmed().isEmpty())
+            continue;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        QString value;
+        if (isDeclaration(entry)) {
+            if (!evaluate(entry + '\n', QString()))
+                continue;
+        } else {
+            // A bare expression becomes the body of a function returning its type
+            QString function = "_repl" + QString::number(++m_expressions);
+            QString type = expressionType(entry);
+            if (type.isEmpty())
+                continue;
+
+            QString text = "function " + function + " : () -> " + type + "\n\treturn " + entry + '\n';
+            if (!evaluate(text, function))
+                continue;
+            value = call(function, type);
+        }
+
+        double milliseconds = timer.nsecsElapsed() / 1000000.0;
+        if (!value.isEmpty())
+            m_out << "= " << value << ' ';
+        m_out << '(' << QString::number(milliseconds, 'f', 2) << " ms)\n";
+        m_out.flush();
+    }
+
+    m_out << '\n';
+    return EXIT_SUCCESS;
+}
+
+bool Repl::read(QString* entry)
+{
+    m_out << "unv> ";
+    m_out.flush();
+
+    QString line = m_in.readLine();
+    if (line.isNull())
+        return false;
+
+    // Functions and attributed declarations continue until an empty line
+    *entry = line;
+    if (!line.startsWith("function ") && !line.startsWith("["))
+        return true;
+
+    for (;;) {
+        m_out << "...> ";
+        m_out.flush();
+
+        line = m_in.readLine();
+        if (line.isEmpty())
+            return true;
+        *entry += '\n' + line;
+    }
+}
+
+QSharedPointer<SourceBuffer> Repl::load(const QString& text, bool check)
+{
+    QSharedPointer<SourceBuffer> buffer(new SourceBuffer(text, "repl"));
+    if (!m_entries.isEmpty())
+        buffer->typeSystem().importTypes(m_entries.last()->typeSystem());
+
+    try {
+        Lexer lexer;
+        lexer.lex(buffer.data());
+
+        Parser parser;
+        parser.parse(buffer.data());
+
+        if (check) {
+            TypeChecker checker(buffer.data());
+            checker.check();
+        }
+    } catch (SourceBuffer::FatalError&) {
+    }
+
+    if (buffer->diagnostics().isEmpty())
+        return buffer;
+
+    buffer->printDiagnostics();
+    return QSharedPointer<SourceBuffer>();
+}
+
+bool Repl::evaluate(const QString& text, const QString& function)
+{
+    QSharedPointer<SourceBuffer> buffer = load(text, true /*check*/);
+    if (!buffer)
+        return false;
+
+    // Each entry gets a module of its own and calls into the modules of earlier
+    // entries through declarations the JIT resolves
+    QString name = function.isEmpty() ? "repl" + QString::number(m_entries.count()) : function;
+    std::unique_ptr<llvm::Module> module(new llvm::Module(name.toStdString(), *m_context));
+    try {
+        CodeGen codegen(buffer.data(), m_context, Module(module.get(), doNotDelete));
+        codegen.generate();
+    } catch (SourceBuffer::FatalError&) {
+    }
+
+    if (!buffer->diagnostics().isEmpty()) {
+        buffer->printDiagnostics();
+        return false;
+    }
+
+    m_engine->addModule(std::move(module));
+    m_entries.append(buffer);
+    return true;
+}
+
+QString Repl::expressionType(const QString& expression)
+{
+    // The expression is parsed once on its own to find the type it evaluates to
+    QSharedPointer<SourceBuffer> buffer = load("function _type : () -> _builtin_int64_\n\treturn " + expression + '\n',
+                                               false /*check*/);
+    if (!buffer)
+        return QString();
+
+    FuncDecl* decl = buffer->translationUnit().funcDecl.last().data();
+    Stmt* stmt = decl->funcDef->stmts.first().data();
+    if (decl->funcDef->stmts.count() != 1 || stmt->kind != Node::_ReturnStmt) {
+        m_out << "expected a declaration or an expression\n";
+        return QString();
+    }
+
+    Expr* expr = static_cast<ReturnStmt*>(stmt)->expr.data();
+    if (expr->kind == Node::_LiteralExpr)
+        return typeForLiteral(static_cast<LiteralExpr*>(expr)->literal.type);
+
+    TypeInfo* info = 0;
+    try {
+        info = buffer->typeSystem().resolveAlias(buffer->typeSystem().typeInfoForExpr(expr));
+    } catch (SourceBuffer::FatalError&) {
+        buffer->printDiagnostics();
+        return QString();
+    }
+
+    if (!info || !info->isBuiltin() || info->lanes() || info->qualifiedTypeName() == "_builtin_void_") {
+        m_out << "the value of the expression can not be printed\n";
+        return QString();
+    }
+    return info->qualifiedTypeName();
+}
+
+QString Repl::call(const QString& function, const QString& type)
+{
+    quint64 address = m_engine->getFunctionAddress(function.toStdString());
+    if (!address)
+        return "<no code was generated>";
+
+    TypeInfo* info = m_entries.last()->typeSystem().toType(type);
+    assert(info && info->isBuiltin());
+
+    if (info->isFloatingPoint()) {
+        if (info->bitWidth() == 32)
+            return QString::number(reinterpret_cast<float (*)()>(address)());
+        return QString::number(reinterpret_cast<double (*)()>(address)(), 'g', 17);
+    }
+
+    if (info->bitWidth() == 1)
+        return reinterpret_cast<bool (*)()>(address)() ? "true" : "false";
+
+    if (!info->bitWidth())
+        return "0x" + QString::number(quintptr(reinterpret_cast<void* (*)()>(address)()), 16);
+
+    // The bits above the width of the result are undefined
+    quint64 value = reinterpret_cast<quint64 (*)()>(address)();
+    int shift = 64 - info->bitWidth();
+    if (info->isSignedInt())
+        return QString::number(qint64(value << shift) >> shift);
+    return QString::number(value << shift >> shift);
+}
@@ -0,0 +1,41 @@
+#ifndef repl_h
+#define repl_h
+
+#include <QtCore>
+#include "codegen.h"
+
+class SourceBuffer;
+
+namespace llvm {
+    class ExecutionEngine;
+}
+
+class Repl {
+public:
+    Repl();
+    ~Repl();
+
+    /*!
+     * \brief reads declarations and expressions from stdin, adding each to the JIT and
+     * printing the value of each expression, until the end of input
+     * @return the exit code
+     */
+    int exec();
+
+private:
+    bool read(QString* entry);
+    bool evaluate(const QString& text, const QString& function);
+    QString expressionType(const QString& expression);
+    QString call(const QString& function, const QString& type);
+    QSharedPointer<SourceBuffer> load(const QString& text, bool check);
+
+private:
+    QTextStream m_in;
+    QTextStream m_out;
+    Context m_context;
+    llvm::ExecutionEngine* m_engine;
+    QList<QSharedPointer<SourceBuffer> > m_entries;
+    int m_expressions;
+};
+
+#endif // repl_h
@@ -0,0 +1,311 @@
+#include "sourcebuffer.h"
+#include "lexer.h"
+#include "parser.h"
+#include "visitor.h"
+
+#include <algorithm>
+
+bool SourceBuffer::s_interactive = false;
+
+struct TokenShifter : public Visitor {
+    TokenShifter(int offset, int lines) : offset(offset), lines(lines) {}
+
+    void shift(Token& tok) const
+    {
+        if (!tok.text.string())
+            return;
+        tok.text = QStringRef(tok.text.string(), tok.text.position() + offset, tok.text.length());
+        if (tok.start.line != -1)
+            tok.start.line += lines;
+        if (tok.end.line != -1)
+            tok.end.line += lines;
+    }
+
+    void shift(QList<Token>& tokens) const
+    {
+        for (int i = 0; i < tokens.count(); ++i)
+            shift(tokens[i]);
+    }
+
+    virtual void begin(Node&) {}
+    virtual void end(Node&) {}
+    virtual void visit(AssignStmt& node) { shift(node.name); }
+    virtual void visit(BinaryExpr& node) { shift(node.start); }
+    virtual void visit(ConditionalExpr& node) { shift(node.start); }
+    virtual void visit(UnaryExpr& node) { shift(node.start); }
+    virtual void visit(ForStmt& node)
+    {
+        shift(node.keyword);
+        shift(node.attributes);
+        shift(node.type);
+        shift(node.name);
+    }
+    virtual void visit(IfStmt& node) { shift(node.hint); }
+    virtual void visit(IncludeDecl& node) { shift(node.include); }
+    virtual void visit(FuncCallExpr& node) { shift(node.start); shift(node.callee); }
+    virtual void visit(FuncDecl& node)
+    {
+        shift(node.keyword);
+        shift(node.end);
+        shift(node.name);
+        shift(node.attributes);
+        shift(node.TypeDecl::attributes);
+    }
+    virtual void visit(LiteralExpr& node) { shift(node.start); shift(node.literal); }
+    virtual void visit(MatchCase& node) { shift(node.keyword); }
+    virtual void visit(MatchStmt& node) { shift(node.keyword); }
+    virtual void visit(ReturnStmt& node) { shift(node.keyword); }
+    virtual void visit(TypeCtorExpr& node) { shift(node.start); shift(node.type); }
+    virtual void visit(TypeDecl& node) { shift(node.name); shift(node.attributes); }
+    virtual void visit(TypeObject& node) { shift(node.name); shift(node.type); }
+    virtual void visit(TypeParam& node) { shift(node.name); }
+    virtual void visit(VarExpr& node) { shift(node.start); shift(node.var); }
+    virtual void visit(VarDeclStmt& node) { shift(node.type); shift(node.name); }
+    virtual void visit(WhileStmt& node) { shift(node.keyword); shift(node.attributes); }
+
+    int offset;
+    int lines;
+};
+
+static int lineStart(const QString& text, int index)
+{
+    while (index > 0 && text.at(index - 1) != '\n')
+        --index;
+    return index;
+}
+
+static int nextLineStart(const QString& text, int index)
+{
+    int newline = text.indexOf('\n', index);
+    return newline == -1 ? text.count() : newline + 1;
+}
+
+// Top level declarations begin on a line without indentation and own the
+// attributes on the line before them
+static bool isUnitStart(const QString& text, int index)
+{
+    if (index == 0 || index >= text.count())
+        return true;
+
+    QChar ch = text.at(index);
+    if (ch == ' ' || ch == '\t' || ch == '\n')
+        return false;
+
+    return text.at(lineStart(text, index - 1)) != '[';
+}
+
+// Comments and string literals can span lines and a namespace applies to every
+// declaration after it, so an edit to any of them can change the rest of the buffer
+static bool isSelfContained(const QString& text)
+{
+    return !text.contains("/*") && !text.contains("*/") && text.count('"') % 2 == 0
+        && !text.contains("namespace");
+}
+
+static bool tokenBefore(const Token& tok, int index)
+{
+    return tok.text.position() < index;
+}
+
+static int position(const IncludeDecl* decl) { return decl->include.toStringRef().position(); }
+static int position(const TypeDecl* decl) { return decl->name.toStringRef().position(); }
+static int position(const FuncDecl* decl) { return decl->keyword.toStringRef().position(); }
+
+template<typename T>
+static int removeDecls(QList<QSharedPointer<T> >& decls, int start, int end, QList<QSharedPointer<T> >& removed)
+{
+    int index = 0;
+    for (int i = 0; i < decls.count();) {
+        int pos = position(decls.at(i).data());
+        if (pos >= start && pos < end) {
+            removed.append(decls.takeAt(i));
+            continue;
+        }
+        if (pos < start)
+            index = i + 1;
+        ++i;
+    }
+    return index;
+}
+
+template<typename T>
+static void shiftDecls(QList<QSharedPointer<T> >& decls, int end, TokenShifter& shifter)
+{
+    foreach (QSharedPointer<T> decl, decls) {
+        if (position(decl.data()) >= end)
+            shifter.walk(*decl);
+    }
+}
+
+template<typename T>
+static void moveParsedDecls(QList<QSharedPointer<T> >& decls, int count, int index)
+{
+    // The parser appends so the new declarations are moved to where the old ones were
+    QList<QSharedPointer<T> > parsed = decls.mid(count);
+    decls.erase(decls.begin() + count, decls.end());
+    for (int i = 0; i < parsed.count(); ++i)
+        decls.insert(index + i, parsed.at(i));
+}
+
+static QStringList signatures(const QList<FuncDecl*>& decls)
+{
+    QStringList list;
+    foreach (FuncDecl* decl, decls) {
+        QString signature;
+        foreach (Token attribute, decl->attributes)
+            signature += attribute.toString() + ' ';
+        list.append(signature + textBetween(decl->keyword, decl->returnType->type));
+    }
+    list.sort();
+    return list;
+}
+
+template<typename T>
+static void findPrevious(const QList<QSharedPointer<T> >& decls, int start, int& previous, QString& _namespace)
+{
+    foreach (QSharedPointer<T> decl, decls) {
+        int pos = position(decl.data());
+        if (pos < start && pos > previous) {
+            previous = pos;
+            _namespace = decl->_namespace;
+        }
+    }
+}
+
+SourceBuffer::EditResult SourceBuffer::applyEdit(int offset, int removed, const QString& inserted)
+{
+    assert(offset >= 0 && removed >= 0 && offset + removed <= m_source.count());
+
+    m_editedFunctions.clear();
+    QString text = m_source;
+    text.replace(offset, removed, inserted);
+    int delta = inserted.count() - removed;
+
+    // The edit is widened to the whole top level declarations it touches
+    int start = lineStart(text, offset);
+    while (!isUnitStart(text, start))
+        start = lineStart(text, start - 1);
+
+    int end = offset + inserted.count();
+    if (end == start || lineStart(text, end) != end)
+        end = nextLineStart(text, end);
+    while (!isUnitStart(text, end))
+        end = nextLineStart(text, end);
+
+    int oldEnd = end - delta;
+
+    TranslationUnit& unit = *m_translationUnit;
+    int previous = -1;
+    QString _namespace;
+    findPrevious(unit.typeDecl, start, previous, _namespace);
+    findPrevious(unit.funcDecl, start, previous, _namespace);
+
+    // A buffer left behind by a fatal error is always parsed again in full
+    if (!m_isConsistent || !isUnitStart(m_source, start) || !isUnitStart(m_source, oldEnd)
+        || !isSelfContained(m_source.mid(start, oldEnd - start))
+        || !isSelfContained(text.mid(start, end - start))
+        || m_source.midRef(qMax(previous, 0), start - qMax(previous, 0)).contains("namespace")) {
+        m_source = text;
+        reparse();
+        return Reparsed;
+    }
+
+    m_isConsistent = false;
+
+    // The declarations of the chunk leave the type system while their tokens
+    // still refer to the old text
+    QList<QSharedPointer<IncludeDecl> > removedIncludes;
+    QList<QSharedPointer<TypeDecl> > removedTypes;
+    QList<QSharedPointer<FuncDecl> > removedFunctions;
+    int includeIndex = removeDecls(unit.includeDecl, start, oldEnd, removedIncludes);
+    int typeIndex = removeDecls(unit.typeDecl, start, oldEnd, removedTypes);
+    int functionIndex = removeDecls(unit.funcDecl, start, oldEnd, removedFunctions);
+    foreach (QSharedPointer<TypeDecl> decl, removedTypes)
+        m_typeSystem->removeType(*decl);
+    QList<FuncDecl*> removedFunctionDecls;
+    foreach (QSharedPointer<FuncDecl> decl, removedFunctions) {
+        m_typeSystem->removeType(*decl);
+        removedFunctionDecls.append(decl.data());
+    }
+    QStringList removedSignatures = signatures(removedFunctionDecls);
+
+    // Tokens and line starts are ordered so the chunk is found by binary search
+    int first = std::lower_bound(m_tokens.begin(), m_tokens.end(), start, tokenBefore) - m_tokens.begin();
+    int last = std::lower_bound(m_tokens.begin() + first, m_tokens.end(), oldEnd, tokenBefore) - m_tokens.begin();
+    QList<Token> tail = m_tokens.mid(last);
+    m_tokens.erase(m_tokens.begin() + first, m_tokens.end());
+
+    int firstLine = std::upper_bound(m_lineInfo.begin(), m_lineInfo.end(), start) - m_lineInfo.begin();
+    int lastLine = std::upper_bound(m_lineInfo.begin() + firstLine, m_lineInfo.end(), oldEnd) - m_lineInfo.begin();
+    QList<int> tailLines = m_lineInfo.mid(lastLine);
+    m_lineInfo.erase(m_lineInfo.begin() + firstLine, m_lineInfo.end());
+
+    m_source = text;
+
+    Lexer lexer;
+    lexer.lex(this, start, end);
+
+    int chunkTokens = m_tokens.count() - first;
+    int lines = (m_lineInfo.count() - firstLine) - (lastLine - firstLine);
+    TokenShifter shifter(delta, lines);
+    foreach (Token tok, tail) {
+        shifter.shift(tok);
+        m_tokens.append(tok);
+    }
+    foreach (int line, tailLines)
+        m_lineInfo.append(line + delta);
+
+    shiftDecls(unit.includeDecl, oldEnd, shifter);
+    shiftDecls(unit.typeDecl, oldEnd, shifter);
+    shiftDecls(unit.funcDecl, oldEnd, shifter);
+
+    for (int i = 0; i < m_diagnostics.count();) {
+        int pos = m_diagnostics.at(i).token.text.position();
+        if (pos >= start && pos < oldEnd) {
+            m_diagnostics.removeAt(i);
+            continue;
+        }
+        if (pos >= oldEnd)
+            shifter.shift(m_diagnostics[i].token);
+        ++i;
+    }
+
+    int includes = unit.includeDecl.count();
+    int types = unit.typeDecl.count();
+    int functions = unit.funcDecl.count();
+
+    Parser parser;
+    parser.parse(this, first, first + chunkTokens, _namespace);
+
+    for (int i = functions; i < unit.funcDecl.count(); ++i)
+        m_editedFunctions.append(unit.funcDecl.at(i).data());
+
+    moveParsedDecls(unit.includeDecl, includes, includeIndex);
+    moveParsedDecls(unit.typeDecl, types, typeIndex);
+    moveParsedDecls(unit.funcDecl, functions, functionIndex);
+    m_isConsistent = true;
+
+    bool bodiesOnly = removedIncludes.isEmpty() && removedTypes.isEmpty()
+        && unit.includeDecl.count() == includes && unit.typeDecl.count() == types
+        && signatures(m_editedFunctions) == removedSignatures;
+    return bodiesOnly ? EditedBodies : EditedDeclarations;
+}
+
+void SourceBuffer::reparse()
+{
+    m_isConsistent = false;
+    m_editedFunctions.clear();
+    m_diagnostics.clear();
+    m_numberOfErrors = 0;
+    m_tokens.clear();
+    m_lineInfo.clear();
+    m_translationUnit = QSharedPointer<TranslationUnit>(new TranslationUnit);
+    m_typeSystem = QSharedPointer<TypeSystem>(new TypeSystem(this));
+
+    Lexer lexer;
+    lexer.lex(this);
+
+    Parser parser;
+    parser.parse(this);
+    m_isConsistent = true;
+}
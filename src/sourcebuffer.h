@@ -16,6 +16,21 @@ public:
         Fatal
     };
 
+    struct Diagnostic {
+        Token token;
+        QString message;
+        ErrorType type;
+    };
+
+    // thrown instead of exiting on a fatal error in interactive mode
+    struct FatalError {};
+
+    enum EditResult {
+        EditedBodies,
+        EditedDeclarations,
+        Reparsed
+    };
+
     SourceBuffer(const QString& source, const QString& name = "")
     {
         m_source = source;
@@ -24,10 +39,41 @@ public:
         m_typeSystem = QSharedPointer<TypeSystem>(new TypeSystem(this));
         m_numberOfErrors = 0;
         m_isCompiled = false;
+        m_isChecked = false;
+        m_isConsistent = true;
     }
 
     QString name() const { return m_name; }
 
+    bool contains(const Token& tok) const { return tok.text.string() == &m_source; }
+
+    /*!
+     * \brief replaces removed characters at offset with inserted and updates the tokens, AST
+     * and type system; only the top level declarations the edit touches are lexed and parsed
+     * again unless the edit could change how the rest of the buffer is lexed or parsed
+     * @return EditedBodies if only the bodies of editedFunctions() changed so no other
+     * declaration needs to be checked again, EditedDeclarations if a type, include or
+     * function signature changed and Reparsed if the whole buffer was parsed again
+     */
+    EditResult applyEdit(int offset, int removed, const QString& inserted);
+
+    /*!
+     * \brief the functions parsed again by the last applyEdit
+     */
+    QList<FuncDecl*> editedFunctions() const { return m_editedFunctions; }
+
+    /*!
+     * \brief lexes and parses the whole buffer again, dropping its diagnostics
+     */
+    void reparse();
+
+    /*!
+     * \brief in interactive mode errors are recorded as diagnostics of the buffer
+     * instead of being printed and fatal errors throw FatalError instead of exiting
+     */
+    static void setInteractive(bool interactive) { s_interactive = interactive; }
+    QList<Diagnostic> diagnostics() const { return m_diagnostics; }
+
     QString module() const
     {
         QFileInfo info(m_name);
@@ -129,6 +175,44 @@ public:
 
         if (type == Error)
             m_numberOfErrors++;
+
+        if (s_interactive) {
+            Diagnostic diagnostic = { tok, str, type };
+            m_diagnostics.append(diagnostic);
+            if (type == Fatal)
+                throw FatalError();
+            return;
+        }
+
+        printError(tok, str, type);
+        if (type == Fatal || m_numberOfErrors > Options::instance()->errorLimit())
+            exit(EXIT_FAILURE);
+    }
+
+    /*!
+     * \brief prints the diagnostics recorded in interactive mode as errors are printed otherwise
+     */
+    void printDiagnostics() const
+    {
+        foreach (Diagnostic diagnostic, m_diagnostics)
+            printError(diagnostic.token, diagnostic.message, diagnostic.type);
+    }
+
+    TranslationUnit& translationUnit() const { return *m_translationUnit; }
+
+    TypeSystem& typeSystem() const { return *m_typeSystem; }
+
+    bool hasErrors() const { return m_numberOfErrors > 0; }
+    int numberOfErrors() const { return m_numberOfErrors; }
+    void addErrors(int errors) { m_numberOfErrors += errors; }
+    bool isCompiled() const { return m_isCompiled; }
+    void setCompiled(bool compiled) { m_isCompiled = compiled; }
+    bool isChecked() const { return m_isChecked; }
+    void setChecked(bool checked) { m_isChecked = checked; }
+
+private:
+    void printError(const Token& tok, const QString& str, ErrorType type) const
+    {
         QString err = type == Error ? "error" : "fatal error";
         QString location = name()
             + ":" + QString::number(tok.start.line)
@@ -151,23 +235,11 @@ public:
 
         QTextStream out(stderr);
         out << location << '\n' << context << '\n' << caret << '\n';
-        if (type == Fatal || m_numberOfErrors > Options::instance()->errorLimit()) {
-            out.flush();
-            exit(EXIT_FAILURE);
-        }
+        out.flush();
     }
 
-    TranslationUnit& translationUnit() const { return *m_translationUnit; }
-
-    TypeSystem& typeSystem() const { return *m_typeSystem; }
-
-    bool hasErrors() const { return m_numberOfErrors > 0; }
-    int numberOfErrors() const { return m_numberOfErrors; }
-    void addErrors(int errors) { m_numberOfErrors += errors; }
-    bool isCompiled() const { return m_isCompiled; }
-    void setCompiled(bool compiled) { m_isCompiled = compiled; }
-
 private:
+    static bool s_interactive;
     QString m_source;
     QString m_name;
     QList<Token> m_tokens;
@@ -176,6 +248,10 @@ private:
     QSharedPointer<TypeSystem> m_typeSystem;
     int m_numberOfErrors;
     bool m_isCompiled;
+    bool m_isChecked;
+    bool m_isConsistent;
+    QList<FuncDecl*> m_editedFunctions;
+    QList<Diagnostic> m_diagnostics;
 };
 
 #endif // sourcebuffer_h
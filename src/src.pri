@@ -3,28 +3,45 @@ INCLUDEPATH += $$PWD
 
 HEADERS += $$PWD/ast.h \
            $$PWD/astprinter.h \
+           $$PWD/bytecode.h \
            $$PWD/codegen.h \
+           $$PWD/constantevaluator.h \
            $$PWD/filesources.h \
+           $$PWD/interpreter.h \
+           $$PWD/languageserver.h \
            $$PWD/lexer.h \
+           $$PWD/objectcache.h \
            $$PWD/options.h \
            $$PWD/output.h \
            $$PWD/parser.h \
+           $$PWD/repl.h \
            $$PWD/sourcebuffer.h \
+           $$PWD/target.h \
+           $$PWD/typechecker.h \
            $$PWD/typesystem.h \
            $$PWD/token.h \
            $$PWD/visitor.h
 
 SOURCES += $$PWD/ast.cpp \
            $$PWD/astprinter.cpp \
+           $$PWD/bytecode.cpp \
            $$PWD/codegen.cpp \
+           $$PWD/constantevaluator.cpp \
            $$PWD/filesources.cpp \
+           $$PWD/interpreter.cpp \
+           $$PWD/languageserver.cpp \
            $$PWD/lexer.cpp \
+           $$PWD/objectcache.cpp \
            $$PWD/options.cpp \
            $$PWD/output.cpp \
            $$PWD/parser.cpp \
+           $$PWD/repl.cpp \
+           $$PWD/sourcebuffer.cpp \
+           $$PWD/target.cpp \
+           $$PWD/typechecker.cpp \
            $$PWD/typesystem.cpp
 
 QMAKE_CXXFLAGS += $$system(llvm-config-3.6 --cppflags) -ferror-limit=1
-LIBS += $$system(llvm-config-3.6 --cppflags --libs core)
+LIBS += $$system(llvm-config-3.6 --cppflags --libs core ipo mcjit native)
 LIBS += $$system(llvm-config-3.6 --ldflags)
 LIBS += $$system(llvm-config-3.6 --system-libs)
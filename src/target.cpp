@@ -0,0 +1,85 @@
+#include "target.h"
+
+#include "options.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/PassManager.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetSubtargetInfo.h>
+
+#pragma clang diagnostic pop
+
+Target* Target::instance()
+{
+    static Target* _instance = 0;
+    if (!_instance)
+        _instance = new Target;
+    return _instance;
+}
+
+Target::Target()
+    : m_triple(QString::fromStdString(llvm::sys::getDefaultTargetTriple()))
+    , m_cpu(Options::instance()->cpu())
+    , m_machine(0)
+{
+    llvm::InitializeNativeTarget();
+
+    if (m_cpu == "native") {
+        m_cpu = QString::fromStdString(llvm::sys::getHostCPUName());
+
+        // Not every host reports its features, in which case those of its
+        // processor are assumed
+        llvm::StringMap<bool> hostFeatures;
+        if (llvm::sys::getHostCPUFeatures(hostFeatures)) {
+            for (llvm::StringMap<bool>::iterator it = hostFeatures.begin(); it != hostFeatures.end(); ++it)
+                m_features.append((it->getValue() ? "+" : "-") + QString::fromStdString(it->getKey()));
+            m_features.sort(); // the order of the map is not stable and features are part of cache keys
+        }
+    }
+
+    // Features given explicitly come last so that they win over those of the host
+    m_features.append(Options::instance()->features());
+
+    std::string error;
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(m_triple.toStdString(), error);
+    if (target) {
+        m_machine = target->createTargetMachine(m_triple.toStdString(), m_cpu.toStdString(),
+                                                features().toStdString(), llvm::TargetOptions());
+    }
+}
+
+Target::~Target()
+{
+    delete m_machine;
+}
+
+void Target::configure(llvm::Module* module) const
+{
+    module->setTargetTriple(m_triple.toStdString());
+    if (m_machine)
+        module->setDataLayout(m_machine->getSubtargetImpl()->getDataLayout());
+}
+
+void Target::configure(llvm::Function* f) const
+{
+    if (!m_cpu.isEmpty())
+        f->addFnAttr("target-cpu", m_cpu.toStdString());
+    // Clones of a function already have the features of the target and their own
+    bool hasFeatures = f->getAttributes().hasAttribute(llvm::AttributeSet::FunctionIndex, "target-features");
+    if (!m_features.isEmpty() && !hasFeatures)
+        f->addFnAttr("target-features", features().toStdString());
+}
+
+void Target::addAnalysisPasses(llvm::PassManagerBase& passes) const
+{
+    if (m_machine)
+        m_machine->addAnalysisPasses(passes);
+}
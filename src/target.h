@@ -0,0 +1,61 @@
+#ifndef target_h
+#define target_h
+
+#include <QtCore>
+
+namespace llvm {
+    class Function;
+    class Module;
+    class PassManagerBase;
+    class TargetMachine;
+}
+
+class Target {
+public:
+    static Target* instance();
+
+    /*!
+     * \brief the triple of the host, which is the only target that code is generated for
+     */
+    QString triple() const { return m_triple; }
+
+    /*!
+     * \brief the processor selected in Options with native resolved to the host processor
+     * @return the name of the processor or an empty string for the generic one
+     */
+    QString cpu() const { return m_cpu; }
+
+    /*!
+     * \brief the features selected in Options, each enabled with + or disabled with -
+     * @return a comma separated list in the form llc takes
+     */
+    QString features() const { return m_features.join(','); }
+
+    /*!
+     * \brief sets the triple and data layout of module for the target
+     */
+    void configure(llvm::Module* module) const;
+
+    /*!
+     * \brief sets the target-cpu and target-features attributes of f so that each
+     * function keeps its target when modules are linked
+     */
+    void configure(llvm::Function* f) const;
+
+    /*!
+     * \brief adds the cost model of the target so the optimizer, and vectorizer in
+     * particular, know which instructions it has
+     */
+    void addAnalysisPasses(llvm::PassManagerBase& passes) const;
+
+private:
+    Target();
+    ~Target();
+
+    QString m_triple;
+    QString m_cpu;
+    QStringList m_features;
+    llvm::TargetMachine* m_machine;
+};
+
+#endif // target_h
@@ -3,6 +3,8 @@
 
 #include <QtCore>
 
+#include "assert.h"
+
 enum TokenType {
     /* whitespace */
     Whitespace,
@@ -14,9 +16,9 @@ enum TokenType {
 //    At,
 //    Hash,
 //    Dollar,
-//    Percent,
-//    Cap,
-//    Ampersand,
+    Percent,
+    Cap,
+    Ampersand,
     Star,
     OpenParenthesis,
     CloseParenthesis,
@@ -24,12 +26,12 @@ enum TokenType {
     Plus,
 //    OpenCurly,
 //    ClosedCurly,
-//    Pipe,
+    Pipe,
     Colon,
 //    DoubleQuote,
     LessThan,
     GreaterThan,
-//    QuestionMark,
+    QuestionMark,
     Minus,
     Equals,
     OpenSquare,
@@ -43,17 +45,21 @@ enum TokenType {
     /* comment */
     Comment,
     /* keywords */
+    Case,
     Else,
     Extern,
     False,
+    For,
     Function,
     If,
     Include,
+    Match,
     Namespace,
     New,
     Return,
     True,
     Type,
+    While,
     /* identifier and literal*/
     Identifier,
     BinLiteral,
@@ -77,9 +83,9 @@ static inline QString typeToString(TokenType type)
 //    case At:                return "\'@\'";
 //    case Hash:              return "\'#\'";
 //    case Dollar:            return "\'$\'";
-//    case Percent:           return "\'%\'";
-//    case Cap:               return "\'^\'";
-//    case Ampersand:         return "\'&\'";
+    case Percent:           return "\'%\'";
+    case Cap:               return "\'^\'";
+    case Ampersand:         return "\'&\'";
     case Star:              return "\'*\'";
     case OpenParenthesis:   return "\'(\'";
     case CloseParenthesis:  return "\')\'";
@@ -87,12 +93,12 @@ static inline QString typeToString(TokenType type)
     case Plus:              return "\'+\'";
 //    case OpenCurly:         return "\'{\'";
 //    case ClosedCurly:       return "\'}\'";
-//    case Pipe:              return "\'|\'";
+    case Pipe:              return "\'|\'";
     case Colon:             return "\':\'";
 //    case DoubleQuote:       return "\'\"\'";
     case LessThan:          return "\'<\'";
     case GreaterThan:       return "\'<\'";
-//    case QuestionMark:      return "\'?\'";
+    case QuestionMark:      return "\'?\'";
     case Minus:             return "\'-\'";
     case Equals:            return "\'=\'";
     case OpenSquare:        return "\'[\'";
@@ -104,17 +110,21 @@ static inline QString typeToString(TokenType type)
     case Period:            return "\'.\'";
     case Slash:             return "\'/\'";
     case Comment:           return "\'comment\'";
+    case Case:              return "\'case\'";
     case Else:              return "\'else\'";
     case Extern:            return "\'extern\'";
     case False:             return "\'false\'";
+    case For:               return "\'for\'";
     case Function:          return "\'function\'";
     case If:                return "\'if\'";
     case Include:           return "\'include'\'";
+    case Match:             return "\'match\'";
     case New:               return "\'new\'";
     case Namespace:         return "\'namespace\'";
     case Return:            return "\'return\'";
     case True:              return "\'true\'";
     case Type:              return "\'type\'";
+    case While:             return "\'while\'";
     case Identifier:        return "\'identifier\'";
     case BinLiteral:        return "\'bin literal\'";
     case DecLiteral:        return "\'int literal\'";
@@ -148,4 +158,39 @@ struct Token {
     QStringRef toStringRef() const { return text; }
 };
 
+// the source text from the start of one token to the end of a later token of the same source
+static inline QString textBetween(const Token& start, const Token& end)
+{
+    QStringRef first = start.toStringRef();
+    QStringRef last = end.toStringRef();
+    if (!first.string() || first.string() != last.string() || last.position() < first.position())
+        return first.toString();
+    return first.string()->mid(first.position(), last.position() + last.length() - first.position());
+}
+
+static inline int integerTypeToBase(TokenType type)
+{
+    switch (type) {
+    case BinLiteral: return 2;
+    case OctLiteral: return 8;
+    case DecLiteral: return 10;
+    case HexLiteral: return 16;
+    default:
+        assert(false); // should not be reached
+        return 0;
+    }
+}
+
+static inline QString integerLiteralToString(const Token& token)
+{
+    QString literal = token.toString();
+    if (token.type == BinLiteral || token.type == HexLiteral) {
+        if (!literal.startsWith('-'))
+            return literal.remove(0, 2);
+        else
+            return literal.remove(1, 2);
+    }
+    return literal;
+}
+
 #endif // token_h
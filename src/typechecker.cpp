@@ -0,0 +1,575 @@
+#include "typechecker.h"
+#include "constantevaluator.h"
+#include "filesources.h"
+#include "sourcebuffer.h"
+
+#include <limits>
+
+TypeChecker::TypeChecker(SourceBuffer* buffer)
+    : m_source(buffer)
+    , m_function(0)
+    , m_tailCall(0)
+{
+}
+
+TypeChecker::~TypeChecker()
+{
+}
+
+void TypeChecker::check()
+{
+    Visitor::walk(m_source->translationUnit());
+}
+
+void TypeChecker::check(FuncDecl& node)
+{
+    visit(node);
+}
+
+void TypeChecker::visit(IncludeDecl& node)
+{
+    QString include = node.include.toString();
+    include.remove(0, 1); // remove leading quote
+    include.chop(1); // remove trailing quote
+
+    SourceBuffer* buffer = FileSources::instance()->sourceBuffer(include);
+    if (!buffer) {
+        m_source->error(node.include, "Could not find or open include file", SourceBuffer::Fatal);
+        return;
+    }
+
+    if (!buffer->isChecked()) {
+        buffer->setChecked(true);
+
+        TypeChecker checker(buffer);
+        checker.check();
+        m_source->addErrors(buffer->numberOfErrors());
+    }
+
+    m_source->typeSystem().importTypes(buffer->typeSystem());
+}
+
+void TypeChecker::visit(TypeDecl& node)
+{
+    foreach (QSharedPointer<TypeObject> object, node.objects)
+        m_source->typeSystem().toTypeAndCheck(object->type);
+}
+
+void TypeChecker::visit(FuncDecl& node)
+{
+    m_function = &node;
+    m_variables.clear();
+    m_source->typeSystem().clearNamedTypes();
+    foreach (QSharedPointer<TypeObject> object, node.objects) {
+        TypeInfo* type = m_source->typeSystem().toTypeAndCheck(object->type);
+        m_source->typeSystem().insertNamedType(object->name.toString(), type);
+
+        // The arguments of a memoized function are the keys of its result table
+        if (node.hasAttribute("memoize") && (!type->isBuiltin() || !type->bitWidth() || type->lanes()))
+            m_source->error(object->type, "memoized function parameters must be of builtin numeric type");
+    }
+
+    TypeInfo* returnInfo = m_source->typeSystem().toTypeAndCheck(node.returnType->type);
+    if (returnInfo->isBuiltin() && returnInfo->qualifiedTypeName() == "_builtin_void_") {
+        m_source->error(node.returnType->type, "function can not return void", SourceBuffer::Fatal);
+        return;
+    }
+
+    FuncDef* funcDef = node.funcDef.data();
+    if (!funcDef)
+        return;
+
+    foreach (QSharedPointer<Stmt> stmt, funcDef->stmts)
+        check(stmt.data());
+
+    if (funcDef->stmts.isEmpty() || funcDef->stmts.last()->kind != Node::_ReturnStmt)
+        m_source->error(node.name, "function must end with return statement", SourceBuffer::Fatal);
+}
+
+void TypeChecker::check(Stmt* node)
+{
+    switch (node->kind) {
+    case Node::_IfStmt:
+        check(static_cast<IfStmt*>(node));
+        break;
+    case Node::_ReturnStmt:
+        check(static_cast<ReturnStmt*>(node));
+        break;
+    case Node::_VarDeclStmt:
+        check(static_cast<VarDeclStmt*>(node));
+        break;
+    case Node::_AssignStmt:
+        check(static_cast<AssignStmt*>(node));
+        break;
+    case Node::_WhileStmt:
+        check(static_cast<WhileStmt*>(node));
+        break;
+    case Node::_ForStmt:
+        check(static_cast<ForStmt*>(node));
+        break;
+    case Node::_MatchStmt:
+        check(static_cast<MatchStmt*>(node));
+        break;
+    default:
+        assert(false); // should not be reached
+        return;
+    }
+}
+
+void TypeChecker::check(IfStmt* node)
+{
+    if (node->expr->kind == Node::_LiteralExpr) {
+        m_source->error(node->expr->start,
+            "literal expression can not be used as the only expression of an if statement",
+            SourceBuffer::Fatal);
+        return;
+    }
+
+    TypeInfo* info = typeInfoForExpr(node->expr.data());
+    check(node->expr.data(), info);
+
+    if (!m_source->typeSystem().isCondition(node->expr.data())) {
+        m_source->error(node->expr->start,
+            "expression in if statement does not evaluate to true or false");
+    }
+
+    check(node->stmt.data());
+    if (node->elseStmt)
+        check(node->elseStmt.data());
+}
+
+void TypeChecker::check(ReturnStmt* node)
+{
+    assert(m_function);
+    TypeInfo* returnInfo = m_source->typeSystem().toTypeAndCheck(m_function->returnType->type);
+    m_tailCall = node->expr.data();
+    check(node->expr.data(), returnInfo);
+    m_tailCall = 0;
+}
+
+void TypeChecker::check(VarDeclStmt* node)
+{
+    TypeInfo* info = m_source->typeSystem().toTypeAndCheck(node->type);
+    check(node->expr.data(), info);
+    m_source->typeSystem().insertNamedType(node->name.toString(), info);
+    m_variables.insert(node->name.toString());
+}
+
+void TypeChecker::check(AssignStmt* node)
+{
+    // Parameters and the variables of for loops keep the value they start with
+    QString name = node->name.toString();
+    TypeInfo* info = m_source->typeSystem().resolveAlias(m_source->typeSystem().namedTypes().value(name));
+    if (!info) {
+        m_source->error(node->name, "unknown variable name");
+        return;
+    }
+
+    if (!m_variables.contains(name)) {
+        m_source->error(node->name, "can not assign to a parameter or the variable of a for statement");
+        return;
+    }
+
+    check(node->expr.data(), info);
+}
+
+void TypeChecker::check(WhileStmt* node)
+{
+    if (node->expr->kind == Node::_LiteralExpr) {
+        m_source->error(node->expr->start,
+            "literal expression can not be used as the only expression of a while statement",
+            SourceBuffer::Fatal);
+        return;
+    }
+
+    TypeInfo* info = typeInfoForExpr(node->expr.data());
+    check(node->expr.data(), info);
+
+    if (!m_source->typeSystem().isCondition(node->expr.data())) {
+        m_source->error(node->expr->start,
+            "expression in while statement does not evaluate to true or false");
+    }
+
+    checkBlock(node->stmts);
+}
+
+void TypeChecker::check(ForStmt* node)
+{
+    TypeInfo* info = m_source->typeSystem().resolveAlias(m_source->typeSystem().toTypeAndCheck(node->type));
+    if (!info->isInteger()) {
+        m_source->error(node->type, "for statement counts with an integer type");
+        return;
+    }
+
+    check(node->start.data(), info);
+    check(node->end.data(), info);
+    if (node->step) {
+        check(node->step.data(), info);
+
+        // A step that is not positive would never reach the end
+        ConstantEvaluator evaluator(m_source);
+        ConstantEvaluator::Value step;
+        if (ConstantEvaluator::isLiteral(node->step.data()) && evaluator.evaluate(node->step.data(), info, &step)
+            && step.integer <= 0) {
+            m_source->error(node->step->start, "for statement needs a positive step");
+        }
+    }
+
+    // The variable is only in scope in the body, which may not assign it
+    QHash<QString, TypeInfo*> namedTypes = m_source->typeSystem().namedTypes();
+    QSet<QString> variables = m_variables;
+    m_source->typeSystem().insertNamedType(node->name.toString(), info);
+    m_variables.remove(node->name.toString());
+    checkBlock(node->stmts);
+    m_source->typeSystem().setNamedTypes(namedTypes);
+    m_variables = variables;
+}
+
+void TypeChecker::check(MatchStmt* node)
+{
+    if (node->expr->kind == Node::_LiteralExpr) {
+        m_source->error(node->expr->start,
+            "literal expression can not be used as the expression of a match statement",
+            SourceBuffer::Fatal);
+        return;
+    }
+
+    TypeInfo* info = typeInfoForExpr(node->expr.data());
+    check(node->expr.data(), info);
+    if (!info || !info->isInteger()) {
+        m_source->error(node->expr->start, "match statement needs an expression of integer type");
+        return;
+    }
+
+    // The values are of the type of the expression, which is what makes two
+    // differently written literals the same case
+    ConstantEvaluator evaluator(m_source);
+    QSet<qint64> values;
+    bool hasDefault = false;
+    foreach (QSharedPointer<MatchCase> matchCase, node->cases) {
+        if (matchCase->isDefault()) {
+            if (hasDefault)
+                m_source->error(matchCase->keyword, "match statement has more than one else case");
+            hasDefault = true;
+        }
+
+        foreach (QSharedPointer<LiteralExpr> literal, matchCase->values) {
+            ConstantEvaluator::Value value;
+            if (!evaluator.evaluate(literal.data(), info, &value))
+                continue;
+            if (values.contains(qint64(value.integer)))
+                m_source->error(literal->literal, "duplicate case value in match statement");
+            values.insert(qint64(value.integer));
+        }
+
+        checkBlock(matchCase->stmts);
+    }
+}
+
+void TypeChecker::checkBlock(const QList<QSharedPointer<Stmt> >& stmts)
+{
+    // Variables declared in a block go out of scope with it
+    QHash<QString, TypeInfo*> namedTypes = m_source->typeSystem().namedTypes();
+    QSet<QString> variables = m_variables;
+    foreach (QSharedPointer<Stmt> stmt, stmts)
+        check(stmt.data());
+    m_source->typeSystem().setNamedTypes(namedTypes);
+    m_variables = variables;
+}
+
+void TypeChecker::check(Expr* node, TypeInfo* info)
+{
+    switch (node->kind) {
+    case Node::_BinaryExpr:
+        check(static_cast<BinaryExpr*>(node), info);
+        break;
+    case Node::_ConditionalExpr:
+        check(static_cast<ConditionalExpr*>(node), info);
+        break;
+    case Node::_FuncCallExpr:
+        check(static_cast<FuncCallExpr*>(node), info);
+        break;
+    case Node::_LiteralExpr:
+        check(static_cast<LiteralExpr*>(node), info);
+        break;
+    case Node::_VarExpr:
+        check(static_cast<VarExpr*>(node), info);
+        break;
+    case Node::_TypeCtorExpr:
+        check(static_cast<TypeCtorExpr*>(node), info);
+        break;
+    case Node::_UnaryExpr:
+        check(static_cast<UnaryExpr*>(node), info);
+        break;
+    default:
+        assert(false); // should not be reached
+        return;
+    }
+}
+
+void TypeChecker::check(BinaryExpr* node, TypeInfo* info)
+{
+    // Logical operators take and give bits whatever the types their operands compare
+    if (node->isLogical()) {
+        if (info && !isSameType(info, typeInfoForExpr(node)))
+            m_source->error(node->start, "logical operator evaluates to true or false, not to the expected type");
+        checkLogicalOperand(node->lhs.data());
+        checkLogicalOperand(node->rhs.data());
+        return;
+    }
+
+    // Expressions of literals take the type of their context and are checked by
+    // evaluating them, which reports any literal or result out of range
+    if (ConstantEvaluator::isLiteral(node)) {
+        ConstantEvaluator evaluator(m_source);
+        ConstantEvaluator::Value value;
+        evaluator.evaluate(node, info, &value);
+        return;
+    }
+
+    // The operands are checked against each other rather than against the
+    // surrounding expression since comparisons evaluate to a bit
+    TypeInfo* operandInfo = typeInfoForExpr(node);
+    m_source->typeSystem().checkCompatibleTypes(node->lhs.data(), node->rhs.data());
+    if (node->isBitwise() && operandInfo && (!operandInfo->bitWidth() || operandInfo->isFloatingPoint()))
+        m_source->error(node->start, "bitwise operator expects integer operands");
+    check(node->lhs.data(), operandInfo);
+    check(node->rhs.data(), operandInfo);
+}
+
+void TypeChecker::check(ConditionalExpr* node, TypeInfo* info)
+{
+    Expr* condition = node->condition.data();
+    check(condition, typeInfoForExpr(condition));
+    if (!m_source->typeSystem().isCondition(condition))
+        m_source->error(condition->start, "condition of conditional expression does not evaluate to true or false");
+
+    // Without a type from the context the sides are of the type of each other
+    if (!info) {
+        m_source->typeSystem().checkCompatibleTypes(node->lhs.data(), node->rhs.data());
+        info = typeInfoForExpr(node);
+    }
+    check(node->lhs.data(), info);
+    check(node->rhs.data(), info);
+}
+
+void TypeChecker::check(FuncCallExpr* node, TypeInfo* info)
+{
+    if (TypeSystem::isBuiltinFunction(node->callee)) {
+        checkBuiltin(node, info);
+        return;
+    }
+
+    TypeInfo* function = m_source->typeSystem().toType(node->callee.toString());
+    if (!function || !function->isFunction()) {
+        m_source->error(node->callee, "unknown function reference", SourceBuffer::Fatal);
+        return;
+    }
+
+    TypeInfo* returnInfo = typeInfoForExpr(node);
+    if (info && !isSameType(info, returnInfo))
+        m_source->error(node->callee, "function return type does not match caller");
+
+    if (m_function && !m_function->mayCall(static_cast<FuncDecl*>(function)))
+        m_source->error(node->callee, "function can not call a function that is less pure than itself");
+
+    if (m_function && m_function->hasAttribute("tailcall")) {
+        if (m_function == function && node != m_tailCall)
+            m_source->error(node->callee, "recursive call of function with tailcall attribute is not a tail call");
+        else if (m_function != function && node == m_tailCall && !hasSameSignature(m_function, function))
+            m_source->error(node->callee, "tail call of function with a different signature can not be guaranteed");
+    }
+
+    QList<TypeRef*> refs = function->typeRefList();
+    if (refs.count() != node->args.count()) {
+        m_source->error(node->callee, "incorrect number of arguments passed", SourceBuffer::Fatal);
+        return;
+    }
+
+    for (int i = 0; i < refs.count(); ++i) {
+        TypeInfo* argInfo = m_source->typeSystem().resolveAlias(m_source->typeSystem().toType(refs.at(i)->typeName()));
+        check(node->args.at(i).data(), argInfo);
+    }
+}
+
+static quint64 laneOf(LiteralExpr* node)
+{
+    return integerLiteralToString(node->literal).toULongLong(0, integerTypeToBase(node->literal.type));
+}
+
+void TypeChecker::checkBuiltin(FuncCallExpr* node, TypeInfo* info)
+{
+    TypeInfo* returnInfo = typeInfoForExpr(node);
+    if (info && !isSameType(info, returnInfo))
+        m_source->error(node->callee, "function return type does not match caller");
+
+    if (!TypeSystem::isVectorFunction(node->callee)) {
+        checkIntrinsic(node);
+        return;
+    }
+
+    QString callee = node->callee.toString();
+    TypeInfo* vector = typeInfoForExpr(node->args.first().data());
+    int count = callee == "_builtin_extract_" ? 2 : callee == "_builtin_insert_" ? 3 : 2 + vector->lanes();
+    if (node->args.count() != count) {
+        m_source->error(node->callee, "incorrect number of arguments passed", SourceBuffer::Fatal);
+        return;
+    }
+
+    // Lanes are unsigned integers and those of a shuffle are literals below the
+    // number of lanes of both vectors together
+    TypeInfo* index = m_source->typeSystem().toType("_builtin_uint32_");
+    check(node->args.first().data(), vector);
+    for (int i = 1; i < count; ++i) {
+        Expr* arg = node->args.at(i).data();
+        if (callee == "_builtin_shuffle_" && i > 1) {
+            check(arg, index);
+            if (arg->kind != Node::_LiteralExpr
+                || laneOf(static_cast<LiteralExpr*>(arg)) >= quint64(2 * vector->lanes())) {
+                m_source->error(arg->start, "shuffle lane must be a literal less than twice the number of lanes");
+            }
+        } else {
+            check(arg, callee == "_builtin_shuffle_" ? vector : i == 1 ? index : vector->elementType());
+        }
+    }
+}
+
+void TypeChecker::checkIntrinsic(FuncCallExpr* node)
+{
+    // Every argument is of the type of the first, which may be a vector whose
+    // lanes the intrinsic operates on one by one
+    QString callee = node->callee.toString();
+    TypeInfo* type = m_source->typeSystem().resolveAlias(typeInfoForExpr(node->args.first().data()));
+    int count = callee == "_builtin_fma_" ? 3 : callee == "_builtin_expect_" ? 2 : 1;
+    if (node->args.count() != count) {
+        m_source->error(node->callee, "incorrect number of arguments passed", SourceBuffer::Fatal);
+        return;
+    }
+
+    QString error = TypeSystem::intrinsicArgumentError(node->callee, type);
+    if (!error.isEmpty())
+        m_source->error(node->callee, error);
+
+    foreach (QSharedPointer<Expr> arg, node->args)
+        check(arg.data(), type);
+}
+
+void TypeChecker::check(LiteralExpr* node, TypeInfo* info)
+{
+    assert(info);
+
+    // A literal in the context of a vector is splat into every lane
+    if (info->lanes())
+        info = info->elementType();
+
+    TokenType type = node->literal.type;
+    if (type == True || type == False || type == StringLiteral)
+        return;
+
+    if (type == FloatLiteral) {
+        if (!info->isFloatingPoint()) {
+            m_source->error(node->literal, "expression for float literal has incompatible type");
+            return;
+        }
+
+        bool success = false;
+        double d = node->literal.toString().toDouble(&success);
+        double max = info->bitWidth() == 32 ? std::numeric_limits<float>::max() : std::numeric_limits<double>::max();
+        if (!success || d > max || d < -max)
+            m_source->error(node->literal, info->bitWidth() == 32 ? "float literal out of range" : "double literal out of range");
+        return;
+    }
+
+    if (!info->isBuiltin() || !info->bitWidth() || info->isFloatingPoint()) {
+        m_source->error(node->literal, "expression for integer literal has incompatible type");
+        return;
+    }
+
+    bool success = false;
+    int bits = info->bitWidth();
+    QString digits = integerLiteralToString(node->literal);
+    if (!info->isSignedInt()) {
+        quint64 n = digits.toULongLong(&success, integerTypeToBase(type));
+        if (!success || (bits < 64 && n >> bits))
+            m_source->error(node->literal, "unsigned integer literal out of range");
+    } else {
+        qint64 n = digits.toLongLong(&success, integerTypeToBase(type));
+        qint64 max = bits < 64 ? (Q_INT64_C(1) << (bits - 1)) - 1 : std::numeric_limits<qint64>::max();
+        if (!success || n > max || n < -max - 1)
+            m_source->error(node->literal, "signed integer literal out of range");
+    }
+}
+
+void TypeChecker::check(TypeCtorExpr* node, TypeInfo* info)
+{
+    if (node->type.type == Undefined) {
+        check(node->args.first().data(), info);
+        return;
+    }
+
+    TypeInfo* type = m_source->typeSystem().toTypeAndCheck(node->type);
+    if (info && !isSameType(info, type))
+        m_source->error(node->type, "type constructor does not match declared type");
+
+    if (!type->lanes())
+        return;
+
+    if (node->args.count() != 1 && node->args.count() != type->lanes()) {
+        m_source->error(node->type, "vector constructor expects one value or a value for each lane");
+        return;
+    }
+
+    foreach (QSharedPointer<Expr> arg, node->args)
+        check(arg.data(), type->elementType());
+}
+
+void TypeChecker::check(UnaryExpr* node, TypeInfo* info)
+{
+    if (info && !isSameType(info, typeInfoForExpr(node)))
+        m_source->error(node->start, "logical operator evaluates to true or false, not to the expected type");
+    checkLogicalOperand(node->expr.data());
+}
+
+void TypeChecker::checkLogicalOperand(Expr* node)
+{
+    if (node->kind != Node::_LiteralExpr)
+        check(node, typeInfoForExpr(node));
+    if (!m_source->typeSystem().isLogicalOperand(node))
+        m_source->error(node->start, "operand of logical operator does not evaluate to true or false");
+}
+
+void TypeChecker::check(VarExpr* node, TypeInfo* info)
+{
+    TypeInfo* type = typeInfoForExpr(node);
+    if (info && !isSameType(info, type))
+        m_source->error(node->var, "unknown variable type");
+}
+
+TypeInfo* TypeChecker::typeInfoForExpr(Expr* node) const
+{
+    return m_source->typeSystem().resolveAlias(m_source->typeSystem().typeInfoForExpr(node));
+}
+
+bool TypeChecker::hasSameSignature(TypeInfo* function1, TypeInfo* function2) const
+{
+    QList<TypeRef*> refs1 = function1->typeRefList();
+    QList<TypeRef*> refs2 = function2->typeRefList();
+    refs1.append(function1->returnTypeRef());
+    refs2.append(function2->returnTypeRef());
+    if (refs1.count() != refs2.count())
+        return false;
+
+    for (int i = 0; i < refs1.count(); ++i) {
+        TypeInfo* info1 = m_source->typeSystem().resolveAlias(m_source->typeSystem().toType(refs1.at(i)->typeName()));
+        TypeInfo* info2 = m_source->typeSystem().resolveAlias(m_source->typeSystem().toType(refs2.at(i)->typeName()));
+        if (!info1 || !info2 || !isSameType(info1, info2))
+            return false;
+    }
+    return true;
+}
+
+bool TypeChecker::isSameType(TypeInfo* info1, TypeInfo* info2) const
+{
+    assert(info1 && info2);
+    return info1 == info2 || info1->qualifiedTypeName() == info2->qualifiedTypeName();
+}
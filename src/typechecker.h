@@ -0,0 +1,62 @@
+#ifndef typechecker_h
+#define typechecker_h
+
+#include <QtCore>
+#include "visitor.h"
+
+class SourceBuffer;
+struct TypeInfo;
+
+class TypeChecker : public Visitor {
+public:
+    TypeChecker(SourceBuffer* source);
+    ~TypeChecker();
+
+    /*!
+     * \brief walks the AST and reports type errors without generating any code
+     */
+    void check();
+
+    /*!
+     * \brief reports the type errors of one function whose includes were already checked
+     */
+    void check(FuncDecl& node);
+
+private:
+    virtual void begin(Node&) {}
+    virtual void end(Node&) {}
+    virtual void visit(IncludeDecl&);
+    virtual void visit(TypeDecl&);
+    virtual void visit(FuncDecl&);
+    void check(Stmt* node);
+    void check(IfStmt* node);
+    void check(ReturnStmt* node);
+    void check(VarDeclStmt* node);
+    void check(AssignStmt* node);
+    void check(WhileStmt* node);
+    void check(ForStmt* node);
+    void check(MatchStmt* node);
+    void checkBlock(const QList<QSharedPointer<Stmt> >& stmts);
+    void check(Expr* node, TypeInfo* info);
+    void check(BinaryExpr* node, TypeInfo* info);
+    void check(ConditionalExpr* node, TypeInfo* info);
+    void check(FuncCallExpr* node, TypeInfo* info);
+    void checkBuiltin(FuncCallExpr* node, TypeInfo* info);
+    void checkIntrinsic(FuncCallExpr* node);
+    void check(LiteralExpr* node, TypeInfo* info);
+    void check(TypeCtorExpr* node, TypeInfo* info);
+    void check(UnaryExpr* node, TypeInfo* info);
+    void checkLogicalOperand(Expr* node);
+    void check(VarExpr* node, TypeInfo* info);
+    TypeInfo* typeInfoForExpr(Expr* node) const;
+    bool hasSameSignature(TypeInfo* function1, TypeInfo* function2) const;
+    bool isSameType(TypeInfo* info1, TypeInfo* info2) const;
+
+private:
+    SourceBuffer* m_source;
+    FuncDecl* m_function;
+    Expr* m_tailCall;
+    QSet<QString> m_variables;
+};
+
+#endif // typechecker_h
@@ -1,5 +1,6 @@
 #include "typesystem.h"
 #include "ast.h"
+#include "constantevaluator.h"
 #include "sourcebuffer.h"
 
 TypeSystem::TypeSystem(SourceBuffer* source)
@@ -9,40 +10,52 @@ TypeSystem::TypeSystem(SourceBuffer* source)
     addBuiltin("_builtin_void_");
 
     // 1 bit integer types
-    addBuiltin("_builtin_bit_");
+    addBuiltin("_builtin_bit_", 1);
     addBuiltin("_builtin_pointer_bit_");
 
     // 8 bit integer types
-    addBuiltin("_builtin_uint8_");
-    addBuiltin("_builtin_int8_", true /*signedInt*/);
+    addBuiltin("_builtin_uint8_", 8);
+    addBuiltin("_builtin_int8_", 8, true /*signedInt*/);
     addBuiltin("_builtin_pointer_uint8_");
-    addBuiltin("_builtin_pointer_int8_", true /*signedInt*/);
+    addBuiltin("_builtin_pointer_int8_", 0, true /*signedInt*/);
 
     // 16 bit integer types
-    addBuiltin("_builtin_uint16_");
-    addBuiltin("_builtin_int16_", true /*signedInt*/);
+    addBuiltin("_builtin_uint16_", 16);
+    addBuiltin("_builtin_int16_", 16, true /*signedInt*/);
     addBuiltin("_builtin_pointer_uint16_");
-    addBuiltin("_builtin_pointer_int16_", true /*signedInt*/);
+    addBuiltin("_builtin_pointer_int16_", 0, true /*signedInt*/);
 
     // 32 bit integer types
-    addBuiltin("_builtin_uint32_");
-    addBuiltin("_builtin_int32_", true /*signedInt*/);
+    addBuiltin("_builtin_uint32_", 32);
+    addBuiltin("_builtin_int32_", 32, true /*signedInt*/);
     addBuiltin("_builtin_pointer_uint32_");
-    addBuiltin("_builtin_pointer_int32_", true /*signedInt*/);
+    addBuiltin("_builtin_pointer_int32_", 0, true /*signedInt*/);
 
     // 64 bit integer types
-    addBuiltin("_builtin_uint64_");
-    addBuiltin("_builtin_int64_", true /*signedInt*/);
+    addBuiltin("_builtin_uint64_", 64);
+    addBuiltin("_builtin_int64_", 64, true /*signedInt*/);
     addBuiltin("_builtin_pointer_uint64_");
-    addBuiltin("_builtin_pointer_int64_", true /*signedInt*/);
+    addBuiltin("_builtin_pointer_int64_", 0, true /*signedInt*/);
 
     // 32-bit floating point type
-    addBuiltin("_builtin_float_");
+    addBuiltin("_builtin_float_", 32, false, true /*floatingPoint*/);
     addBuiltin("_builtin_pointer_float_");
 
     // 64-bit floating point type
-    addBuiltin("_builtin_double_");
+    addBuiltin("_builtin_double_", 64, false, true /*floatingPoint*/);
     addBuiltin("_builtin_pointer_double_");
+
+    // 128 and 256 bit vector types of each numeric type, named as _builtin_vec4_float_,
+    // and vectors of bits as wide as their comparisons
+    QStringList elements = QStringList() << "uint8" << "int8" << "uint16" << "int16" << "uint32" << "int32"
+                                         << "uint64" << "int64" << "float" << "double";
+    foreach (QString element, elements) {
+        int bitWidth = m_typeHash.value("_builtin_" + element + "_")->bitWidth();
+        addVector(element, 128 / bitWidth);
+        addVector(element, 256 / bitWidth);
+    }
+    for (int lanes = 2; lanes <= 32; lanes *= 2)
+        addVector("bit", lanes);
 }
 
 void TypeSystem::importTypes(const TypeSystem& typeSystem)
@@ -51,15 +64,66 @@ void TypeSystem::importTypes(const TypeSystem& typeSystem)
     m_typeHash.unite(typeSystem.m_typeHash);
 }
 
-void TypeSystem::addBuiltin(const QString& typeName, bool isSignedInt)
+void TypeSystem::addBuiltin(const QString& typeName, int bitWidth, bool isSignedInt, bool isFloatingPoint)
 {
     Builtin* info = new Builtin;
     info->_typeName = typeName;
+    info->_bitWidth = bitWidth;
     info->_isSignedInt = isSignedInt;
+    info->_isFloatingPoint = isFloatingPoint;
+    info->_lanes = 0;
+    info->_elementType = 0;
     m_typeHash.insert(typeName, info);
     m_builtins.append(QSharedPointer<Builtin>(info));
 }
 
+void TypeSystem::addVector(const QString& elementTypeName, int lanes)
+{
+    // Vectors share the width, signedness and kind of their elements so that
+    // arithmetic on them is checked like arithmetic on scalars
+    Builtin* element = static_cast<Builtin*>(m_typeHash.value("_builtin_" + elementTypeName + "_"));
+    assert(element);
+
+    QString typeName = QString("_builtin_vec%1_%2_").arg(lanes).arg(elementTypeName);
+    addBuiltin(typeName, element->_bitWidth, element->_isSignedInt, element->_isFloatingPoint);
+    Builtin* info = m_builtins.last().data();
+    info->_lanes = lanes;
+    info->_elementType = element;
+    m_vectorTypes.append(info);
+}
+
+bool TypeSystem::isBuiltinFunction(const Token& callee)
+{
+    static const QStringList intrinsics = QStringList() << "_builtin_bswap_" << "_builtin_ctlz_" << "_builtin_ctpop_"
+                                                        << "_builtin_cttz_" << "_builtin_expect_" << "_builtin_fma_"
+                                                        << "_builtin_prefetch_" << "_builtin_sqrt_";
+    return isVectorFunction(callee) || intrinsics.contains(callee.toString());
+}
+
+bool TypeSystem::isVectorFunction(const Token& callee)
+{
+    QString name = callee.toString();
+    return name == "_builtin_extract_" || name == "_builtin_insert_" || name == "_builtin_shuffle_";
+}
+
+QString TypeSystem::intrinsicArgumentError(const Token& callee, TypeInfo* type)
+{
+    QString name = callee.toString();
+    bool isInteger = type->bitWidth() && !type->isFloatingPoint();
+    if (name == "_builtin_sqrt_" || name == "_builtin_fma_") {
+        if (!type->isFloatingPoint())
+            return "builtin function expects floating point arguments";
+    } else if (name == "_builtin_prefetch_") {
+        if (!type->isBuiltin() || type->bitWidth() || type->qualifiedTypeName() == "_builtin_void_")
+            return "builtin function expects a pointer argument";
+    } else if (!isInteger) {
+        return "builtin function expects integer arguments";
+    } else if (name == "_builtin_bswap_" && type->bitWidth() % 16) {
+        return "byte swap expects integers of a multiple of 16 bits";
+    }
+    return QString();
+}
+
 bool TypeSystem::addType(TypeDecl& decl)
 {
     QString name = decl.name.toString();
@@ -105,6 +169,17 @@ bool TypeSystem::addFunction(FuncDecl& decl)
     return true;
 }
 
+void TypeSystem::removeType(TypeDecl& decl)
+{
+    QString name = decl.name.toString();
+    if (m_typeHash.value(name) != &decl)
+        return;
+
+    m_typeHash.remove(name);
+    if (decl.isAlias())
+        m_aliasHash.remove(name);
+}
+
 TypeInfo* TypeSystem::toType(const QStringRef& name) const
 {
     return toType(name.toString());
@@ -127,17 +202,29 @@ TypeInfo* TypeSystem::toTypeAndCheck(const Token& tok) const
     return m_typeHash.value(type);
 }
 
+TypeInfo* TypeSystem::resolveAlias(TypeInfo* info) const
+{
+    if (!info || !info->isAlias())
+        return info;
+
+    QString type = info->typeName().toString();
+    while (m_aliasHash.contains(type))
+        type = m_aliasHash.value(type);
+    return m_typeHash.value(type);
+}
+
 TypeInfo* TypeSystem::typeInfoForExpr(Expr* node) const
 {
     switch (node->kind) {
     case Node::_BinaryExpr:
     {
         BinaryExpr* expr = static_cast<BinaryExpr*>(node);
+        if (expr->isLogical())
+            return bitType();
 
-        if (expr->lhs->kind == Node::_LiteralExpr && expr->rhs->kind == Node::_LiteralExpr) {
-            m_source->error(expr->lhs->start, "both sides of binary expression are literal expressions", SourceBuffer::Fatal);
+        // Like a literal an expression of literals takes the type of its context
+        if (ConstantEvaluator::isLiteral(expr))
             return 0;
-        }
 
         if (TypeInfo* info = typeInfoForExpr(expr->lhs.data()))
             return info;
@@ -148,9 +235,33 @@ TypeInfo* TypeSystem::typeInfoForExpr(Expr* node) const
         m_source->error(expr->lhs->start, "can not determine type for binary expression", SourceBuffer::Fatal);
         return 0;
     }
+    case Node::_ConditionalExpr:
+    {
+        // Like a literal a choice between literals takes the type of its context
+        ConditionalExpr* expr = static_cast<ConditionalExpr*>(node);
+        if (TypeInfo* info = typeInfoForExpr(expr->lhs.data()))
+            return info;
+        return typeInfoForExpr(expr->rhs.data());
+    }
     case Node::_FuncCallExpr:
     {
         FuncCallExpr* expr = static_cast<FuncCallExpr*>(node);
+
+        // A lane of a vector is of its element type while the other builtin
+        // functions return a value of the type of their first argument
+        if (isBuiltinFunction(expr->callee)) {
+            TypeInfo* info = expr->args.isEmpty() ? 0 : resolveAlias(typeInfoForExpr(expr->args.first().data()));
+            if (isVectorFunction(expr->callee) && (!info || !info->lanes())) {
+                m_source->error(expr->callee, "builtin function expects a vector as first argument", SourceBuffer::Fatal);
+                return 0;
+            }
+            if (!info) {
+                m_source->error(expr->callee, "can not determine type for builtin function call", SourceBuffer::Fatal);
+                return 0;
+            }
+            return expr->callee.toString() == "_builtin_extract_" ? info->elementType() : info;
+        }
+
         TypeInfo* function = toTypeAndCheck(expr->callee);
         if (TypeRef* returnTypeRef = function->returnTypeRef())
             if (TypeInfo* returnType = toType(returnTypeRef->typeName()))
@@ -161,6 +272,8 @@ TypeInfo* TypeSystem::typeInfoForExpr(Expr* node) const
     }
     case Node::_LiteralExpr:
         return 0;
+    case Node::_UnaryExpr:
+        return bitType();
     case Node::_VarExpr:
     {
         VarExpr* expr = static_cast<VarExpr*>(node);
@@ -189,6 +302,28 @@ TypeInfo* TypeSystem::typeInfoForExpr(Expr* node) const
     }
 }
 
+bool TypeSystem::isCondition(Expr* node) const
+{
+    // Comparing vectors gives a vector of bits, which is not a condition
+    TypeInfo* info = resolveAlias(typeInfoForExpr(node));
+    if (node->kind == Node::_BinaryExpr) {
+        BinaryExpr* expr = static_cast<BinaryExpr*>(node);
+        return expr->isLogical() || (expr->isComparison() && (!info || !info->lanes()));
+    }
+
+    return info && info->isBuiltin() && info->bitWidth() == 1 && !info->lanes();
+}
+
+bool TypeSystem::isLogicalOperand(Expr* node) const
+{
+    // True and false are the only literals that are conditions
+    if (node->kind == Node::_LiteralExpr) {
+        TokenType type = static_cast<LiteralExpr*>(node)->literal.type;
+        return type == True || type == False;
+    }
+    return isCondition(node);
+}
+
 void TypeSystem::checkCompatibleTypes(Expr* expr1, Expr* expr2) const
 {
     assert(expr1);
@@ -208,4 +343,7 @@ void TypeSystem::checkCompatibleTypes(Expr* expr1, Expr* expr2) const
 
     if (infoForExpr1->isSignedInt() != infoForExpr2->isSignedInt())
         m_source->error(expr1->start, "comparison of signed and unsigned integers not supported", SourceBuffer::Fatal);
+
+    if (resolveAlias(infoForExpr1)->lanes() != resolveAlias(infoForExpr2)->lanes())
+        m_source->error(expr1->start, "vector operands must have the same number of lanes", SourceBuffer::Fatal);
 }
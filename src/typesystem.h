@@ -33,9 +33,16 @@ struct TypeInfo {
     virtual bool isFunction() const { return false; }
     virtual bool isAlias() const { return false; }
     virtual bool isSignedInt() const { return false; }
+    virtual bool isFloatingPoint() const { return false; }
+    virtual int bitWidth() const { return 0; }
+    virtual int lanes() const { return 0; }
+    virtual TypeInfo* elementType() const { return 0; }
     virtual QList<TypeRef*> typeRefList() const { return QList<TypeRef*>(); }
     virtual TypeRef* returnTypeRef() const { return 0; }
 
+    // a builtin scalar integer type wider than a bit
+    bool isInteger() const { return isBuiltin() && bitWidth() > 1 && !isFloatingPoint() && !lanes(); }
+
     TypeHandle* handle;
 };
 
@@ -44,9 +51,17 @@ struct Builtin : public TypeInfo {
     virtual QString qualifiedTypeName() const { return _typeName; }
     virtual bool isBuiltin() const { return true; }
     virtual bool isSignedInt() const { return _isSignedInt; }
+    virtual bool isFloatingPoint() const { return _isFloatingPoint; }
+    virtual int bitWidth() const { return _bitWidth; }
+    virtual int lanes() const { return _lanes; }
+    virtual TypeInfo* elementType() const { return _elementType; }
 
     QString _typeName;
+    int _bitWidth;
     bool _isSignedInt;
+    bool _isFloatingPoint;
+    int _lanes;
+    Builtin* _elementType;
 };
 
 class TypeSystem {
@@ -57,25 +72,76 @@ public:
 
     bool addType(TypeDecl&);
     bool addFunction(FuncDecl&);
+    void removeType(TypeDecl&);
 
     TypeInfo* toType(const QString& name) const;
     TypeInfo* toType(const QStringRef& name) const;
     TypeInfo* toTypeAndCheck(const Token& name) const;
+    TypeInfo* resolveAlias(TypeInfo* info) const;
     TypeInfo* typeInfoForExpr(Expr* node) const;
     void checkCompatibleTypes(Expr*, Expr*) const;
 
+    /*!
+     * \brief whether an expression evaluates to true or false, as the condition of an if,
+     * while or conditional expression must
+     */
+    bool isCondition(Expr* node) const;
+
+    /*!
+     * \brief whether an expression is a condition or one of the literals true and false,
+     * as the operands of the logical operators must be
+     */
+    bool isLogicalOperand(Expr* node) const;
+
+    /*!
+     * \brief the builtin vector types, whose handles are made from those of their elements
+     */
+    QList<TypeInfo*> vectorTypes() const { return m_vectorTypes; }
+
+    /*!
+     * \brief the builtin type of true and false, which logical operators take and give
+     */
+    TypeInfo* bitType() const { return m_typeHash.value("_builtin_bit_"); }
+
+    /*!
+     * \brief whether a call is of a builtin function, a vector operation or an intrinsic,
+     * rather than of a declared function
+     */
+    static bool isBuiltinFunction(const Token& callee);
+
+    /*!
+     * \brief whether a call is of a builtin function reading or rearranging the lanes of
+     * a vector
+     */
+    static bool isVectorFunction(const Token& callee);
+
+    /*!
+     * \brief why the arguments of an intrinsic can not be of the given type, which is
+     * that of its first argument
+     * @return the error message or an empty string if the type is accepted
+     */
+    static QString intrinsicArgumentError(const Token& callee, TypeInfo* type);
+
     void clearNamedTypes()
     { m_namedTypes.clear(); }
     void insertNamedType(const QString& name, TypeInfo* info)
     { m_namedTypes.insert(name, info); }
 
+    // The variables declared in the body of a loop go out of scope with it
+    QHash<QString, TypeInfo*> namedTypes() const
+    { return m_namedTypes; }
+    void setNamedTypes(const QHash<QString, TypeInfo*>& namedTypes)
+    { m_namedTypes = namedTypes; }
+
 private:
-    void addBuiltin(const QString& typeName, bool isSignedInt = false);
+    void addBuiltin(const QString& typeName, int bitWidth = 0, bool isSignedInt = false, bool isFloatingPoint = false);
+    void addVector(const QString& elementTypeName, int lanes);
 
 private:
     QHash<QString, QString> m_aliasHash;
     QHash<QString, TypeInfo*> m_typeHash;
     QList<QSharedPointer<Builtin> > m_builtins;
+    QList<TypeInfo*> m_vectorTypes;
     SourceBuffer* m_source;
     QHash<QString, TypeInfo*> m_namedTypes;
 };
@@ -10,21 +10,28 @@ struct Visitor {
     virtual void begin(Node&) = 0;
     virtual void end(Node&) = 0;
 
+    virtual void visit(AssignStmt&) {}
     virtual void visit(BinaryExpr&) {}
+    virtual void visit(ConditionalExpr&) {}
+    virtual void visit(ForStmt&) {}
     virtual void visit(IfStmt&) {}
     virtual void visit(IncludeDecl&) {}
     virtual void visit(FuncCallExpr&) {}
     virtual void visit(FuncDef&) {}
     virtual void visit(FuncDecl&) {}
     virtual void visit(LiteralExpr&) {}
+    virtual void visit(MatchCase&) {}
+    virtual void visit(MatchStmt&) {}
     virtual void visit(ReturnStmt&) {}
     virtual void visit(TranslationUnit&) {}
     virtual void visit(TypeCtorExpr&) {}
     virtual void visit(TypeDecl&) {}
     virtual void visit(TypeObject&) {}
     virtual void visit(TypeParam&) {}
+    virtual void visit(UnaryExpr&) {}
     virtual void visit(VarExpr&) {}
     virtual void visit(VarDeclStmt&) {}
+    virtual void visit(WhileStmt&) {}
 };
 
 #endif // visitor_h
@@ -1,10 +1,10 @@
 #include "testerrors.h"
 
-void TestErrors::compile(const QString& program, Expectation expect, bool printError)
+void TestErrors::compile(const QString& program, Expectation expect, bool printError, const QStringList& arguments)
 {
     m_compiler = new QProcess;
     m_compiler->setProgram(QCoreApplication::applicationDirPath() + "/unv");
-    m_compiler->setArguments(QStringList() << "-e" << "llvm" << "-stdin");
+    m_compiler->setArguments(QStringList() << arguments << "-stdin");
     if (printError)
         m_compiler->setProcessChannelMode(QProcess::ForwardedErrorChannel);
     m_compiler->start();
@@ -20,6 +20,18 @@ void TestErrors::compile(const QString& program, Expectation expect, bool printE
     m_compiler = 0;
 }
 
+QString TestErrors::compileToLLVM(const QString& program, const QStringList& arguments)
+{
+    QTemporaryDir dir;
+    QString file = dir.path() + "/main.ll";
+    compile(program, ExpectSuccess, true, QStringList() << arguments << "-e" << "llvm=" + file);
+
+    QFile f(file);
+    if (!f.open(QIODevice::ReadOnly))
+        return QString();
+    return QString::fromLocal8Bit(f.readAll());
+}
+
 void TestErrors::testSpaceBeforeTab()
 {
     compile("    \n\t", ExpectFailure);
@@ -235,9 +247,32 @@ void TestErrors::testLiteralExprForIfStmt()
     compile("type Int : _builtin_int32_\nfunction main : () -> Int\n\tif (0) return 1\n\treturn 0", ExpectFailure);
 }
 
-void TestErrors::testTwoLiteralExprForBinaryExpr()
+void TestErrors::testConstantExpr()
 {
-    compile("type Int : _builtin_int32_\nfunction main : () -> Int\n\tif (0 > 1) return 1\n\treturn 0", ExpectFailure);
+    QStringList syntaxOnly = QStringList() << "-fsyntax-only";
+    compile("type Int : _builtin_int32_\nfunction main : () -> Int\n\tif (0 > 1) return 1\n\treturn 2 * 3 - 6", ExpectSuccess);
+    compile("type Int : _builtin_int8_\nfunction main : () -> Int\n\tInt a = 100 + 100\n\treturn 0", ExpectFailure);
+    compile("type Int : _builtin_int8_\nfunction main : () -> Int\n\tInt a = 100 + 100\n\treturn 0", ExpectFailure, false, syntaxOnly);
+    compile("type Int : _builtin_int32_\nfunction main : () -> Int\n\treturn 1 / 0", ExpectFailure);
+    compile("type Int : _builtin_int32_\nfunction main : () -> Int\n\tif (1 + 2) return 1\n\treturn 0", ExpectFailure);
+
+    // Calls of functions on constant arguments are folded when optimizing
+    QString square = "type Int : _builtin_int32_\n[noinline]\nfunction square : (x:Int) -> Int\n\treturn x * x\n"
+                     "function main : () -> Int\n\treturn square(3) - 9";
+    QVERIFY(!compileToLLVM(square, QStringList() << "-O2").contains("@square(i32 3)"));
+    QVERIFY(compileToLLVM(square, QStringList() << "-O0").contains("@square(i32 3)"));
+    QVERIFY(compileToLLVM(square, QStringList() << "-O2" << "-fconstexpr-steps" << "1").contains("@square(i32 3)"));
+
+    // A call that exhausts the budget is not evaluated again at other call sites
+    QString fibonacci = "type Int : _builtin_int32_\n"
+                        "function fibonacci : (n:Int) -> Int\n"
+                        "\tif (n < 3) return 1\n"
+                        "\treturn fibonacci(n - 1) + fibonacci(n - 2)\n"
+                        "function main : () -> Int\n"
+                        "\tInt a = fibonacci(2)\n";
+    for (int i = 0; i < 100; ++i)
+        fibonacci += "\ta = a + fibonacci(60)\n";
+    QVERIFY(compileToLLVM(fibonacci + "\treturn a", QStringList() << "-O2").contains("call"));
 }
 
 void TestErrors::testFunctionWithNoReturn()
@@ -254,3 +289,857 @@ void TestErrors::testNonBooleanInIfStmt()
 {
     compile("type Int : _builtin_int32_\nfunction main : () -> Int\n\tInt a = 1\n\tInt b = 2\n\tif (a + b) return 0\n\treturn 1", ExpectFailure);
 }
+
+void TestErrors::testSyntaxOnly()
+{
+    QStringList syntaxOnly = QStringList() << "-fsyntax-only";
+    compile("type Int : _builtin_int32_\nfunction main : () -> Int\n\tInt a = 1\n\treturn a", ExpectSuccess, false, syntaxOnly);
+
+    // The checker also runs before code is generated so every output rejects
+    // the same programs
+    QStringList failures = QStringList()
+        << "type Int : _builtin_int32_\nfunction main : () -> Int\n\tInt a = 1\n\treturn b"
+        << "type Int : _builtin_int8_\nfunction main : () -> Int\n\treturn 128"
+        << "type Int : _builtin_int32_\nfunction main : () -> Int\n\tInt a = 1\n\tif (a + a) return 0\n\treturn 1";
+    foreach (QString program, failures) {
+        compile(program, ExpectFailure, false, syntaxOnly);
+        compile(program, ExpectFailure);
+    }
+}
+
+void TestErrors::testMultipleOutputs()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString llvm = dir.path() + "/main.ll";
+    QString ast = dir.path() + "/main.ast";
+    compile("type Int : _builtin_int32_\nfunction main : () -> Int\n\treturn 0", ExpectSuccess, false,
+            QStringList() << "-e" << "llvm=" + llvm + ",ast=" + ast);
+    QVERIFY(QFileInfo(llvm).size() > 0);
+    QVERIFY(QFileInfo(ast).size() > 0);
+}
+
+void TestErrors::testDependencyFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QFile include(dir.path() + "/int.unv");
+    QVERIFY(include.open(QIODevice::WriteOnly));
+    include.write("type Int : _builtin_int32_\n");
+    include.close();
+
+    QString llvm = dir.path() + "/main.ll";
+    QString dep = dir.path() + "/main.d";
+    compile("include \"int.unv\"\nfunction main : () -> Int\n\treturn 0", ExpectSuccess, false,
+            QStringList() << "--include" << dir.path() << "-e" << "llvm=" + llvm << "-MF" << dep);
+
+    QFile f(dep);
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    QString rule = QString::fromLocal8Bit(f.readAll());
+    QVERIFY(rule.startsWith(llvm + ":"));
+    QVERIFY(rule.contains(QFileInfo(include).absoluteFilePath() + ":"));
+}
+
+void TestErrors::testObjectCache()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString object = dir.path() + "/main.o";
+    QString cache = dir.path() + "/cache";
+    QStringList arguments = QStringList() << "-e" << "obj" << "-o" << object << "--cache-dir" << cache;
+    QString program = "type Int : _builtin_int32_\nfunction one : () -> Int\n\treturn 1\n";
+
+    compile(program + "function main : () -> Int\n\treturn one()", ExpectSuccess, false, arguments);
+    QVERIFY(QFileInfo(object).size() > 0);
+    QStringList entries = QDir(cache).entryList(QStringList() << "*.o");
+    QCOMPARE(entries.count(), 1);
+
+    // Editing a function replaces its fragment and still links
+    QFile::remove(object);
+    compile(program + "function main : () -> Int\n\treturn one() + 1", ExpectSuccess, false, arguments);
+    QVERIFY(QFileInfo(object).size() > 0);
+    QCOMPARE(QDir(cache).entryList(QStringList() << "*.o").count(), 1);
+    QVERIFY(QDir(cache).entryList(QStringList() << "*.o") != entries);
+
+    // Editing a function of one fragment reuses the object of every other one,
+    // including where it is shared with another output
+    QString many = "type Int : _builtin_int32_\n";
+    for (int i = 0; i < 40; ++i)
+        many += QString("function f%1 : () -> Int\n\treturn %1\n").arg(i);
+    QString other = dir.path() + "/other.o";
+    compile(many + "function main : () -> Int\n\treturn f1()", ExpectSuccess, false, arguments);
+    compile(many + "function main : () -> Int\n\treturn f1()", ExpectSuccess, false,
+            QStringList() << "-e" << "obj" << "-o" << other << "--cache-dir" << cache);
+    QStringList before = QDir(cache).entryList(QStringList() << "*.o");
+    QCOMPARE(before.count(), 2);
+    QHash<QString, QDateTime> modified;
+    foreach (QString entry, before)
+        modified.insert(entry, QFileInfo(QDir(cache).filePath(entry)).lastModified());
+
+    compile(many + "function main : () -> Int\n\treturn f2()", ExpectSuccess, false, arguments);
+    QStringList after = QDir(cache).entryList(QStringList() << "*.o");
+    QStringList reused;
+    foreach (QString entry, after) {
+        if (modified.contains(entry))
+            reused.append(entry);
+    }
+    QCOMPARE(after.count(), 3);
+    QCOMPARE(reused, before);
+    foreach (QString entry, reused)
+        QCOMPARE(QFileInfo(QDir(cache).filePath(entry)).lastModified(), modified.value(entry));
+}
+
+static QByteArray lspMessage(const QString& method, const QJsonObject& params, int id = -1)
+{
+    QJsonObject message;
+    message.insert("jsonrpc", QString("2.0"));
+    message.insert("method", method);
+    message.insert("params", params);
+    if (id != -1)
+        message.insert("id", id);
+
+    QByteArray content = QJsonDocument(message).toJson(QJsonDocument::Compact);
+    return "Content-Length: " + QByteArray::number(content.count()) + "\r\n\r\n" + content;
+}
+
+void TestErrors::testLanguageServer()
+{
+    QString uri = "file:///tmp/main.unv";
+    QJsonObject document;
+    document.insert("uri", uri);
+    document.insert("text", QString("type Int : _builtin_int32_\nfunction main : () -> Int\n\treturn one()\n"));
+    QJsonObject open;
+    open.insert("textDocument", document);
+
+    // Renaming the undefined callee to main fixes the only error
+    QJsonObject start;
+    start.insert("line", 2);
+    start.insert("character", 8);
+    QJsonObject end;
+    end.insert("line", 2);
+    end.insert("character", 11);
+    QJsonObject range;
+    range.insert("start", start);
+    range.insert("end", end);
+    QJsonObject edit;
+    edit.insert("range", range);
+    edit.insert("text", QString("main"));
+    QJsonObject identifier;
+    identifier.insert("uri", uri);
+    QJsonObject change;
+    change.insert("textDocument", identifier);
+    change.insert("contentChanges", QJsonArray() << edit);
+
+    QJsonObject position;
+    position.insert("line", 2);
+    position.insert("character", 9);
+    QJsonObject definition;
+    definition.insert("textDocument", identifier);
+    definition.insert("position", position);
+
+    QProcess server;
+    server.setProgram(QCoreApplication::applicationDirPath() + "/unv");
+    server.setArguments(QStringList() << "--lsp");
+    server.start();
+    QVERIFY(server.waitForStarted());
+    server.write(lspMessage("initialize", QJsonObject(), 1));
+    server.write(lspMessage("textDocument/didOpen", open));
+    server.write(lspMessage("textDocument/didChange", change));
+    server.write(lspMessage("textDocument/definition", definition, 2));
+    server.write(lspMessage("shutdown", QJsonObject(), 3));
+    server.write(lspMessage("exit", QJsonObject()));
+    server.closeWriteChannel();
+    QVERIFY(server.waitForFinished());
+    QCOMPARE(server.exitCode(), EXIT_SUCCESS);
+
+    QList<QJsonObject> diagnostics;
+    QJsonObject location;
+    QByteArray output = server.readAllStandardOutput();
+    while (!output.isEmpty()) {
+        int header = output.indexOf("\r\n\r\n");
+        QVERIFY(header != -1);
+        int length = output.mid(16, header - 16).toInt();
+        QJsonObject message = QJsonDocument::fromJson(output.mid(header + 4, length)).object();
+        output.remove(0, header + 4 + length);
+
+        if (message.value("method").toString() == "textDocument/publishDiagnostics")
+            diagnostics.append(message.value("params").toObject());
+        else if (message.value("id").toInt() == 2)
+            location = message.value("result").toObject();
+    }
+
+    QCOMPARE(diagnostics.count(), 2);
+    QCOMPARE(diagnostics.at(0).value("diagnostics").toArray().count(), 1);
+    QCOMPARE(diagnostics.at(1).value("diagnostics").toArray().count(), 0);
+    QCOMPARE(location.value("uri").toString(), uri);
+    QCOMPARE(location.value("range").toObject().value("start").toObject().value("line").toInt(), 1);
+}
+
+void TestErrors::testInterpret()
+{
+    QString fibonacci = "type Int : _builtin_int32_\n"
+                        "function fibonacci : (n:Int) -> Int\n"
+                        "\tif (n < 3) return 1\n"
+                        "\treturn fibonacci(n - 1) + fibonacci(n - 2)\n"
+                        "function main : () -> Int\n"
+                        "\tInt i = fibonacci(20)\n";
+
+    // The exit code is the result of main
+    compile(fibonacci + "\tif (i == 6765)\n\t\treturn 0\n\treturn 1", ExpectSuccess, false,
+            QStringList() << "--interpret");
+    compile(fibonacci + "\tif (i != 6765)\n\t\treturn 0\n\treturn 1", ExpectFailure, false,
+            QStringList() << "--interpret");
+}
+
+void TestErrors::testRepl()
+{
+    QProcess repl;
+    repl.setProgram(QCoreApplication::applicationDirPath() + "/unv");
+    repl.setArguments(QStringList() << "--repl");
+    repl.start();
+    QVERIFY(repl.waitForStarted());
+
+    // Later entries call the functions of earlier entries
+    repl.write("function twice : (n:_builtin_int64_) -> _builtin_int64_\n\treturn n * 2\n\n");
+    repl.write("twice(21)\n");
+    repl.write("twice(unknown)\n");
+    repl.write("twice(twice(-4))\n");
+    repl.closeWriteChannel();
+    QVERIFY(repl.waitForFinished());
+    QCOMPARE(repl.exitCode(), EXIT_SUCCESS);
+
+    QString output = QString::fromLocal8Bit(repl.readAllStandardOutput());
+    QVERIFY(output.contains("= 42 ("));
+    QVERIFY(output.contains("= -16 ("));
+    QVERIFY(!QString::fromLocal8Bit(repl.readAllStandardError()).isEmpty());
+}
+
+void TestErrors::testMemoize()
+{
+    QString fibonacci = "type Int : _builtin_int32_\n"
+                        "[memoize, const]\n"
+                        "function fibonacci : (n:Int) -> Int\n"
+                        "\tif (n < 3) return 1\n"
+                        "\treturn fibonacci(n - 1) + fibonacci(n - 2)\n"
+                        "function main : () -> Int\n"
+                        "\treturn fibonacci(40)";
+    compile(fibonacci, ExpectSuccess);
+    compile(fibonacci, ExpectSuccess, false, QStringList() << "-O2" << "-memoize-size" << "64");
+    compile("type Int : _builtin_int8_\ntype Double : _builtin_double_\n[memoize, pure]\n"
+            "function f : (n:Int, x:Double) -> Double\n\treturn x\n"
+            "function main : () -> Int\n\treturn 0", ExpectSuccess);
+
+    compile("type Int : _builtin_int32_\n[memoize]\ntype Other : Int", ExpectFailure);
+    compile("type Int : _builtin_int32_\n[memoize, extern]\nfunction f : (n:Int) -> Int\n", ExpectFailure);
+    compile("type Int : _builtin_int32_\n[memorize]\nfunction f : (n:Int) -> Int\n\treturn n", ExpectFailure);
+    compile("type Int : _builtin_int32_\ntype Pair : (a:Int, b:Int)\n[memoize, const]\n"
+            "function f : (p:Pair) -> Int\n\treturn 0", ExpectFailure, false, QStringList() << "-fsyntax-only");
+
+    // Only functions whose result depends upon nothing but their arguments are
+    // memoized, which is then checked against the calls of the body
+    QString impure = "type Int : _builtin_int32_\n[extern]\nfunction rand : () -> Int\n"
+                     "[memoize]\nfunction f : (n:Int) -> Int\n\treturn n\n"
+                     "function main : () -> Int\n\treturn f(1)";
+    compile(impure, ExpectFailure);
+    compile(impure, ExpectFailure, false, QStringList() << "-fsyntax-only");
+    impure.replace("[memoize]", "[memoize, pure]").replace("\treturn n\n", "\treturn rand() + n\n");
+    compile(impure, ExpectFailure);
+    compile(impure, ExpectFailure, false, QStringList() << "-fsyntax-only");
+}
+
+void TestErrors::testFunctionAttributes()
+{
+    QString declarations = "type Int : _builtin_int32_\n"
+                           "[extern, const, nounwind]\nfunction abs : (n:Int) -> Int\n"
+                           "[extern]\nfunction rand : () -> Int\n"
+                           "[inline, const]\nfunction twice : (n:Int) -> Int\n\treturn abs(n) * 2\n";
+    compile(declarations + "[pure, noinline]\nfunction f : (n:Int) -> Int\n\treturn twice(n)\n"
+            "function main : () -> Int\n\treturn f(rand())", ExpectSuccess, false, QStringList() << "-O2");
+
+    // Purity claims are checked against the calls of the body
+    QString impure = declarations + "[const]\nfunction f : () -> Int\n\treturn rand()\n"
+                     "function main : () -> Int\n\treturn f()";
+    compile(impure, ExpectFailure);
+    compile(impure, ExpectFailure, false, QStringList() << "-fsyntax-only");
+
+    // Folding a call on constant arguments does not make it any purer
+    QString folded = "type Int : _builtin_int32_\nfunction three : (n:Int) -> Int\n\treturn n + 2\n"
+                     "[const]\nfunction f : () -> Int\n\treturn three(1)\n"
+                     "function main : () -> Int\n\treturn f()";
+    compile(folded, ExpectFailure, false, QStringList() << "-O0");
+    compile(folded, ExpectFailure, false, QStringList() << "-O2");
+
+    compile("type Int : _builtin_int32_\n[inline, noinline]\nfunction f : () -> Int\n\treturn 0", ExpectFailure);
+}
+
+void TestErrors::testTailCall()
+{
+    QString sum = "type Int : _builtin_int64_\n"
+                  "function done : (n:Int, total:Int) -> Int\n\treturn total\n"
+                  "[tailcall]\n"
+                  "function sum : (n:Int, total:Int) -> Int\n"
+                  "\tif (n == 0) return done(n, total)\n"
+                  "\treturn sum(n - 1, total + n)\n"
+                  "function main : () -> Int\n\treturn sum(100000000, 0)";
+    compile(sum, ExpectSuccess);
+    compile(sum, ExpectSuccess, false, QStringList() << "-O2");
+
+    // Recursive tail calls loop back to the top and other tail calls must reuse
+    // the frame, even without optimization
+    QString llvm = compileToLLVM(sum, QStringList() << "-O0");
+    QVERIFY(llvm.contains("tailrecurse:"));
+    QVERIFY(llvm.contains("musttail call i64 @done("));
+    QVERIFY(!llvm.contains("call i64 @sum(i64 %"));
+
+    // A hundred million calls deep would overflow any stack that grew with them
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString object = dir.path() + "/sum.o";
+    QString binary = dir.path() + "/sum";
+    compile(QString(sum).replace("return sum(100000000, 0)", "return sum(100000000, 0) - 5000000050000000"),
+            ExpectSuccess, true, QStringList() << "-O0" << "-e" << "obj" << "-o" << object);
+    QProcess cc;
+    cc.setProcessChannelMode(QProcess::ForwardedChannels);
+    cc.start("cc", QStringList() << object << "-o" << binary);
+    QVERIFY(cc.waitForFinished());
+    QCOMPARE(cc.exitCode(), EXIT_SUCCESS);
+    QProcess run;
+    run.start(binary);
+    QVERIFY(run.waitForFinished(60000));
+    QCOMPARE(run.exitStatus(), QProcess::NormalExit);
+    QCOMPARE(run.exitCode(), EXIT_SUCCESS);
+
+    // Recursive calls must be tail calls and other tail calls must reuse the frame
+    QString notTail = "type Int : _builtin_int64_\n[tailcall]\n"
+                      "function f : (n:Int) -> Int\n\tif (n == 0) return 0\n\treturn 1 + f(n - 1)\n";
+    compile(notTail, ExpectFailure);
+    compile(notTail, ExpectFailure, false, QStringList() << "-fsyntax-only");
+
+    // Nor is a recursive call on constant arguments, even where it is folded
+    QString foldedTail = "type Int : _builtin_int64_\n[tailcall]\n"
+                         "function f : (n:Int) -> Int\n\tif (n == 0) return 0\n\treturn 1 + f(0)\n"
+                         "function main : () -> Int\n\treturn f(1)";
+    compile(foldedTail, ExpectFailure, false, QStringList() << "-O0");
+    compile(foldedTail, ExpectFailure, false, QStringList() << "-O2");
+    compile("type Int : _builtin_int64_\nfunction g : (n:Int, m:Int) -> Int\n\treturn n\n[tailcall]\n"
+            "function f : (n:Int) -> Int\n\treturn g(n, n)\n", ExpectFailure);
+}
+
+void TestErrors::testBranchHints()
+{
+    QString program = "type Int : _builtin_int32_\n"
+                      "[cold]\nfunction fail : (n:Int) -> Int\n\treturn n\n"
+                      "[hot]\nfunction f : (n:Int) -> Int\n"
+                      "\tif unlikely (n < 0) return fail(n)\n"
+                      "\tif likely (n > 0) return n\n"
+                      "\treturn 0\n"
+                      "function main : () -> Int\n\treturn f(1)";
+    compile(program, ExpectSuccess);
+    compile(program, ExpectSuccess, false, QStringList() << "-O2");
+    compile(program, ExpectSuccess, false, QStringList() << "-fsyntax-only");
+
+    // Hints become branch weights and hot and cold functions are placed in
+    // sections of their own on ELF targets, as are the functions made from them
+    QString llvm = compileToLLVM(program + "\n[hot, memoize, const]\nfunction g : (n:Int) -> Int\n\treturn n\n"
+                                 "[cold, target_clones(\"avx2\", \"default\")]\n"
+                                 "function h : (n:Int) -> Int\n\treturn n", QStringList() << "-O0");
+    QVERIFY(llvm.contains("!\"branch_weights\""));
+    QVERIFY(llvm.contains("section \".text.hot.f\""));
+    QVERIFY(llvm.contains("section \".text.unlikely.fail\""));
+    QVERIFY(llvm.contains("section \".text.hot.g.memoized\""));
+    QVERIFY(llvm.contains("section \".text.unlikely.h.avx2\""));
+    QVERIFY(llvm.contains("section \".text.unlikely.h.default\""));
+
+    compile("type Int : _builtin_int32_\nfunction main : () -> Int\n\tInt n = 1\n"
+            "\tif probably (n > 0) return 1\n\treturn 0", ExpectFailure);
+    compile("type Int : _builtin_int32_\n[hot, cold]\nfunction main : () -> Int\n\treturn 0", ExpectFailure);
+}
+
+void TestErrors::testArithmetic()
+{
+    // Subtraction and division associate to the left and truncate towards zero
+    QString integers = "type Int : _builtin_int32_\n"
+                       "function check : (a:Int, b:Int) -> Int\n"
+                       "\tif (a - b - b != 4) return 1\n"
+                       "\tif (a / b != 3) return 1\n"
+                       "\tif (a % b != 1) return 1\n"
+                       "\tInt n = 0 - a\n"
+                       "\tif (n / b != 0 - 3) return 1\n"
+                       "\tif (n % b != 0 - 1) return 1\n"
+                       "\treturn 0\n"
+                       "function main : () -> Int\n\treturn check(10, 3)";
+    compile(integers, ExpectSuccess, false, QStringList() << "--interpret");
+    compile(integers, ExpectSuccess);
+
+    QString reals = "type Int : _builtin_int32_\ntype Float : _builtin_float_\n"
+                    "function scale : (x:Float, y:Float) -> Float\n\treturn x * y / 2.0 + x % y\n"
+                    "[fastmath]\nfunction fast : (x:Float, y:Float) -> Float\n\treturn x * y + x / y\n"
+                    "function main : () -> Int\n"
+                    "\tif (scale(3.0, 2.0) + fast(1.0, 2.0) == 6.5) return 0\n\treturn 1";
+    compile(reals, ExpectSuccess, false, QStringList() << "--interpret");
+    compile(reals, ExpectSuccess);
+    compile(reals, ExpectSuccess, false, QStringList() << "--fast-math" << "-O2");
+
+    compile("type Int : _builtin_int32_\nfunction main : () -> Int\n\treturn 1 % 0", ExpectFailure);
+}
+
+void TestErrors::testOverflow()
+{
+    QString program = "type Int : _builtin_int32_\ntype Size : _builtin_uint32_\n"
+                      "function sum : (n:Int, step:Int) -> Int\n"
+                      "\tif (n < 1) return 0\n"
+                      "\treturn n * step + sum(n - 1, step)\n"
+                      "function hash : (h:Size, c:Size) -> Size\n\treturn h * 31 + c\n"
+                      "function main : () -> Int\n\treturn sum(10, 2) - 110";
+    compile(program, ExpectSuccess, false, QStringList() << "-O2");
+    compile(program, ExpectSuccess, false, QStringList() << "-overflow=wrap" << "-O2");
+    compile(program, ExpectSuccess, false, QStringList() << "-overflow=trap");
+    compile(program, ExpectSuccess, false, QStringList() << "-overflow=trap" << "-O2");
+    compile(program, ExpectSuccess, false, QStringList() << "--interpret");
+    compile(program, ExpectFailure, false, QStringList() << "-overflow=saturate");
+
+    // Only signed arithmetic assumes it does not wrap, unless it wraps or traps
+    QString undefined = compileToLLVM(program, QStringList() << "-O0");
+    QVERIFY(undefined.contains("mul nsw i32"));
+    QVERIFY(!undefined.contains("llvm.trap"));
+    QVERIFY(!compileToLLVM(program, QStringList() << "-O0" << "-overflow=wrap").contains("nsw"));
+    QString trap = compileToLLVM(program, QStringList() << "-O0" << "-overflow=trap");
+    QVERIFY(trap.contains("@llvm.smul.with.overflow.i32"));
+    QVERIFY(trap.contains("@llvm.umul.with.overflow.i32"));
+    QVERIFY(trap.contains("@llvm.trap"));
+
+    // Trapping also covers the divisions whose result is undefined
+    QString division = "type Int : _builtin_int32_\n"
+                       "function divide : (a:Int, b:Int) -> Int\n\treturn a / b % 7\n"
+                       "function main : () -> Int\n\treturn divide(14, 2)";
+    QVERIFY(!compileToLLVM(division, QStringList() << "-O0").contains("@llvm.trap"));
+    QString checked = compileToLLVM(division, QStringList() << "-O0" << "-overflow=trap");
+    QVERIFY(checked.contains("divzero"));
+    QVERIFY(checked.contains("divminusone"));
+    QVERIFY(checked.contains("@llvm.trap"));
+}
+
+void TestErrors::testTarget()
+{
+    QString program = "type Int : _builtin_int32_\n"
+                      "function main : () -> Int\n\treturn 0";
+    compile(program, ExpectSuccess, false, QStringList() << "-march=native");
+    compile(program, ExpectSuccess, false, QStringList() << "-march=native" << "-O3");
+    compile(program, ExpectSuccess, false, QStringList() << "-mcpu=generic" << "-emit=llvm");
+
+    // The processor and its features are attributes of every function
+    QString llvm = compileToLLVM(program, QStringList() << "-mcpu=generic" << "-mattr=sse4.2,-avx");
+    QVERIFY(llvm.contains("\"target-cpu\"=\"generic\""));
+    QVERIFY(llvm.contains("\"target-features\"=\"+sse4.2,-avx\""));
+}
+
+void TestErrors::testTargetClones()
+{
+    QString program = "type Int : _builtin_int32_\n"
+                      "[target_clones(\"avx2\", \"sse4.2\", \"default\")]\n"
+                      "function scale : (n:Int) -> Int\n\treturn n * 3\n"
+                      "function main : () -> Int\n\treturn scale(0)";
+    compile(program, ExpectSuccess);
+    compile(program, ExpectSuccess, false, QStringList() << "-O2" << "-mattr=+sse2");
+    compile(program, ExpectSuccess, false, QStringList() << "-fsyntax-only");
+
+    // The function calls through a pointer the resolver sets to the best clone
+    QString llvm = compileToLLVM(program, QStringList() << "-O0");
+    QVERIFY(llvm.contains("define internal i32 @scale.resolver(i32 %n)"));
+    QVERIFY(llvm.contains("@scale.resolved = internal global i32 (i32)* @scale.resolver"));
+    QVERIFY(llvm.contains("call i32 @__cpu_indicator_init()"));
+    QVERIFY(llvm.contains("define internal i32 @scale.avx2(i32 %n)"));
+    QVERIFY(llvm.contains("define internal i32 @scale.default(i32 %n)"));
+    QVERIFY(llvm.contains("\"target-features\"=\"+avx2\""));
+    QVERIFY(llvm.contains("musttail call i32"));
+
+    compile("type Int : _builtin_int32_\n[target_clones(\"avx2\")]\n"
+            "function main : () -> Int\n\treturn 0", ExpectFailure);
+    compile("type Int : _builtin_int32_\n[target_clones(\"avx9\", \"default\")]\n"
+            "function main : () -> Int\n\treturn 0", ExpectFailure);
+    compile("type Int : _builtin_int32_\n[target_clones]\n"
+            "function main : () -> Int\n\treturn 0", ExpectFailure);
+    compile("type Int : _builtin_int32_\n[inline(\"avx2\")]\n"
+            "function main : () -> Int\n\treturn 0", ExpectFailure);
+    compile("type Int : _builtin_int32_\n[extern(\"x\")]\nfunction abs : (n:Int) -> Int\n"
+            "function main : () -> Int\n\treturn 0", ExpectFailure);
+    compile("type Int : _builtin_int32_\n[target_clones(\"avx2\", \"default\"), inline(\"x\")]\n"
+            "function main : () -> Int\n\treturn 0", ExpectFailure, false, QStringList() << "-fsyntax-only");
+}
+
+void TestErrors::testVectors()
+{
+    QString types = "type Int : _builtin_int32_\ntype Float : _builtin_float_\n"
+                    "type Float4 : _builtin_vec4_float_\ntype Float8 : _builtin_vec8_float_\n"
+                    "type Mask4 : _builtin_vec4_bit_\n";
+    QString program = types +
+                      "function scale : (v:Float4, s:Float) -> Float4\n"
+                      "\tFloat4 factor = new Float4(s)\n"
+                      "\treturn v * factor + 1.0\n"
+                      "function main : () -> Int\n"
+                      "\tFloat4 v = new Float4(1.0, 2.0, 3.0, 4.0)\n"
+                      "\tFloat4 w = scale(v, 2.0)\n"
+                      "\tFloat4 r = _builtin_shuffle_(v, w, 0, 4, 1, 5)\n"
+                      "\tFloat4 x = _builtin_insert_(r, 3, 0.5)\n"
+                      "\tMask4 m = x < w\n"
+                      "\tif (_builtin_extract_(m, 0)) return 0\n"
+                      "\treturn 1";
+    compile(program, ExpectSuccess);
+    compile(program, ExpectSuccess, false, QStringList() << "-O2");
+    compile(program, ExpectSuccess, false, QStringList() << "-fsyntax-only");
+    compile(program, ExpectFailure, false, QStringList() << "--interpret");
+
+    compile(types + "function main : () -> Int\n\tFloat4 v = new Float4(1.0, 2.0)\n\treturn 0", ExpectFailure);
+    compile(types + "function f : (a:Float4, b:Float8) -> Float4\n\treturn a + b", ExpectFailure);
+    compile(types + "function f : (a:Float4) -> Int\n\tif (a < a) return 1\n\treturn 0", ExpectFailure);
+    compile(types + "function f : (a:Float4) -> Float4\n\treturn _builtin_shuffle_(a, a, 0, 1, 2, 8)", ExpectFailure);
+    compile(types + "function f : (a:Float) -> Float\n\treturn _builtin_extract_(a, 0)", ExpectFailure);
+}
+
+void TestErrors::testBitwise()
+{
+    // Bitwise operators bind looser than arithmetic and tighter than comparisons,
+    // and shift amounts wrap at the width of the type
+    QString integers = "type Int : _builtin_int32_\ntype Byte : _builtin_uint8_\n"
+                       "function check : (a:Int, b:Int, c:Byte) -> Int\n"
+                       "\tif (a & b | a ^ b != 14) return 1\n"
+                       "\tif (a << 2 + 1 != 96) return 1\n"
+                       "\tif (0 - a >> 1 != 0 - 6) return 1\n"
+                       "\tif (c >> 4 != 15) return 1\n"
+                       "\tif (a << 33 != 24) return 1\n"
+                       "\tif (_builtin_ctpop_(a) != 2) return 1\n"
+                       "\tif (_builtin_ctlz_(c) != 0) return 1\n"
+                       "\tif (_builtin_cttz_(a) != 2) return 1\n"
+                       "\tif (_builtin_bswap_(a) != 201326592) return 1\n"
+                       "\tif (_builtin_expect_(b, 10) != 10) return 1\n"
+                       "\treturn 0\n"
+                       "function main : () -> Int\n\treturn check(12, 10, 255)";
+    compile(integers, ExpectSuccess, false, QStringList() << "--interpret");
+    compile(integers, ExpectSuccess);
+    compile(integers, ExpectSuccess, false, QStringList() << "-O2");
+
+    QString reals = "type Int : _builtin_int32_\ntype Double : _builtin_double_\ntype String : _builtin_pointer_int8_\n"
+                    "function main : () -> Int\n"
+                    "\tString s = \"abc\"\n"
+                    "\tString t = _builtin_prefetch_(s)\n"
+                    "\tDouble x = 9.0\n"
+                    "\tif (_builtin_sqrt_(x) + _builtin_fma_(x, 2.0, 1.0) == 22.0) return 0\n"
+                    "\treturn 1";
+    compile(reals, ExpectSuccess, false, QStringList() << "--interpret");
+    compile(reals, ExpectSuccess);
+
+    // The wrappers of the core library call the intrinsics on the types they name
+    QString wrappers = "include \"intrinsics.unv\"\n"
+                       "function main : () -> Int\n"
+                       "\tif (popCount32(7) != 3) return 1\n"
+                       "\tif (leadingZeros(1) != 63) return 2\n"
+                       "\tif (trailingZeros32(8) != 3) return 3\n"
+                       "\tif (byteSwap16(1) != 256) return 4\n"
+                       "\tif (squareRoot(16.0) != 4.0) return 5\n"
+                       "\tif (fusedMultiplyAddFloat(2.0, 3.0, 1.0) != 7.0) return 6\n"
+                       "\treturn 0";
+    QStringList core = QStringList() << "--include" << CORE_DIR;
+    compile(wrappers, ExpectSuccess, true, QStringList() << core << "--interpret");
+    compile(wrappers, ExpectSuccess, true, QStringList() << core << "-e" << "llvm");
+    compile(wrappers, ExpectSuccess, true, QStringList() << core << "-O2" << "-e" << "llvm");
+
+    QString types = "type Int : _builtin_int32_\ntype Byte : _builtin_uint8_\ntype Double : _builtin_double_\n";
+    QStringList failures = QStringList()
+        << "function f : (x:Double) -> Double\n\treturn x & x"
+        << "function f : (x:Double) -> Double\n\treturn _builtin_ctpop_(x)"
+        << "function f : (x:Int) -> Int\n\treturn _builtin_sqrt_(x)"
+        << "function f : (x:Byte) -> Byte\n\treturn _builtin_bswap_(x)"
+        << "function f : (x:Int) -> Int\n\treturn _builtin_prefetch_(x)"
+        << "function f : (x:Int) -> Int\n\treturn _builtin_fma_(x, x)"
+        << "function main : () -> Int\n\treturn 1 << 32";
+    foreach (QString failure, failures) {
+        compile(types + failure, ExpectFailure);
+        compile(types + failure, ExpectFailure, false, QStringList());
+        compile(types + failure, ExpectFailure, false, QStringList() << "--interpret");
+    }
+}
+
+void TestErrors::testLoops()
+{
+    // Names that start with a keyword are still names
+    QString loops = "type Int : _builtin_int32_\ntype UInt : _builtin_uint32_\n"
+                    "type Small : _builtin_int8_\ntype Byte : _builtin_uint8_\n"
+                    "function sum : (n:Int) -> Int\n"
+                    "\tInt total = 0\n"
+                    "\tInt whileCount = 0\n"
+                    "\twhile (whileCount < n)\n"
+                    "\t\ttotal = total + whileCount\n"
+                    "\t\twhileCount = whileCount + 1\n"
+                    "\treturn total\n"
+                    "function largest : (n:Int) -> Int\n"
+                    "\tInt m = 0\n"
+                    "\t[vectorize(4), unroll(2)]\n"
+                    "\tfor (Int i = 0, n)\n"
+                    "\t\tInt x = i * 7 % 10\n"
+                    "\t\tif (x > m) m = x\n"
+                    "\treturn m\n"
+                    "function evens : (n:UInt) -> UInt\n"
+                    "\tUInt forCount = 0\n"
+                    "\tfor (UInt i = 0, n, 2)\n"
+                    "\t\tforCount = forCount + 1\n"
+                    "\treturn forCount\n"
+                    "function nested : (n:Int) -> Int\n"
+                    "\tInt total = 0\n"
+                    "\tfor (Int i = 0, n)\n"
+                    "\t\tfor (Int j = i, n)\n"
+                    "\t\t\ttotal = total + 1\n"
+                    "\treturn total\n"
+                    "function first : (n:Int) -> Int\n"
+                    "\t[novectorize]\n"
+                    "\tfor (Int i = 1, n)\n"
+                    "\t\tif (i * i > 50) return i\n"
+                    "\treturn 0\n"
+                    "function edges : (step:Int) -> Int\n"
+                    "\tInt count = 0\n"
+                    "\tfor (Small i = 0, 127, 2)\n"
+                    "\t\tcount = count + 1\n"
+                    "\tfor (Byte b = 0, 255, 2)\n"
+                    "\t\tcount = count + 1\n"
+                    "\tfor (Int i = 0, 10, step)\n"
+                    "\t\tcount = count + 1\n"
+                    "\treturn count\n"
+                    "function main : () -> Int\n"
+                    "\tif (sum(10) != 45) return 1\n"
+                    "\tif (largest(20) != 9) return 2\n"
+                    "\tif (evens(9) != 5) return 3\n"
+                    "\tif (nested(4) != 10) return 4\n"
+                    "\tif (first(100) != 8) return 5\n"
+                    "\tif (edges(0 - 1) != 192) return 6\n"
+                    "\tif (edges(0) != 192) return 7\n"
+                    "\tif (edges(5) != 194) return 8\n"
+                    "\treturn 0";
+    compile(loops, ExpectSuccess, false, QStringList() << "--interpret");
+    compile(loops, ExpectSuccess);
+    compile(loops, ExpectSuccess, false, QStringList() << "-O2");
+
+    QString types = "type Int : _builtin_int32_\ntype Double : _builtin_double_\n";
+    compile(types + "function f : (x:Int) -> Int\n\tx = 1\n\treturn x", ExpectFailure);
+    compile(types + "function f : (n:Int) -> Int\n\tfor (Int i = 0, n)\n\t\ti = 1\n\treturn n", ExpectFailure);
+    compile(types + "function f : (n:Int) -> Int\n\twhile (n > 0)\n\t\tInt y = 1\n\treturn y", ExpectFailure);
+    compile(types + "function f : (n:Int) -> Int\n\tInt y = 0\n\t[vectorize(3)]\n"
+                    "\tfor (Int i = 0, n)\n\t\ty = y + i\n\treturn y", ExpectFailure);
+    compile(types + "function f : (n:Int) -> Int\n\tInt y = 0\n"
+                    "\tfor (Double d = 0.0, 1.0)\n\t\ty = y + 1\n\treturn y", ExpectFailure);
+
+    // Steps are positive, so counters stop before they would pass the end
+    foreach (QString step, QStringList() << "0" << "1 - 2") {
+        QString program = types + "function f : (n:Int) -> Int\n\tInt y = 0\n"
+                          "\tfor (Int i = 0, n, " + step + ")\n\t\ty = y + 1\n\treturn y";
+        compile(program, ExpectFailure);
+        compile(program, ExpectFailure, false, QStringList() << "-fsyntax-only");
+    }
+}
+
+void TestErrors::testMatch()
+{
+    // Cases may list several values and run a block, and values are compared in
+    // the type of the expression
+    QString match = "type Int : _builtin_int32_\ntype Byte : _builtin_uint8_\n"
+                    "function classify : (c:Byte) -> Int\n"
+                    "\tmatch (c)\n"
+                    "\t\tcase 32, 9, 10: return 1\n"
+                    "\t\tcase 0x30:\n"
+                    "\t\t\tInt digit = 2\n"
+                    "\t\t\treturn digit\n"
+                    "\t\telse: return 3\n"
+                    "\treturn 0\n"
+                    "function sign : (x:Int) -> Int\n"
+                    "\tInt result = 0\n"
+                    "\tmatch (x)\n"
+                    "\t\tcase -1: result = 10\n"
+                    "\t\tcase 1: result = 20\n"
+                    "\treturn result\n"
+                    "function main : () -> Int\n"
+                    "\tif (classify(9) != 1) return 1\n"
+                    "\tif (classify(48) != 2) return 2\n"
+                    "\tif (classify(65) != 3) return 3\n"
+                    "\tif (sign(0 - 1) != 10) return 4\n"
+                    "\tif (sign(1) != 20) return 5\n"
+                    "\tif (sign(2) != 0) return 6\n"
+                    "\treturn 0";
+    compile(match, ExpectSuccess, false, QStringList() << "--interpret");
+    compile(match, ExpectSuccess);
+    compile(match, ExpectSuccess, false, QStringList() << "-O2");
+
+    // Each match is a single switch over every value of its cases
+    QString llvm = compileToLLVM(match, QStringList() << "-O0");
+    QVERIFY(llvm.contains("switch i8 %c, label"));
+    foreach (QString value, QStringList() << "32" << "9" << "10" << "48")
+        QVERIFY(llvm.contains("i8 " + value + ", label"));
+    QVERIFY(llvm.contains("switch i32 %x, label"));
+    QVERIFY(llvm.contains("i32 -1, label"));
+
+    QString types = "type Int : _builtin_int32_\ntype Byte : _builtin_uint8_\ntype Double : _builtin_double_\n";
+    compile(types + "function f : (x:Int) -> Int\n\tmatch (x)\n\t\tcase 1, 2: return 1\n\t\tcase 2: return 2\n"
+                    "\treturn 0", ExpectFailure);
+    compile(types + "function f : (x:Byte) -> Int\n\tmatch (x)\n\t\tcase 1: return 1\n\t\tcase 0x01: return 2\n"
+                    "\treturn 0", ExpectFailure);
+    compile(types + "function f : (x:Byte) -> Int\n\tmatch (x)\n\t\tcase 256: return 1\n\treturn 0", ExpectFailure);
+    compile(types + "function f : (x:Double) -> Int\n\tmatch (x)\n\t\tcase 1: return 1\n\treturn 0", ExpectFailure);
+    compile(types + "function f : (x:Int) -> Int\n\tmatch (x)\n\t\telse: return 1\n\t\telse: return 2\n"
+                    "\treturn 0", ExpectFailure);
+}
+
+void TestErrors::testConditional()
+{
+    // An else on the next line continues an if at the same indentation, and a
+    // conditional whose sides divide or call is branched rather than selected
+    QString conditional = "type Int : _builtin_int32_\n"
+                          "function classify : (x:Int) -> Int\n"
+                          "\tif (x < 0) return 1\n"
+                          "\telse if (x == 0) return 2\n"
+                          "\telse return 3\n"
+                          "function clamp : (x:Int) -> Int\n"
+                          "\tInt result = 0\n"
+                          "\tif (x > 100)\n"
+                          "\t\tresult = 100\n"
+                          "\telse\n"
+                          "\t\tresult = x < 0 ? 0 : x\n"
+                          "\treturn result\n"
+                          "function safeDivide : (a:Int, b:Int) -> Int\n"
+                          "\treturn b == 0 ? 0 : a / b\n"
+                          "function main : () -> Int\n"
+                          "\tInt a = 3\n"
+                          "\tInt b = 7\n"
+                          "\tif (classify(0 - 5) != 1) return 1\n"
+                          "\tif (classify(0) != 2) return 2\n"
+                          "\tif (classify(5) != 3) return 3\n"
+                          "\tif (clamp(200) != 100) return 4\n"
+                          "\tif (clamp(0 - 1) != 0) return 5\n"
+                          "\tif (clamp(42) != 42) return 6\n"
+                          "\tInt smaller = a < b ? a : b\n"
+                          "\tif (smaller != 3) return 7\n"
+                          "\tInt middle = a > b ? a : b > 5 ? 5 : b\n"
+                          "\tif (middle != 5) return 8\n"
+                          "\tif (safeDivide(9, 0) != 0) return 9\n"
+                          "\tif (safeDivide(9, 3) != 3) return 10\n"
+                          "\treturn 0";
+    compile(conditional, ExpectSuccess, false, QStringList() << "--interpret");
+    compile(conditional, ExpectSuccess);
+    compile(conditional, ExpectSuccess, false, QStringList() << "-O2");
+
+    // Sides that are cheap and can not trap are selected without a branch
+    QString llvm = compileToLLVM(conditional, QStringList() << "-O0");
+    QVERIFY(llvm.contains(QRegularExpression("%cond[0-9]* = select i1 %[\\w.]+, i32 0, i32 %x")));
+    QVERIFY(llvm.contains("cond.true:"));
+    QVERIFY(llvm.contains("sdiv i32 %a, %b"));
+
+    QString types = "type Int : _builtin_int32_\ntype Double : _builtin_double_\n";
+    compile(types + "function f : (x:Int) -> Int\n\treturn x ? 1 : 2", ExpectFailure, false,
+            QStringList() << "--interpret");
+    compile(types + "function f : (x:Int, y:Double) -> Int\n\treturn x < 0 ? x : y", ExpectFailure, false,
+            QStringList() << "--interpret");
+    compile(types + "function f : (x:Int) -> Int\n\tif (x < 0) return 1\n\telse\n\treturn 0", ExpectFailure);
+}
+
+void TestErrors::testLogical()
+{
+    // && binds tighter than || and the right operand is not evaluated when the
+    // left one decides the result, here a division by zero
+    QString logical = "type Int : _builtin_int32_\ntype Bit : _builtin_bit_\n"
+                      "function isPositive : (x:Int) -> Bit\n"
+                      "\treturn x > 0\n"
+                      "function inRange : (x:Int, low:Int, high:Int) -> Bit\n"
+                      "\treturn x >= low && x <= high\n"
+                      "function divides : (a:Int, b:Int) -> Bit\n"
+                      "\treturn b != 0 && a % b == 0\n"
+                      "function precedence : (a:Int, b:Int, c:Int) -> Int\n"
+                      "\tBit negative = !isPositive(a)\n"
+                      "\tif (a < b || a > c && c > 0) return 1\n"
+                      "\tif (negative && true || false) return 2\n"
+                      "\treturn 0\n"
+                      "function main : () -> Int\n"
+                      "\tInt zero = 0\n"
+                      "\tif (!inRange(5, 1, 10)) return 1\n"
+                      "\tif (inRange(11, 1, 10)) return 2\n"
+                      "\tif (divides(7, zero) || !divides(9, 3)) return 3\n"
+                      "\tif (zero != 0 && 7 / zero > 1) return 4\n"
+                      "\tBit safe = zero == 0 || 7 / zero > 1\n"
+                      "\tif (!safe) return 5\n"
+                      "\tif (precedence(1, 2, 0) != 1) return 6\n"
+                      "\tif (precedence(3, 2, 0) != 0) return 7\n"
+                      "\tif (precedence(0 - 3, 0 - 4, 0 - 5) != 2) return 8\n"
+                      "\treturn 0";
+    compile(logical, ExpectSuccess, false, QStringList() << "--interpret");
+    compile(logical, ExpectSuccess);
+    compile(logical, ExpectSuccess, false, QStringList() << "-O2");
+
+    QString types = "type Int : _builtin_int32_\ntype Bit : _builtin_bit_\n";
+    QStringList failures = QStringList()
+        << "function f : (x:Int, y:Int) -> Bit\n\treturn x && y"
+        << "function f : (x:Int) -> Bit\n\treturn !x"
+        << "function f : (x:Int, y:Int) -> Int\n\treturn x < y || y < 0"
+        << "function f : (x:Int) -> Bit\n\treturn x > 0 && 1"
+        << "function f : (x:Int) -> Bit\n\treturn 0 || x > 0";
+    foreach (QString failure, failures) {
+        compile(types + failure, ExpectFailure, false, QStringList() << "--interpret");
+        compile(types + failure, ExpectFailure);
+        compile(types + failure, ExpectFailure, false, QStringList());
+    }
+}
+
+void TestErrors::testParallelObject()
+{
+    // Four functions and a string shared between them are lowered by four llc
+    // processes and linked back into one object defining every function
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString object = dir.path() + "/main.o";
+    QString program = "type Int : _builtin_int32_\ntype String : _builtin_pointer_int8_\n"
+                      "function name : () -> String\n\treturn \"unv\"\n"
+                      "function one : () -> Int\n\treturn 1\n"
+                      "function two : () -> Int\n\treturn one() + one()\n"
+                      "function main : () -> Int\n\treturn two() - 2";
+    compile(program, ExpectSuccess, true, QStringList() << "-j" << "4" << "-e" << "obj" << "-o" << object);
+    QVERIFY(QFileInfo(object).size() > 0);
+
+    QProcess nm;
+    nm.start("nm", QStringList() << "--defined-only" << object);
+    QVERIFY(nm.waitForFinished());
+    QString symbols = QString::fromLocal8Bit(nm.readAllStandardOutput());
+    foreach (QString function, QStringList() << "name" << "one" << "two" << "main")
+        QVERIFY(symbols.contains(QRegularExpression(" [Tt] " + function + "\n")));
+}
+
+void TestErrors::testDependencyFileNested()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QMap<QString, QByteArray> files;
+    files.insert("inner.unv", "type Int : _builtin_int32_\n");
+    files.insert("outer.unv", "include \"inner.unv\"\n");
+    files.insert("a.unv", "include \"outer.unv\"\nfunction main : () -> Int\n\treturn 0\n");
+    files.insert("b.unv", "include \"outer.unv\"\nfunction main : () -> Int\n\treturn 1\n");
+    foreach (QString name, files.keys()) {
+        QFile file(dir.path() + "/" + name);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(files.value(name));
+        file.close();
+    }
+
+    // The second input finds outer.unv already loaded and must still depend on
+    // what it includes
+    QProcess compiler;
+    compiler.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    compiler.start(QCoreApplication::applicationDirPath() + "/unv", QStringList()
+                   << "--include" << dir.path() << "-e" << "obj" << "-MD"
+                   << dir.path() + "/a.unv" << dir.path() + "/b.unv");
+    QVERIFY(compiler.waitForFinished());
+    QCOMPARE(compiler.exitCode(), EXIT_SUCCESS);
+
+    QString inner = QFileInfo(dir.path() + "/inner.unv").absoluteFilePath();
+    QString outer = QFileInfo(dir.path() + "/outer.unv").absoluteFilePath();
+    foreach (QString input, QStringList() << "a" << "b") {
+        QFile f(dir.path() + "/" + input + ".d");
+        QVERIFY(f.open(QIODevice::ReadOnly));
+        QString rule = QString::fromLocal8Bit(f.readAll());
+        QVERIFY(rule.startsWith(dir.path() + "/" + input + ".o:"));
+        QVERIFY(rule.contains(outer + ":"));
+        QVERIFY(rule.contains(inner + ":"));
+    }
+}
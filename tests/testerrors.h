@@ -26,12 +26,37 @@ private slots:
     void testUInt32Overflow();
     void testUInt64Overflow();
     void testLiteralExprForIfStmt();
-    void testTwoLiteralExprForBinaryExpr();
+    void testConstantExpr();
     void testFunctionWithNoReturn();
     void testFunctionReturnsVoid();
     void testNonBooleanInIfStmt();
+    void testSyntaxOnly();
+    void testMultipleOutputs();
+    void testDependencyFile();
+    void testObjectCache();
+    void testLanguageServer();
+    void testInterpret();
+    void testRepl();
+    void testMemoize();
+    void testFunctionAttributes();
+    void testTailCall();
+    void testBranchHints();
+    void testArithmetic();
+    void testOverflow();
+    void testTarget();
+    void testTargetClones();
+    void testVectors();
+    void testBitwise();
+    void testLoops();
+    void testMatch();
+    void testConditional();
+    void testLogical();
+    void testParallelObject();
+    void testDependencyFileNested();
 private:
-    void compile(const QString& program, Expectation expect, bool printError = false);
+    void compile(const QString& program, Expectation expect, bool printError = false,
+                 const QStringList& arguments = QStringList() << "-e" << "llvm");
+    QString compileToLLVM(const QString& program, const QStringList& arguments = QStringList());
 
 private:
     QProcess* m_compiler;
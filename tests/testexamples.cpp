@@ -22,4 +22,12 @@ void TestExamples::testExamples()
     QCOMPARE(numericliterals.exitStatus(), QProcess::NormalExit);
     QCOMPARE(numericliterals.exitCode(), 0);
     QCOMPARE(numericliterals.state(), QProcess::NotRunning);
+
+    QProcess dispatch;
+    dispatch.setProgram(examples.path() + QDir::separator() + "dispatch");
+    dispatch.start();
+    QVERIFY(dispatch.waitForFinished());
+    QCOMPARE(dispatch.exitStatus(), QProcess::NormalExit);
+    QCOMPARE(dispatch.exitCode(), 0);
+    QCOMPARE(dispatch.state(), QProcess::NotRunning);
 }
@@ -41,3 +41,50 @@ void TestParser::testExamples()
         QCOMPARE(resourceText, astText);
     }
 }
+
+static QString printBuffer(SourceBuffer* buffer)
+{
+    QString text;
+    QTextStream out(&text);
+    buffer->printTokens(out);
+    ASTPrinter printer(buffer, &out);
+    printer.walk();
+    return text;
+}
+
+void TestParser::testIncrementalEdit()
+{
+    QString text = "type Int : _builtin_int32_\n"
+                   "\n"
+                   "function one : () -> Int\n"
+                   "\treturn 1\n"
+                   "\n"
+                   "function main : () -> Int\n"
+                   "\treturn one()\n";
+
+    QList<QStringList> edits;
+    edits << (QStringList() << "return 1" << "return 1 + 2\n\treturn 3");
+    edits << (QStringList() << "function main" << "function two : () -> Int\n\treturn 2\n\nfunction main");
+    edits << (QStringList() << "function one : () -> Int\n\treturn 1\n\n" << "");
+    edits << (QStringList() << "return one()" << "return one() * one()");
+
+    foreach (QStringList edit, edits) {
+        SourceBuffer incremental(text);
+        Lexer lexer;
+        lexer.lex(&incremental);
+        Parser parser;
+        parser.parse(&incremental);
+
+        int offset = text.indexOf(edit.at(0));
+        incremental.applyEdit(offset, edit.at(0).count(), edit.at(1));
+
+        QString edited = text;
+        edited.replace(offset, edit.at(0).count(), edit.at(1));
+        SourceBuffer full(edited);
+        lexer.lex(&full);
+        parser.parse(&full);
+
+        QCOMPARE(printBuffer(&incremental), printBuffer(&full));
+        QCOMPARE(incremental.typeSystem().toType("main") != 0, true);
+    }
+}
@@ -4,4 +4,5 @@ class TestParser: public QObject {
     Q_OBJECT
 private slots:
     void testExamples();
+    void testIncrementalEdit();
 };
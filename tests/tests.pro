@@ -8,6 +8,7 @@ QT += testlib
 
 DEPENDPATH += .
 INCLUDEPATH += .
+DEFINES += CORE_DIR=\\\"$$TOPLEVELDIR/core\\\"
 
 HEADERS += testerrors.h \
            testexamples.h \
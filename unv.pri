@@ -29,8 +29,10 @@ MOC_DIR = tmp
 TOPLEVELDIR = $$PWD
 
 unv.output = ${QMAKE_FILE_BASE}.o
-unv.commands = $$OUTPUT_DIR/bin/unv $$UNV_INCLUDE -e obj ${QMAKE_FILE_NAME} -o ${QMAKE_FILE_OUT}
+unv.commands = $$OUTPUT_DIR/bin/unv $$UNV_INCLUDE $$UNV_FLAGS -e obj ${QMAKE_FILE_NAME} -o ${QMAKE_FILE_OUT} -MD -MF ${QMAKE_FILE_BASE}.d
 unv.input = UNV_SOURCES
 unv.depends = $$OUTPUT_DIR/bin/unv
+unv.clean = ${QMAKE_FILE_OUT} ${QMAKE_FILE_BASE}.d
 unv.variable_out = OBJECTS
 QMAKE_EXTRA_COMPILERS += unv
+QMAKE_EXTRA_INCLUDES += $$PWD/unvdepends.mk
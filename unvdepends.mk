@@ -0,0 +1,2 @@
+# Rules the unv compiler writes with -MD; none exist before the first build
+-include $(wildcard *.d)